@@ -34,6 +34,8 @@ import controlTypes
 import globalCommands
 import browseMode
 import config
+import ui
+from logHandler import log
 from speech.sayAll import SayAllHandler
 
 from .handler import AudioThemesHandler, SpecialProps
@@ -179,6 +181,27 @@ class GlobalPlugin(globalPluginHandler.GlobalPlugin):
         globalCommands.GlobalCommands.script_reportCurrentFocus.__doc__
     )
 
+    def script_logAudioStats(self, gesture):
+        player = getattr(self.handler, "player", None)
+        if player is None or not player.available:
+            return
+        log.info(player.stats_report())
+        if scriptHandler.getLastScriptRepeatCount() > 0:
+            # Pressed twice: start a fresh measurement
+            player.steam_audio.reset_audio_stats()
+            # Translators: reported when the audio engine statistics were logged and then reset
+            ui.message(_("Audio statistics logged and reset"))
+        else:
+            # Translators: reported when the audio engine statistics were written to the NVDA log
+            ui.message(_("Audio statistics logged"))
+
+    # Translators: description of the command that writes audio engine statistics to the log
+    script_logAudioStats.__doc__ = _(
+        "Writes audio theme timing statistics to the NVDA log. Pressed twice, also resets them"
+    )
+    # Translators: input gestures category for Audio Themes commands
+    script_logAudioStats.category = _("Audio Themes")
+
     def event_gainFocus(self, obj, nextHandler):
         # Focus mode: play sound using focus object position
         self._last_focus_sound_time = time.time()
@@ -8,8 +8,6 @@ import os
 import time
 import threading
 import dataclasses
-import wave
-import struct
 
 import config
 import nvwave
@@ -24,11 +22,53 @@ except ImportError:
 from . import steam_audio
 
 
+# When every mixer voice is busy, a sound only takes the place of one with a lower priority
+PRIORITY_QUEUED = 0
+PRIORITY_FOCUS = 1
+PRIORITY_PREVIEW = 2
+
+
 def clamp(value, min_value, max_value):
     """Clamp value between min and max."""
     return max(min(value, max_value), min_value)
 
 
+class _MixerFeeder:
+    """Moves mixed audio from the native mixer into a WavePlayer on one long-lived thread.
+
+    Holds no reference to the player so the player can still be garbage collected.
+    """
+
+    def __init__(self, mixer, wave_player):
+        self._mixer = mixer
+        self._wave_player = wave_player
+        self._stopping = threading.Event()
+        self._thread = threading.Thread(target=self._run, name="AudioThemesMixer", daemon=True)
+        self._thread.start()
+
+    def _run(self):
+        while not self._stopping.is_set():
+            try:
+                data, interrupted = self._mixer.read(timeout_ms=100)
+                if interrupted:
+                    # Drop whatever the interrupted sounds still have buffered in the output device
+                    self._wave_player.stop()
+                if data:
+                    self._wave_player.feed(data)
+            except Exception as e:
+                log.debug(f"Error feeding mixed audio: {e}")
+
+    def stop(self):
+        self._stopping.set()
+        try:
+            # Unblock a feed() waiting on the output device
+            self._wave_player.stop()
+        except Exception:
+            pass
+        # The mixer must not be destroyed while a read is in progress
+        self._thread.join()
+
+
 @dataclasses.dataclass
 class SteamAudioPlayer:
     """Audio player using SteamAudio for 3D positioning.
@@ -43,26 +83,76 @@ class SteamAudioPlayer:
     use_synth_volume: bool = True
     volume: int = 100
     use_reverb: bool = True
+    # Rendering and output rate; sounds are converted to it when they are loaded
+    sample_rate: int = 48000
+    # Samples per processing frame; 128 or 256 start sounds sooner at some CPU cost
+    frame_size: int = 1024
+    # Mix through an ambisonic bus of this order instead of spatializing every sound (0)
+    ambisonic_order: int = 0
+    # Sounds that can play at once
+    max_voices: int = 8
+    # Play the mixer through a native WASAPI stream instead of nvwave, falling back to nvwave without one
+    native_output: bool = True
+    # Device period the native output asks for; 0 for the shortest the audio engine offers
+    output_period_ms: int = 3
 
     def __post_init__(self):
-        # Initialize Steam Audio
-        self.steam_audio = steam_audio.get_steam_audio()
-        if not self.steam_audio.initialize():
-            log.error("Failed to initialize Steam Audio")
-            raise RuntimeError("Steam Audio initialization failed")
+        # Without a working engine the player stays silent instead of failing NVDA's plugin load,
+        # and available is False
+        self.steam_audio = None
+        self.mixer = None
+        self._output = None
+        self._feeder = None
+        self.wave_player = None
+        self._last_played_object = None
+        self._last_played_time = 0
+        self._bake_grid = None
+
+        # Initialize Steam Audio. The HRTF loads in the background so it stays off NVDA's startup path;
+        # the mixer pans sounds in stereo until it is ready.
+        try:
+            self.steam_audio = steam_audio.get_steam_audio()
+        except OSError as e:
+            # The DLL is missing, e.g. for 64-bit NVDA, or can't be loaded
+            log.error(f"Audio themes are disabled: {e}")
+            return
+        if not self.steam_audio.initialize(
+            sample_rate=self.sample_rate, frame_size=self.frame_size, background=True
+        ):
+            log.error("Audio themes are disabled: Steam Audio initialization failed")
+            return
+        # Steam Audio is a singleton, so an earlier player may have chosen the rate and frame size
+        self.sample_rate = self.steam_audio.sample_rate
+        self.frame_size = self.steam_audio.frame_size
 
         # Configure default reverb settings
-        self._configure_reverb()
+        self.configure_reverb()
 
-        # Initialize WavePlayer for audio output (stereo, 44100Hz, 16-bit)
-        self._create_wave_player()
+        # Sounds are rendered and mixed natively
+        self.mixer = self.steam_audio.create_mixer(
+            max_voices=self.max_voices, ambisonic_order=self.ambisonic_order
+        )
+        if self.mixer is None:
+            log.error("Audio themes are disabled: Steam Audio mixer creation failed")
+            return
+
+        # The native output pulls each device period straight from the mixer. Without it a WavePlayer
+        # (stereo, 16-bit, at the rendering rate) is fed by a thread that copies finished frames out.
+        if self.native_output:
+            self._output = self.steam_audio.create_output(
+                self.mixer, config.conf["audio"]["outputDevice"], self.output_period_ms
+            )
+        if self._output is not None:
+            rate, channels, period = self._output.get_format()
+            log.debug(f"Native audio output at {rate} Hz, {channels} channels, {period} frame periods")
+        else:
+            if self.native_output:
+                log.debug("Native audio output unavailable, using nvwave")
+            self._create_wave_player()
+            self._feeder = _MixerFeeder(self.mixer, self.wave_player)
 
         # State tracking
-        self._last_played_object = None
-        self._last_played_time = 0
         self._last_played_sound = None
-        self._wave_player_lock = threading.Lock()
-        self._sound_generation = 0
 
         # Desktop dimension caching
         self._cached_desktop_size = None
@@ -76,7 +166,16 @@ class SteamAudioPlayer:
         self._display_height_min = -40.0
         self._display_height_magnitude = 50.0
 
-    def _configure_reverb(self):
+        # Bumped to stop an earlier prewarm that is still running
+        self._prewarm_generation = 0
+        self._prewarm_lock = threading.Lock()
+
+    @property
+    def available(self):
+        """Whether the engine loaded and sounds can be played."""
+        return self.mixer is not None
+
+    def configure_reverb(self):
         """Configure reverb settings from config if available."""
         try:
             conf = config.conf.get("audiothemes", {})
@@ -92,51 +191,147 @@ class SteamAudioPlayer:
             log.debug(f"Using default reverb settings: {e}")
             self.steam_audio.set_reverb_settings(0.1, 1.0, 0.09, 0.3, 1.0)
 
+    def configure_output_cache(self, size_mb):
+        """Set the memory budget for cached renders of recently played sounds."""
+        self.steam_audio.set_output_cache_settings(size_mb * 1024 * 1024)
+
+    def configure_sound_memory(self, budget_mb):
+        """Set how much of the theme's sounds may stay in memory at once; 0 for no limit."""
+        self.steam_audio.set_sound_memory_budget(budget_mb * 1024 * 1024)
+
+    def prewarm(self, sounds):
+        """Bring sounds into memory on a background thread, in order, so their first play doesn't wait.
+
+        A later call replaces the sounds an earlier one hasn't reached yet.
+        """
+        sounds = [sound for sound in sounds if sound is not None]
+        with self._prewarm_lock:
+            self._prewarm_generation += 1
+            generation = self._prewarm_generation
+
+        def run():
+            for sound in sounds:
+                if generation != self._prewarm_generation:
+                    return
+                self.steam_audio.load_sound(sound)
+
+        threading.Thread(target=run, name="AudioThemesPrewarm", daemon=True).start()
+
+    def set_dither(self, enabled):
+        """Add TPDF dither when rendered audio is converted to 16-bit."""
+        self.steam_audio.set_output_dither(enabled)
+
+    def set_fades(self, fade_in_ms, fade_out_ms):
+        """Fade sounds in as they start, and out when a new sound interrupts them; 0 to cut them off."""
+        self.mixer.set_fades(fade_in_ms, fade_out_ms)
+
+    def set_limits(self, role_voices, max_queued, coalesce_ms):
+        """Bound how many sounds of one role play at once, how many wait in the queue and how soon a
+        repeat of a sound is dropped; 0 for no limit."""
+        self.mixer.set_limits(role_voices, max_queued, coalesce_ms)
+
+    def set_scheduling(self, realtime, cpu=-1):
+        """Run the mixer's render thread as a Pro Audio task so NVDA's own work doesn't hold it up,
+        optionally kept to one CPU."""
+        self.mixer.set_scheduling(realtime, cpu)
+
+    def configure_bake(self, enabled, columns=5, rows=3):
+        """Snap sound positions to a grid of screen zones so those positions can be pre-rendered."""
+        self._bake_grid = (max(1, columns), max(1, rows)) if enabled else None
+        if not enabled:
+            self.steam_audio.cancel_bake()
+
+    def bake(self, sounds):
+        """Pre-render sounds at every screen zone into the native cache on background threads.
+
+        Playing a baked sound is then a cache lookup plus mix. Does nothing unless baking is enabled.
+
+        Args:
+            sounds: NativeSound objects returned by make_sound_object()
+        """
+        if self._bake_grid is None:
+            return
+        # Baked renders only match playback with the same gain
+        self._update_volume_cache()
+        desktop_max_x, desktop_max_y = self._get_desktop_size()
+        columns, rows = self._bake_grid
+        if self.audio3d:
+            points = [
+                ((column + 0.5) * desktop_max_x / columns, (row + 0.5) * desktop_max_y / rows)
+                for column in range(columns)
+                for row in range(rows)
+            ]
+        else:
+            points = [self._snap_to_zone(desktop_max_x / 2.0, desktop_max_y / 2.0)]
+        # The mixer renders sounds dry and adds reverb on its shared bus
+        items = []
+        for sound in sounds:
+            if sound is None:
+                continue
+            for obj_x, obj_y in points:
+                angle_x, angle_y = self._point_to_angles(obj_x, obj_y)
+                items.append((sound, angle_x, angle_y, self._cached_volume, False))
+        if not self.steam_audio.bake_sounds(items):
+            log.debug("Sounds were not baked, is the output cache disabled?")
+
+    def _snap_to_zone(self, obj_x, obj_y):
+        """Move a screen position to the centre of its bake zone."""
+        desktop_max_x, desktop_max_y = self._get_desktop_size()
+        columns, rows = self._bake_grid
+        column = clamp(int(obj_x * columns / desktop_max_x), 0, columns - 1)
+        row = clamp(int(obj_y * rows / desktop_max_y), 0, rows - 1)
+        return (column + 0.5) * desktop_max_x / columns, (row + 0.5) * desktop_max_y / rows
+
+    def _point_to_angles(self, obj_x, obj_y):
+        """Map a screen position to clamped (angle_x, angle_y) in degrees."""
+        desktop_max_x, desktop_max_y = self._get_desktop_size()
+        angle_x = ((obj_x - desktop_max_x / 2.0) / desktop_max_x) * self._display_width
+        percent = (desktop_max_y - obj_y) / desktop_max_y
+        angle_y = self._display_height_magnitude * percent + self._display_height_min
+        return clamp(angle_x, -90.0, 90.0), clamp(angle_y, -90.0, 90.0)
+
     def _create_wave_player(self):
         """Create nvwave WavePlayer for audio output."""
         self.wave_player = nvwave.WavePlayer(
             channels=2,
-            samplesPerSec=44100,
+            samplesPerSec=self.sample_rate,
             bitsPerSample=16,
             outputDevice=config.conf["audio"]["outputDevice"],
         )
 
     def make_sound_object(self, filename):
-        """Load a WAV audio file and return a dict with float32 mono samples.
+        """Decode a WAV audio file into DLL-owned storage.
 
         Args:
             filename: Path to WAV audio file
 
         Returns:
-            dict with 'data' (list of float32 samples) and 'sample_rate'
+            steam_audio.NativeSound holding the sound handle, or None on failure
         """
+        if not self.available:
+            return None
         try:
-            with wave.open(filename, "rb") as wav_file:
-                frames = wav_file.readframes(wav_file.getnframes())
-                sample_width = wav_file.getsampwidth()
-                channels = wav_file.getnchannels()
-                sample_rate = wav_file.getframerate()
-
-                # Convert to float32 samples
-                if sample_width == 2:  # 16-bit
-                    samples = struct.unpack(f"<{len(frames) // 2}h", frames)
-                    float_samples = [s / 32768.0 for s in samples]
-                elif sample_width == 1:  # 8-bit
-                    samples = struct.unpack(f"<{len(frames)}B", frames)
-                    float_samples = [(s - 128) / 128.0 for s in samples]
-                else:
-                    raise ValueError(f"Unsupported sample width: {sample_width}")
-
-                # Convert to mono if stereo
-                if channels == 2:
-                    float_samples = [float_samples[i] for i in range(0, len(float_samples), 2)]
-
-                return {"data": float_samples, "sample_rate": sample_rate}
-
+            return self.steam_audio.register_sound(filename)
         except Exception as e:
             log.error(f"Failed to load audio file {filename}: {e}")
             return None
 
+    def load_theme_pack(self, path):
+        """Map the sounds of a theme pack.
+
+        Returns:
+            dict mapping each role to its sound, or None if the pack can't be used
+        """
+        if not self.available:
+            return None
+        return self.steam_audio.register_theme_pack(path)
+
+    def save_theme_pack(self, path, sounds, info):
+        """Write a theme's decoded sounds to a pack for load_theme_pack."""
+        if not self.available:
+            return False
+        return self.steam_audio.write_theme_pack(path, sounds, info)
+
     def _compute_volume(self):
         """Compute volume based on settings."""
         if not self.use_synth_volume:
@@ -172,10 +367,10 @@ class SteamAudioPlayer:
 
         Args:
             obj: NVDA object with location property
-            sound: Dict returned by make_sound_object()
-            role: The controlTypes role being played (optional, for future use)
+            sound: NativeSound returned by make_sound_object()
+            role: The controlTypes role being played (optional); sounds of one role share a voice limit
         """
-        if sound is None:
+        if sound is None or not self.available:
             return
 
         curtime = time.time()
@@ -190,17 +385,8 @@ class SteamAudioPlayer:
         if params is None:
             return
 
-        # Play in background thread (interrupts previous sound for responsive navigation)
-        self._sound_generation += 1
-        my_generation = self._sound_generation
-
-        def play_async():
-            try:
-                self._play_sound_async(params, my_generation)
-            except Exception as e:
-                log.debug(f"Error in async playback: {e}")
-
-        threading.Thread(target=play_async, daemon=True).start()
+        # Interrupts previous sounds for responsive navigation
+        self._play(params, steam_audio.Mixer.PLAY_INTERRUPT, role, PRIORITY_FOCUS)
 
     def play_queued(self, obj, sound, role=None):
         """Play a sound without interrupting current playback.
@@ -209,10 +395,10 @@ class SteamAudioPlayer:
 
         Args:
             obj: NVDA object with location property
-            sound: Dict returned by make_sound_object()
-            role: The controlTypes role being played (optional)
+            sound: NativeSound returned by make_sound_object()
+            role: The controlTypes role being played (optional); sounds of one role share a voice limit
         """
-        if sound is None:
+        if sound is None or not self.available:
             return
 
         # Extract object properties on main thread (COM threading requirement)
@@ -220,14 +406,43 @@ class SteamAudioPlayer:
         if params is None:
             return
 
-        # Play in background thread (queued, doesn't interrupt)
-        def play_async():
-            try:
-                self._play_sound_queued(params)
-            except Exception as e:
-                log.debug(f"Error in queued playback: {e}")
+        # Starts after the sounds already playing, doesn't interrupt
+        self._play(params, steam_audio.Mixer.PLAY_QUEUED, role, PRIORITY_QUEUED)
+
+    def play_moving(self, from_obj, to_obj, sound, role=None):
+        """Play a sound that moves from one object's location to another's over its length.
+
+        The mixer follows the movement a frame at a time, so this is a single play however far it goes.
+
+        Args:
+            from_obj: NVDA object the sound starts at
+            to_obj: NVDA object the sound ends at
+            sound: NativeSound returned by make_sound_object()
+            role: The controlTypes role being played (optional); sounds of one role share a voice limit
+        """
+        if sound is None or not self.available:
+            return
+
+        # Extract object properties on main thread (COM threading requirement)
+        start = self._extract_sound_params(from_obj, sound)
+        end = self._extract_sound_params(to_obj, sound)
+        if start is None or end is None:
+            return
 
-        threading.Thread(target=play_async, daemon=True).start()
+        duration = sound.length / float(sound.sample_rate or self.sample_rate)
+        if not self.mixer.play_path(
+            sound,
+            [
+                (0.0, start["angle_x"], start["angle_y"]),
+                (duration, end["angle_x"], end["angle_y"]),
+            ],
+            gain=start["volume"],
+            reverb_send=1.0 if self._reverb_enabled() else 0.0,
+            flags=steam_audio.Mixer.PLAY_INTERRUPT,
+            group=-1 if role is None else int(role),
+            priority=PRIORITY_FOCUS,
+        ):
+            log.debug("Failed to play sound with Steam Audio")
 
     def _extract_sound_params(self, obj, sound):
         """Extract parameters needed for sound playback from NVDA object.
@@ -247,100 +462,45 @@ class SteamAudioPlayer:
             obj_x = desktop_max_x / 2.0
             obj_y = desktop_max_y / 2.0
 
-        # Scale object position to audio display
-        angle_x = ((obj_x - desktop_max_x / 2.0) / desktop_max_x) * self._display_width
-        percent = (desktop_max_y - obj_y) / desktop_max_y
-        angle_y = self._display_height_magnitude * percent + self._display_height_min
+        # Baked renders exist only for zone centres
+        if self._bake_grid is not None:
+            obj_x, obj_y = self._snap_to_zone(obj_x, obj_y)
 
-        # Clamp angles to valid ranges
-        angle_x = clamp(angle_x, -90.0, 90.0)
-        angle_y = clamp(angle_y, -90.0, 90.0)
+        # Scale object position to audio display, clamped to valid ranges
+        angle_x, angle_y = self._point_to_angles(obj_x, obj_y)
 
         return {
-            "sound_data": sound["data"],
+            "sound": sound,
             "angle_x": angle_x,
             "angle_y": angle_y,
             "volume": self._cached_volume,
         }
 
-    def _play_sound_async(self, params, generation):
-        """Process and play sound on background thread."""
-        sound_data = params["sound_data"]
-        angle_x = params["angle_x"]
-        angle_y = params["angle_y"]
-        volume = params["volume"]
-
-        # Adjust volume
-        adjusted_audio = [sample * volume for sample in sound_data]
-
-        # Process with Steam Audio for 3D positioning
-        processed_audio = self.steam_audio.process_sound(
-            adjusted_audio, angle_x, angle_y
-        )
-        if not processed_audio:
-            log.debug("Failed to process sound with Steam Audio")
-            return
-
-        # Apply reverb if enabled
-        final_audio = processed_audio
-        if self.use_reverb:
-            try:
-                conf = config.conf.get("audiothemes", {})
-                if conf.get("use_reverb", True):
-                    reverb_audio = self.steam_audio.apply_reverb(processed_audio)
-                    if reverb_audio:
-                        final_audio = reverb_audio
-            except Exception:
-                pass
-
-        # Check if this sound has been superseded
-        if generation != self._sound_generation:
-            return
-
-        # Stop previous sound and play new one
-        self.wave_player.stop()
-
-        with self._wave_player_lock:
-            if generation != self._sound_generation:
-                return
-            self.wave_player.feed(final_audio)
+    def _reverb_enabled(self):
+        """Whether reverb should be applied to played sounds."""
+        if not self.use_reverb:
+            return False
+        try:
+            return config.conf.get("audiothemes", {}).get("use_reverb", True)
+        except Exception:
+            return False
 
-    def _play_sound_queued(self, params):
-        """Process and queue sound without interrupting current playback.
+    def _play(self, params, flags, role, priority):
+        """Hand a sound to the native mixer, which renders it on its own thread.
 
-        Sounds are queued and play one after another instead of interrupting.
+        Sounds of one role share the mixer's per group voice limit.
         """
-        sound_data = params["sound_data"]
-        angle_x = params["angle_x"]
-        angle_y = params["angle_y"]
-        volume = params["volume"]
-
-        # Adjust volume
-        adjusted_audio = [sample * volume for sample in sound_data]
-
-        # Process with Steam Audio for 3D positioning
-        processed_audio = self.steam_audio.process_sound(
-            adjusted_audio, angle_x, angle_y
-        )
-        if not processed_audio:
-            log.debug("Failed to process sound with Steam Audio")
-            return
-
-        # Apply reverb if enabled
-        final_audio = processed_audio
-        if self.use_reverb:
-            try:
-                conf = config.conf.get("audiothemes", {})
-                if conf.get("use_reverb", True):
-                    reverb_audio = self.steam_audio.apply_reverb(processed_audio)
-                    if reverb_audio:
-                        final_audio = reverb_audio
-            except Exception:
-                pass
-
-        # Queue the sound (no stop() call - sounds play sequentially)
-        with self._wave_player_lock:
-            self.wave_player.feed(final_audio)
+        if not self.mixer.play(
+            params["sound"],
+            params["angle_x"],
+            params["angle_y"],
+            gain=params["volume"],
+            reverb_send=1.0 if self._reverb_enabled() else 0.0,
+            flags=flags,
+            group=-1 if role is None else int(role),
+            priority=priority,
+        ):
+            log.debug("Failed to play sound with Steam Audio")
 
     def play_file(self, filepath):
         """Play an audio file directly (for theme editor preview).
@@ -348,26 +508,15 @@ class SteamAudioPlayer:
         Args:
             filepath: Path to audio file
         """
+        if not self.available:
+            return
         sound = self.make_sound_object(os.path.abspath(filepath))
         if sound is None:
             return
 
-        self._sound_generation += 1
-        my_generation = self._sound_generation
-
-        def play_async():
-            try:
-                # Play centered (no 3D positioning for preview)
-                processed = self.steam_audio.process_sound(sound["data"], 0.0, 0.0)
-                if processed and my_generation == self._sound_generation:
-                    self.wave_player.stop()
-                    with self._wave_player_lock:
-                        if my_generation == self._sound_generation:
-                            self.wave_player.feed(processed)
-            except Exception as e:
-                log.debug(f"Error playing file: {e}")
-
-        threading.Thread(target=play_async, daemon=True).start()
+        # Play centered (no 3D positioning for preview). The mixer keeps the samples alive
+        # after the handle is released.
+        self.mixer.play(sound, 0.0, 0.0, flags=steam_audio.Mixer.PLAY_INTERRUPT, priority=PRIORITY_PREVIEW)
 
     def close(self):
         """Clean up resources.
@@ -375,11 +524,59 @@ class SteamAudioPlayer:
         Note: Does NOT clean up Steam Audio since it's a shared singleton.
         Steam Audio cleanup happens only when the main plugin terminates.
         """
-        try:
-            with self._wave_player_lock:
-                self.wave_player.close()
-        except Exception:
-            pass
+        feeder = getattr(self, "_feeder", None)
+        if feeder is not None:
+            feeder.stop()
+            self._feeder = None
+        output = getattr(self, "_output", None)
+        if output is not None:
+            output.destroy()
+            self._output = None
+        mixer = getattr(self, "mixer", None)
+        if mixer is not None:
+            mixer.destroy()
+            self.mixer = None
+        wave_player = getattr(self, "wave_player", None)
+        if wave_player is not None:
+            try:
+                wave_player.close()
+            except Exception:
+                pass
+            self.wave_player = None
+
+    def stats_report(self):
+        """Describe the native engine's counters and stage timings as text for the log."""
+        if not self.available:
+            return "Audio Themes engine is disabled"
+        stats = self.steam_audio.get_audio_stats()
+        lines = [
+            f"Audio Themes engine stats ({self.steam_audio.get_simd_name()} kernels)",
+            "frames rendered {frames_rendered}, tail frames skipped {tail_frames_skipped}, "
+            "cache hits {cache_hits}, cache misses {cache_misses}, "
+            "mixer underruns {mixer_underruns}, failures {failures}, "
+            "renders cancelled {renders_cancelled}, "
+            "sounds mapped {sounds_mapped}, sounds unmapped {sounds_unmapped}, "
+            "sound bytes mapped {sound_bytes_mapped}, "
+            "plays coalesced {plays_coalesced}, plays rejected {plays_rejected}, "
+            "voices stolen {voices_stolen}, deadline misses {deadline_misses}, "
+            "priority inversions {priority_inversions}, "
+            "realtime threads {realtime_threads}, device outputs {device_outputs}".format(**stats),
+        ]
+        for name, stage in stats["stages"].items():
+            if not stage["count"]:
+                continue
+            # Non-empty histogram buckets as "upper bound: count"
+            buckets = ", ".join(
+                f"<{1 << i}us: {count}" if i < steam_audio.STAT_BUCKETS - 1
+                else f">={1 << (i - 1)}us: {count}"
+                for i, count in enumerate(stage["histogram"])
+                if count
+            )
+            lines.append(
+                f"{name}: {stage['count']} calls, "
+                f"avg {stage['total_us'] / stage['count']:.1f}us, max {stage['max_us']:.1f}us ({buckets})"
+            )
+        return "\n".join(lines)
 
     def close_and_cleanup_steam_audio(self):
         """Clean up all resources including Steam Audio singleton.
@@ -387,7 +584,7 @@ class SteamAudioPlayer:
         Only call this when the main plugin is terminating.
         """
         self.close()
-        if hasattr(self, "steam_audio"):
+        if getattr(self, "steam_audio", None) is not None:
             self.steam_audio.cleanup()
 
     def __del__(self):
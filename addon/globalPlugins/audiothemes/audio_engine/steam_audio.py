@@ -5,18 +5,24 @@ Provides 3D audio positioning, reverb, and 16-bit sample output
 
 import ctypes
 import os
-import struct
 import threading
-from ctypes import c_bool, c_int, c_float, POINTER, byref
+from ctypes import c_bool, c_int, c_float, c_void_p, c_wchar_p, POINTER, byref
 
 try:
 	from logHandler import log
 except ImportError:
 	import logging as log
 
-# Global mutex for thread-safe DLL access
+# Global mutex for initialization and cleanup. Rendering is serialised per voice instead,
+# since every voice has its own native renderer.
 _steam_audio_mutex = threading.Lock()
 
+# Values returned by get_steam_audio_status()
+STATUS_UNINITIALIZED = 0
+STATUS_LOADING = 1
+STATUS_READY = 2
+STATUS_FAILED = 3
+
 # Keep references to loaded DLLs to prevent unloading
 _loaded_dlls = []
 
@@ -40,25 +46,174 @@ def _preload_dependencies(addon_dir):
 			log.warning(f"Could not pre-load phonon.dll: {e}")
 
 
+class NativeSound:
+	"""A sound decoded into DLL-owned storage, released when this object is garbage collected."""
+
+	def __init__(self, dll, handle):
+		self._dll = dll
+		self.handle = handle
+		length = c_int()
+		sample_rate = c_int()
+		dll.get_sound_info(handle, byref(length), byref(sample_rate))
+		self.length = length.value
+		self.sample_rate = sample_rate.value
+
+	def release(self):
+		if self.handle:
+			self._dll.release_sound(self.handle)
+			self.handle = 0
+
+	def __deepcopy__(self, memo):
+		# The native storage is shared, never duplicated (dataclasses.asdict deep-copies values)
+		return self
+
+	def __del__(self):
+		try:
+			self.release()
+		except Exception:
+			pass
+
+
+class BatchSound(ctypes.Structure):
+	"""One entry of a process_batch() request, laid out like the native BatchSound"""
+
+	_fields_ = [
+		("sound", c_int),
+		("angleX", c_float),
+		("angleY", c_float),
+		("gain", c_float),
+		("reverb", c_int),
+		("startOffset", c_int),
+	]
+
+
+class DirectionKeyframe(ctypes.Structure):
+	"""Where a moving sound is, time seconds after it starts, laid out like the native DirectionKeyframe"""
+
+	_fields_ = [
+		("time", c_float),
+		("angleX", c_float),
+		("angleY", c_float),
+	]
+
+
+# Most keyframes a moving sound's path can have
+MAX_DIRECTION_KEYFRAMES = 16
+
+
+def _make_keyframes(keyframes):
+	"""Pack (time, angle_x, angle_y) tuples for the DLL, or None if there are none or too many"""
+	if not keyframes or len(keyframes) > MAX_DIRECTION_KEYFRAMES:
+		return None
+	return (DirectionKeyframe * len(keyframes))(*(DirectionKeyframe(*key) for key in keyframes))
+
+
+# Stages timed by the DLL, in the order of AudioStats.stages
+STAT_STAGES = (
+	"process_sound",
+	"apply_reverb",
+	"render_sound",
+	"allocation",
+	"conversion",
+	"resample",
+	"mixer_frame",
+	"first_frame",
+)
+
+# Instruction sets the DSP kernels can use, by get_simd_level value
+SIMD_LEVELS = ("scalar", "SSE2", "AVX2")
+
+# Bucket 0 counts calls under 1 us, bucket i calls of [2^(i-1), 2^i) us, the last one everything longer
+STAT_BUCKETS = 20
+
+
+class StageStats(ctypes.Structure):
+	"""Timings of one stage, laid out like the native StageStats"""
+
+	_fields_ = [
+		("count", ctypes.c_longlong),
+		("totalNs", ctypes.c_longlong),
+		("maxNs", ctypes.c_longlong),
+		("buckets", ctypes.c_longlong * STAT_BUCKETS),
+	]
+
+
+class AudioStats(ctypes.Structure):
+	"""Counters filled in by get_audio_stats, laid out like the native AudioStats"""
+
+	_fields_ = [
+		("stages", StageStats * len(STAT_STAGES)),
+		("framesRendered", ctypes.c_longlong),
+		("tailFramesSkipped", ctypes.c_longlong),
+		("cacheHits", ctypes.c_longlong),
+		("cacheMisses", ctypes.c_longlong),
+		("mixerUnderruns", ctypes.c_longlong),
+		("failures", ctypes.c_longlong),
+		("rendersCancelled", ctypes.c_longlong),
+		("soundsMapped", ctypes.c_longlong),
+		("soundsUnmapped", ctypes.c_longlong),
+		("soundBytesMapped", ctypes.c_longlong),
+		("playsCoalesced", ctypes.c_longlong),
+		("playsRejected", ctypes.c_longlong),
+		("voicesStolen", ctypes.c_longlong),
+		("deadlineMisses", ctypes.c_longlong),
+		("priorityInversions", ctypes.c_longlong),
+		("realtimeThreads", ctypes.c_longlong),
+		("deviceOutputs", ctypes.c_longlong),
+	]
+
+
+class _Voice:
+	"""A native renderer and its reusable output buffer, used by one caller at a time."""
+
+	def __init__(self, renderer):
+		self.renderer = renderer
+		self.buffer = None
+		self.lock = threading.Lock()
+		# Bumped by SteamAudio.cancel_render(), so a render that fails because of it isn't logged as an error
+		self.cancels = 0
+		self.cancelled = False
+
+	def get_buffer(self, samples):
+		"""Return the int16 output buffer, growing it if it is too small. Call with lock held."""
+		if self.buffer is None or len(self.buffer) < samples:
+			# Round up so slightly longer sounds don't force a reallocation
+			capacity = max(samples, 2 * len(self.buffer) if self.buffer is not None else 0)
+			self.buffer = (ctypes.c_int16 * capacity)()
+		return self.buffer
+
+
 # Define ctypes for the DLL functions
 class SteamAudio:
 	def __init__(self, dll_path=None):
 		"""Initialize Steam Audio wrapper
 
 		Args:
-		    dll_path: Path to steam_audio.dll. If None, looks in addon directory.
+		    dll_path: Path to steam_audio.dll. If None, looks in the addon directory, or its x64
+		        subdirectory when running in a 64-bit NVDA.
 		"""
 		self.dll = None
 		self.initialized = False
+		# Renderers and output buffers by voice name (e.g. "main", "queued"), so voices render concurrently
+		self._voices = {}
+		self._voices_lock = threading.Lock()
 
+		is_64bit = ctypes.sizeof(ctypes.c_void_p) == 8
 		if dll_path is None:
 			# Look for DLL in the parent directory (audiothemes/)
 			addon_dir = os.path.dirname(os.path.dirname(__file__))
+			if is_64bit:
+				addon_dir = os.path.join(addon_dir, "x64")
 			dll_path = os.path.join(addon_dir, "steam_audio.dll")
 		else:
 			addon_dir = os.path.dirname(dll_path)
 
 		if not os.path.exists(dll_path):
+			if is_64bit:
+				raise FileNotFoundError(
+					f"This copy of the add-on has no 64-bit build of steam_audio.dll for 64-bit NVDA "
+					f"(expected at {dll_path}, built by build64.bat)"
+				)
 			raise FileNotFoundError(f"Steam Audio DLL not found at: {dll_path}")
 
 		try:
@@ -66,7 +221,14 @@ class SteamAudio:
 			_preload_dependencies(addon_dir)
 
 			self.dll = ctypes.CDLL(dll_path)
-			self._setup_function_signatures()
+			try:
+				self._setup_function_signatures()
+			except AttributeError as e:
+				# ctypes names the first export the DLL lacks
+				raise OSError(
+					f"{dll_path} is older than this add-on ({e}); rebuild it from main.cpp with build32.bat "
+					"and build64.bat"
+				) from None
 			log.debug(f"Steam Audio DLL loaded from: {dll_path}")
 		except Exception as e:
 			log.error(f"Failed to load Steam Audio DLL: {e}")
@@ -79,10 +241,26 @@ class SteamAudio:
 		self.dll.initialize_steam_audio.argtypes = [c_int, c_int]
 		self.dll.initialize_steam_audio.restype = c_bool
 
+		# bool initialize_steam_audio_async(int samplingrate, int framesize)
+		self.dll.initialize_steam_audio_async.argtypes = [c_int, c_int]
+		self.dll.initialize_steam_audio_async.restype = c_bool
+
+		# int get_steam_audio_status()
+		self.dll.get_steam_audio_status.argtypes = []
+		self.dll.get_steam_audio_status.restype = c_int
+
 		# void cleanup_steam_audio()
 		self.dll.cleanup_steam_audio.argtypes = []
 		self.dll.cleanup_steam_audio.restype = None
 
+		# Renderer* create_renderer(int samplingrate, int framesize)
+		self.dll.create_renderer.argtypes = [c_int, c_int]
+		self.dll.create_renderer.restype = c_void_p
+
+		# void destroy_renderer(Renderer* renderer)
+		self.dll.destroy_renderer.argtypes = [c_void_p]
+		self.dll.destroy_renderer.restype = None
+
 		# bool set_reverb_settings(float room_size, float damping, float wet_level, float dry_level, float width)
 		self.dll.set_reverb_settings.argtypes = [
 			c_float,
@@ -93,8 +271,9 @@ class SteamAudio:
 		]
 		self.dll.set_reverb_settings.restype = c_bool
 
-		# bool process_sound(const float* input_buffer, int input_length, float angle_x, float angle_y, int16_t** output_buffer, int* output_length)
+		# bool process_sound(Renderer* renderer, const float* input_buffer, int input_length, float angle_x, float angle_y, int16_t** output_buffer, int* output_length)
 		self.dll.process_sound.argtypes = [
+			c_void_p,  # renderer
 			POINTER(c_float),  # input_buffer
 			c_int,  # input_length
 			c_float,  # angle_x
@@ -104,8 +283,9 @@ class SteamAudio:
 		]
 		self.dll.process_sound.restype = c_bool
 
-		# bool apply_reverb(const int16_t* input_buffer, int input_length, int16_t** output_buffer, int* output_length)
+		# bool apply_reverb(Renderer* renderer, const int16_t* input_buffer, int input_length, int16_t** output_buffer, int* output_length)
 		self.dll.apply_reverb.argtypes = [
+			c_void_p,  # renderer
 			POINTER(ctypes.c_int16),  # input_buffer
 			c_int,  # input_length
 			POINTER(POINTER(ctypes.c_int16)),  # output_buffer
@@ -117,38 +297,317 @@ class SteamAudio:
 		self.dll.free_output_sound.argtypes = [POINTER(ctypes.c_int16)]
 		self.dll.free_output_sound.restype = None
 
-	def initialize(self, sample_rate=44100, frame_size=1024):
+		# int get_output_length(Renderer* renderer, int input_frames, bool include_reverb_tail)
+		self.dll.get_output_length.argtypes = [c_void_p, c_int, c_bool]
+		self.dll.get_output_length.restype = c_int
+
+		# bool process_sound_into(Renderer* renderer, const float* input_buffer, int input_length, float angle_x, float angle_y, int16_t* output_buffer, int output_capacity, int* output_length)
+		self.dll.process_sound_into.argtypes = [
+			c_void_p,  # renderer
+			POINTER(c_float),  # input_buffer
+			c_int,  # input_length
+			c_float,  # angle_x
+			c_float,  # angle_y
+			POINTER(ctypes.c_int16),  # output_buffer
+			c_int,  # output_capacity
+			POINTER(c_int),  # output_length
+		]
+		self.dll.process_sound_into.restype = c_bool
+
+		# bool apply_reverb_into(Renderer* renderer, const int16_t* input_buffer, int input_length, int16_t* output_buffer, int output_capacity, int* output_length)
+		self.dll.apply_reverb_into.argtypes = [
+			c_void_p,  # renderer
+			POINTER(ctypes.c_int16),  # input_buffer
+			c_int,  # input_length
+			POINTER(ctypes.c_int16),  # output_buffer
+			c_int,  # output_capacity
+			POINTER(c_int),  # output_length
+		]
+		self.dll.apply_reverb_into.restype = c_bool
+
+		# bool render_sound_into(Renderer* renderer, const float* input_buffer, int input_length, float angle_x, float angle_y, float gain, bool use_reverb, int16_t* output_buffer, int output_capacity, int* output_length)
+		self.dll.render_sound_into.argtypes = [
+			c_void_p,  # renderer
+			POINTER(c_float),  # input_buffer
+			c_int,  # input_length
+			c_float,  # angle_x
+			c_float,  # angle_y
+			c_float,  # gain
+			c_bool,  # use_reverb
+			POINTER(ctypes.c_int16),  # output_buffer
+			c_int,  # output_capacity
+			POINTER(c_int),  # output_length
+		]
+		self.dll.render_sound_into.restype = c_bool
+
+		# int register_sound(const wchar_t* path)
+		self.dll.register_sound.argtypes = [c_wchar_p]
+		self.dll.register_sound.restype = c_int
+
+		# int register_sound_pcm(const float* samples, int length, int sample_rate)
+		self.dll.register_sound_pcm.argtypes = [POINTER(c_float), c_int, c_int]
+		self.dll.register_sound_pcm.restype = c_int
+
+		# bool write_theme_pack(const wchar_t* path, const int* roles, const int* handles, int count, const char* info)
+		self.dll.write_theme_pack.argtypes = [
+			c_wchar_p,  # path
+			POINTER(c_int),  # roles
+			POINTER(c_int),  # handles
+			c_int,  # count
+			ctypes.c_char_p,  # info
+		]
+		self.dll.write_theme_pack.restype = c_bool
+
+		# int register_theme_pack(const wchar_t* path, int* roles, int* handles, int capacity)
+		self.dll.register_theme_pack.argtypes = [c_wchar_p, POINTER(c_int), POINTER(c_int), c_int]
+		self.dll.register_theme_pack.restype = c_int
+
+		# void release_sound(int handle)
+		self.dll.release_sound.argtypes = [c_int]
+		self.dll.release_sound.restype = None
+
+		# bool get_sound_info(int handle, int* length, int* sample_rate)
+		self.dll.get_sound_info.argtypes = [c_int, POINTER(c_int), POINTER(c_int)]
+		self.dll.get_sound_info.restype = c_bool
+
+		# int get_sound_output_length(Renderer* renderer, int handle, bool include_reverb_tail)
+		self.dll.get_sound_output_length.argtypes = [c_void_p, c_int, c_bool]
+		self.dll.get_sound_output_length.restype = c_int
+
+		# bool process_sound_handle(Renderer* renderer, int handle, float angle_x, float angle_y, float gain, bool use_reverb, int16_t* output_buffer, int output_capacity, int* output_length)
+		self.dll.process_sound_handle.argtypes = [
+			c_void_p,  # renderer
+			c_int,  # handle
+			c_float,  # angle_x
+			c_float,  # angle_y
+			c_float,  # gain
+			c_bool,  # use_reverb
+			POINTER(ctypes.c_int16),  # output_buffer
+			c_int,  # output_capacity
+			POINTER(c_int),  # output_length
+		]
+		self.dll.process_sound_handle.restype = c_bool
+
+		# bool process_sound_path(Renderer* renderer, int handle, const DirectionKeyframe* keyframes, int keyframe_count, float gain, bool use_reverb, int16_t* output_buffer, int output_capacity, int* output_length)
+		self.dll.process_sound_path.argtypes = [
+			c_void_p,  # renderer
+			c_int,  # handle
+			POINTER(DirectionKeyframe),  # keyframes
+			c_int,  # keyframe_count
+			c_float,  # gain
+			c_bool,  # use_reverb
+			POINTER(ctypes.c_int16),  # output_buffer
+			c_int,  # output_capacity
+			POINTER(c_int),  # output_length
+		]
+		self.dll.process_sound_path.restype = c_bool
+
+		# void set_sound_memory_budget(long long bytes)
+		self.dll.set_sound_memory_budget.argtypes = [ctypes.c_longlong]
+		self.dll.set_sound_memory_budget.restype = None
+
+		# bool load_sound(int handle)
+		self.dll.load_sound.argtypes = [c_int]
+		self.dll.load_sound.restype = c_bool
+
+		# void set_output_cache_settings(int max_bytes, float angle_step)
+		self.dll.set_output_cache_settings.argtypes = [c_int, c_float]
+		self.dll.set_output_cache_settings.restype = None
+
+		# void get_output_cache_stats(long long* hits, long long* misses, int* entries, long long* bytes)
+		self.dll.get_output_cache_stats.argtypes = [
+			POINTER(ctypes.c_longlong),
+			POINTER(ctypes.c_longlong),
+			POINTER(c_int),
+			POINTER(ctypes.c_longlong),
+		]
+		self.dll.get_output_cache_stats.restype = None
+
+		# void get_audio_stats(AudioStats* stats)
+		self.dll.get_audio_stats.argtypes = [POINTER(AudioStats)]
+		self.dll.get_audio_stats.restype = None
+
+		# void reset_audio_stats()
+		self.dll.reset_audio_stats.argtypes = []
+		self.dll.reset_audio_stats.restype = None
+
+		# void cancel_render(Renderer* renderer)
+		self.dll.cancel_render.argtypes = [c_void_p]
+		self.dll.cancel_render.restype = None
+
+		# int get_simd_level()
+		self.dll.get_simd_level.argtypes = []
+		self.dll.get_simd_level.restype = c_int
+
+		# void clear_output_cache()
+		self.dll.clear_output_cache.argtypes = []
+		self.dll.clear_output_cache.restype = None
+
+		# void set_hrtf_interpolation(bool bilinear)
+		self.dll.set_hrtf_interpolation.argtypes = [c_bool]
+		self.dll.set_hrtf_interpolation.restype = None
+
+		# void set_output_dither(bool enabled)
+		self.dll.set_output_dither.argtypes = [c_bool]
+		self.dll.set_output_dither.restype = None
+
+		# int get_batch_output_length(Renderer* renderer, const BatchSound* items, int count, int flags)
+		self.dll.get_batch_output_length.argtypes = [c_void_p, POINTER(BatchSound), c_int, c_int]
+		self.dll.get_batch_output_length.restype = c_int
+
+		# bool process_batch(Renderer* renderer, const BatchSound* items, int count, int flags, int16_t* output_buffer, int output_capacity, int* output_length)
+		self.dll.process_batch.argtypes = [
+			c_void_p,  # renderer
+			POINTER(BatchSound),  # items
+			c_int,  # count
+			c_int,  # flags
+			POINTER(ctypes.c_int16),  # output_buffer
+			c_int,  # output_capacity
+			POINTER(c_int),  # output_length
+		]
+		self.dll.process_batch.restype = c_bool
+
+		# bool bake_sounds(const BatchSound* items, int count)
+		self.dll.bake_sounds.argtypes = [POINTER(BatchSound), c_int]
+		self.dll.bake_sounds.restype = c_bool
+
+		# void cancel_bake()
+		self.dll.cancel_bake.argtypes = []
+		self.dll.cancel_bake.restype = None
+
+		# void get_bake_progress(int* done, int* total)
+		self.dll.get_bake_progress.argtypes = [POINTER(c_int), POINTER(c_int)]
+		self.dll.get_bake_progress.restype = None
+
+		# Mixer* create_mixer(int max_voices, int ambisonic_order)
+		self.dll.create_mixer.argtypes = [c_int, c_int]
+		self.dll.create_mixer.restype = c_void_p
+
+		# void destroy_mixer(Mixer* mixer)
+		self.dll.destroy_mixer.argtypes = [c_void_p]
+		self.dll.destroy_mixer.restype = None
+
+		# bool mixer_play(Mixer* mixer, int handle, float angle_x, float angle_y, float gain, float reverb_send, int flags, int group, int priority)
+		self.dll.mixer_play.argtypes = [
+			c_void_p,  # mixer
+			c_int,  # handle
+			c_float,  # angle_x
+			c_float,  # angle_y
+			c_float,  # gain
+			c_float,  # reverb_send
+			c_int,  # flags
+			c_int,  # group
+			c_int,  # priority
+		]
+		self.dll.mixer_play.restype = c_bool
+
+		# bool mixer_play_path(Mixer* mixer, int handle, const DirectionKeyframe* keyframes, int keyframe_count, float gain, float reverb_send, int flags, int group, int priority)
+		self.dll.mixer_play_path.argtypes = [
+			c_void_p,  # mixer
+			c_int,  # handle
+			POINTER(DirectionKeyframe),  # keyframes
+			c_int,  # keyframe_count
+			c_float,  # gain
+			c_float,  # reverb_send
+			c_int,  # flags
+			c_int,  # group
+			c_int,  # priority
+		]
+		self.dll.mixer_play_path.restype = c_bool
+
+		# void mixer_interrupt(Mixer* mixer)
+		self.dll.mixer_interrupt.argtypes = [c_void_p]
+		self.dll.mixer_interrupt.restype = None
+
+		# void set_mixer_lead(Mixer* mixer, int lead_ms)
+		self.dll.set_mixer_lead.argtypes = [c_void_p, c_int]
+		self.dll.set_mixer_lead.restype = None
+
+		# void set_mixer_fades(Mixer* mixer, int fade_in_ms, int fade_out_ms)
+		self.dll.set_mixer_fades.argtypes = [c_void_p, c_int, c_int]
+		self.dll.set_mixer_fades.restype = None
+
+		# void set_mixer_limits(Mixer* mixer, int group_voices, int max_queued, int coalesce_ms)
+		self.dll.set_mixer_limits.argtypes = [c_void_p, c_int, c_int, c_int]
+		self.dll.set_mixer_limits.restype = None
+
+		# void set_mixer_scheduling(Mixer* mixer, bool pro_audio, int cpu)
+		self.dll.set_mixer_scheduling.argtypes = [c_void_p, c_bool, c_int]
+		self.dll.set_mixer_scheduling.restype = None
+
+		# int mixer_read(Mixer* mixer, int16_t* output_buffer, int max_frames, int timeout_ms, bool* interrupted)
+		self.dll.mixer_read.argtypes = [
+			c_void_p,  # mixer
+			POINTER(ctypes.c_int16),  # output_buffer
+			c_int,  # max_frames
+			c_int,  # timeout_ms
+			POINTER(c_bool),  # interrupted
+		]
+		self.dll.mixer_read.restype = c_int
+
+		# DeviceOutput* create_output(Mixer* mixer, const wchar_t* device_name, int period_ms)
+		self.dll.create_output.argtypes = [c_void_p, c_wchar_p, c_int]
+		self.dll.create_output.restype = c_void_p
+
+		# void destroy_output(DeviceOutput* output)
+		self.dll.destroy_output.argtypes = [c_void_p]
+		self.dll.destroy_output.restype = None
+
+		# void get_output_format(DeviceOutput* output, int* sample_rate, int* channels, int* period_frames)
+		self.dll.get_output_format.argtypes = [c_void_p, POINTER(c_int), POINTER(c_int), POINTER(c_int)]
+		self.dll.get_output_format.restype = None
+
+	def initialize(self, sample_rate=44100, frame_size=1024, background=False):
 		"""Initialize Steam Audio with given parameters
 
 		Args:
 		    sample_rate: Audio sample rate in Hz (default: 44100)
 		    frame_size: Audio frame size in samples (default: 1024)
+		    background: Load the HRTF on a native thread and return straight away.
+		        Mixers work meanwhile, panning sounds until is_ready() becomes True.
 
 		Returns:
-		    bool: True if initialization successful, False otherwise
+		    bool: True if initialization successful (or started), False otherwise
 		"""
 		if self.initialized:
 			log.debug("Steam Audio already initialized")
 			return True
 
 		with _steam_audio_mutex:
-			success = self.dll.initialize_steam_audio(sample_rate, frame_size)
+			if background:
+				success = self.dll.initialize_steam_audio_async(sample_rate, frame_size)
+			else:
+				success = self.dll.initialize_steam_audio(sample_rate, frame_size)
 			if success:
 				self.initialized = True
 				self.sample_rate = sample_rate
 				self.frame_size = frame_size
 				log.debug(
-					f"Steam Audio initialized: {sample_rate}Hz, {frame_size} samples"
+					f"Steam Audio initialized: {sample_rate}Hz, {frame_size} samples, "
+					f"{self.get_simd_name()} kernels"
 				)
 			else:
 				log.error("Failed to initialize Steam Audio")
 
 		return success
 
+	def get_status(self):
+		"""Return one of the STATUS_* values"""
+		return self.dll.get_steam_audio_status()
+
+	def is_ready(self):
+		"""Whether the HRTF has loaded and sounds are spatialized"""
+		return self.get_status() == STATUS_READY
+
 	def cleanup(self):
 		"""Cleanup Steam Audio resources"""
 		if self.initialized:
 			with _steam_audio_mutex:
+				with self._voices_lock:
+					for voice in self._voices.values():
+						with voice.lock:
+							self.dll.destroy_renderer(voice.renderer)
+					self._voices.clear()
 				self.dll.cleanup_steam_audio()
 				self.initialized = False
 			log.debug("Steam Audio cleaned up")
@@ -170,26 +629,73 @@ class SteamAudio:
 			log.error("Steam Audio not initialized")
 			return False
 
-		with _steam_audio_mutex:
-			success = self.dll.set_reverb_settings(
-				room_size, damping, wet_level, dry_level, width
+		# Renderers pick the new settings up before their next reverb render
+		success = self.dll.set_reverb_settings(
+			room_size, damping, wet_level, dry_level, width
+		)
+		if success:
+			log.debug(
+				f"Reverb settings updated: room_size={room_size}, damping={damping}, wet_level={wet_level}, dry_level={dry_level}, width={width}"
 			)
-			if success:
-				log.debug(
-					f"Reverb settings updated: room_size={room_size}, damping={damping}, wet_level={wet_level}, dry_level={dry_level}, width={width}"
-				)
-			else:
-				log.error("Failed to set reverb settings")
+		else:
+			log.error("Failed to set reverb settings")
 
 		return success
 
-	def process_sound(self, input_buffer, angle_x, angle_y):
+	def _get_voice(self, name):
+		"""Return the named voice, creating its native renderer on first use"""
+		with self._voices_lock:
+			voice = self._voices.get(name)
+			if voice is None:
+				if not self.is_ready():
+					log.debug("Steam Audio is still loading, no renderer available yet")
+					return None
+				renderer = self.dll.create_renderer(self.sample_rate, self.frame_size)
+				if not renderer:
+					log.error(f"Failed to create renderer for voice {name}")
+					return None
+				voice = _Voice(renderer)
+				self._voices[name] = voice
+			return voice
+
+	def cancel_render(self, voice="main"):
+		"""Abandon the render running on a voice, for a sound that has been superseded
+
+		The interrupted call stops at its next processing frame and returns None without logging an
+		error. Later calls on the voice are unaffected. Never blocks on the render.
+		"""
+		with self._voices_lock:
+			voice = self._voices.get(voice)
+		if voice is not None:
+			voice.cancels += 1
+			self.dll.cancel_render(voice.renderer)
+
+	def _render_into(self, voice, output_samples, render):
+		"""Run render(output_buffer, capacity, output_length) into the voice's buffer and copy the result out.
+
+		Must be called with voice.lock held.
+		"""
+		cancels = voice.cancels
+		output_length = c_int()
+		output_buffer = voice.get_buffer(output_samples)
+		success = render(output_buffer, len(output_buffer), byref(output_length))
+		if not success and output_length.value > len(output_buffer):
+			# The reverb tail grew between sizing and rendering (new reverb settings)
+			output_buffer = voice.get_buffer(output_length.value)
+			success = render(output_buffer, len(output_buffer), byref(output_length))
+		voice.cancelled = not success and voice.cancels != cancels
+		if not success:
+			return None
+		return ctypes.string_at(output_buffer, output_length.value * 2)
+
+	def process_sound(self, input_buffer, angle_x, angle_y, voice="main"):
 		"""Process audio with 3D positioning (without reverb)
 
 		Args:
 		    input_buffer: list of float32 mono audio samples
 		    angle_x: Horizontal angle in degrees (-90 to 90)
 		    angle_y: Vertical angle in degrees (-90 to 90)
+		    voice: Name of the voice whose renderer and output buffer are used
 
 		Returns:
 		    bytes: Stereo 16-bit audio samples as bytes, or None if failed
@@ -203,111 +709,524 @@ class SteamAudio:
 		input_ptr = ctypes.cast(input_array, POINTER(c_float))
 		input_length = len(input_buffer)
 
-		# Prepare output parameters
-		output_buffer_ptr = POINTER(ctypes.c_int16)()
-		output_length = c_int()
+		voice = self._get_voice(voice)
+		if voice is None:
+			return None
 
-		# Call the DLL function
-		with _steam_audio_mutex:
-			success = self.dll.process_sound(
-				input_ptr,
-				input_length,
-				c_float(angle_x),
-				c_float(angle_y),
-				byref(output_buffer_ptr),
-				byref(output_length),
+		# Render straight into the voice's buffer and copy the result out while we still own it
+		with voice.lock:
+			output_samples = self.dll.get_output_length(voice.renderer, input_length, False)
+			if output_samples <= 0:
+				return b""
+			result = self._render_into(
+				voice,
+				output_samples,
+				lambda output_buffer, capacity, output_length: self.dll.process_sound_into(
+					voice.renderer,
+					input_ptr,
+					input_length,
+					c_float(angle_x),
+					c_float(angle_y),
+					output_buffer,
+					capacity,
+					output_length,
+				),
 			)
-
-		if not success or not output_buffer_ptr:
+		if result is None and not voice.cancelled:
 			log.error("Failed to process sound")
+		return result
+
+	def apply_reverb(self, input_buffer, voice="main"):
+		"""Apply reverb to stereo 16-bit audio
+
+		Args:
+		    input_buffer: bytes of stereo 16-bit audio samples
+		    voice: Name of the voice whose renderer and output buffer are used
+
+		Returns:
+		    bytes: Stereo 16-bit audio samples with reverb, or None if failed
+		"""
+		if not self.initialized:
+			log.error("Steam Audio not initialized")
 			return None
 
-		try:
-			# Convert output to bytes
-			output_samples = output_length.value
-			if output_samples > 0:
-				# Pack int16 samples into bytes
-				result = struct.pack(
-					f"<{output_samples}h",
-					*[output_buffer_ptr[i] for i in range(output_samples)],
-				)
+		# View the bytes as an int16 array (a single copy, no per-sample unpacking)
+		input_length = len(input_buffer) // 2
+		input_array = (ctypes.c_int16 * input_length).from_buffer_copy(input_buffer)
 
-				# Free the output buffer
-				with _steam_audio_mutex:
-					self.dll.free_output_sound(output_buffer_ptr)
+		voice = self._get_voice(voice)
+		if voice is None:
+			return None
 
-				return result
-			else:
+		with voice.lock:
+			output_samples = self.dll.get_output_length(voice.renderer, input_length // 2, True)
+			if output_samples <= 0:
 				return b""
+			result = self._render_into(
+				voice,
+				output_samples,
+				lambda output_buffer, capacity, output_length: self.dll.apply_reverb_into(
+					voice.renderer,
+					input_array,
+					input_length,
+					output_buffer,
+					capacity,
+					output_length,
+				),
+			)
+		if result is None and not voice.cancelled:
+			log.error("Failed to apply reverb")
+		return result
 
-		except Exception as e:
-			log.error(f"Error processing output buffer: {e}")
-			# Make sure to free the buffer even if there's an error
-			if output_buffer_ptr:
-				with _steam_audio_mutex:
-					self.dll.free_output_sound(output_buffer_ptr)
+	def render_sound(self, input_buffer, angle_x, angle_y, gain=1.0, use_reverb=False, voice="main"):
+		"""Spatialize, optionally reverberate and scale audio in a single native pass
+
+		Args:
+		    input_buffer: list of float32 mono audio samples
+		    angle_x: Horizontal angle in degrees (-90 to 90)
+		    angle_y: Vertical angle in degrees (-90 to 90)
+		    gain: Linear gain applied before the final 16-bit conversion
+		    use_reverb: Whether to run the output through the reverb
+		    voice: Name of the voice whose renderer and output buffer are used
+
+		Returns:
+		    bytes: Stereo 16-bit audio samples as bytes, or None if failed
+		"""
+		if not self.initialized:
+			log.error("Steam Audio not initialized")
 			return None
 
-	def apply_reverb(self, input_buffer):
-		"""Apply reverb to stereo 16-bit audio
+		input_array = (c_float * len(input_buffer))(*input_buffer)
+		input_length = len(input_buffer)
+
+		voice = self._get_voice(voice)
+		if voice is None:
+			return None
+
+		with voice.lock:
+			output_samples = self.dll.get_output_length(voice.renderer, input_length, use_reverb)
+			if output_samples <= 0:
+				return b""
+			result = self._render_into(
+				voice,
+				output_samples,
+				lambda output_buffer, capacity, output_length: self.dll.render_sound_into(
+					voice.renderer,
+					input_array,
+					input_length,
+					c_float(angle_x),
+					c_float(angle_y),
+					c_float(gain),
+					use_reverb,
+					output_buffer,
+					capacity,
+					output_length,
+				),
+			)
+		if result is None and not voice.cancelled:
+			log.error("Failed to render sound")
+		return result
+
+	def register_sound(self, path):
+		"""Decode a WAV file once into DLL-owned storage
 
 		Args:
-		    input_buffer: bytes of stereo 16-bit audio samples
+		    path: Path to the WAV file
 
 		Returns:
-		    bytes: Stereo 16-bit audio samples with reverb, or None if failed
+		    NativeSound, or None if the file could not be decoded
+		"""
+		handle = self.dll.register_sound(path)
+		if not handle:
+			log.error(f"Failed to register sound: {path}")
+			return None
+		return NativeSound(self.dll, handle)
+
+	def register_sound_pcm(self, samples, sample_rate):
+		"""Copy float32 mono samples into DLL-owned storage
+
+		Args:
+		    samples: list of float32 mono audio samples
+		    sample_rate: Sample rate of the samples in Hz
+
+		Returns:
+		    NativeSound, or None if registration failed
+		"""
+		input_array = (c_float * len(samples))(*samples)
+		handle = self.dll.register_sound_pcm(input_array, len(samples), sample_rate)
+		if not handle:
+			log.error("Failed to register sound samples")
+			return None
+		return NativeSound(self.dll, handle)
+
+	def write_theme_pack(self, path, sounds, info=None):
+		"""Write registered sounds to a theme pack that register_theme_pack can map
+
+		The pack is written beside path and renamed over it, so a partly written pack is never loaded.
+		Windows won't rename over a pack that is still mapped, so each new pack should get a new path.
+
+		Args:
+		    path: Pack file to write
+		    sounds: dict mapping each role to its NativeSound, all at the renderer's sample rate
+		    info: The theme's info.json text, kept in the pack with the sounds
+
+		Returns:
+		    bool: True if the pack was written
+		"""
+		roles = (c_int * len(sounds))(*sounds.keys())
+		handles = (c_int * len(sounds))(*(sound.handle for sound in sounds.values()))
+		temp_path = path + ".tmp"
+		encoded = info.encode("utf-8") if info is not None else None
+		written = self.dll.write_theme_pack(temp_path, roles, handles, len(sounds), encoded)
+		try:
+			if written:
+				os.replace(temp_path, path)
+				return True
+			log.error(f"Failed to write theme pack: {path}")
+		except OSError as e:
+			# Sounds that are still playing can keep a pack at path mapped
+			log.warning(f"Could not replace theme pack {path}: {e}")
+		try:
+			os.remove(temp_path)
+		except OSError:
+			pass
+		return False
+
+	def register_theme_pack(self, path, capacity=1024):
+		"""Register every sound in a theme pack, viewing their samples in the mapped file
+
+		Args:
+		    path: Pack file written by write_theme_pack
+		    capacity: Most sounds the pack may hold
+
+		Returns:
+		    dict mapping each role to its NativeSound, or None if the pack is missing, damaged or was
+		    written at another sample rate
+		"""
+		roles = (c_int * capacity)()
+		handles = (c_int * capacity)()
+		count = self.dll.register_theme_pack(path, roles, handles, capacity)
+		if count < 0:
+			return None
+		return {roles[i]: NativeSound(self.dll, handles[i]) for i in range(count)}
+
+	def process_sound_handle(self, sound, angle_x, angle_y, gain=1.0, use_reverb=False, voice="main"):
+		"""Render a registered sound without marshalling its samples
+
+		Args:
+		    sound: NativeSound returned by register_sound()
+		    angle_x: Horizontal angle in degrees (-90 to 90)
+		    angle_y: Vertical angle in degrees (-90 to 90)
+		    gain: Linear gain applied before the final 16-bit conversion
+		    use_reverb: Whether to run the output through the reverb
+		    voice: Name of the voice whose renderer and output buffer are used
+
+		Returns:
+		    bytes: Stereo 16-bit audio samples as bytes, or None if failed
 		"""
 		if not self.initialized:
 			log.error("Steam Audio not initialized")
 			return None
 
-		# Convert bytes to int16 array
-		import struct
+		voice = self._get_voice(voice)
+		if voice is None:
+			return None
 
-		samples = struct.unpack(f"<{len(input_buffer) // 2}h", input_buffer)
-		input_array = (ctypes.c_int16 * len(samples))(*samples)
-		input_ptr = ctypes.cast(input_array, POINTER(ctypes.c_int16))
-		input_length = len(samples)
+		with voice.lock:
+			output_samples = self.dll.get_sound_output_length(voice.renderer, sound.handle, use_reverb)
+			if output_samples <= 0:
+				return b""
+			result = self._render_into(
+				voice,
+				output_samples,
+				lambda output_buffer, capacity, output_length: self.dll.process_sound_handle(
+					voice.renderer,
+					sound.handle,
+					c_float(angle_x),
+					c_float(angle_y),
+					c_float(gain),
+					use_reverb,
+					output_buffer,
+					capacity,
+					output_length,
+				),
+			)
+		if result is None and not voice.cancelled:
+			log.error("Failed to render sound")
+		return result
 
-		# Prepare output parameters
-		output_buffer_ptr = POINTER(ctypes.c_int16)()
-		output_length = c_int()
+	def process_sound_path(self, sound, keyframes, gain=1.0, use_reverb=False, voice="main"):
+		"""Render a registered sound moving along a path, its direction interpolated every frame
 
-		# Call the DLL function
-		with _steam_audio_mutex:
-			success = self.dll.apply_reverb(
-				input_ptr, input_length, byref(output_buffer_ptr), byref(output_length)
-			)
+		Args:
+		    sound: NativeSound returned by register_sound()
+		    keyframes: Up to MAX_DIRECTION_KEYFRAMES (time, angle_x, angle_y) tuples in time order,
+		        time in seconds from the start of the sound and angles in degrees (-90 to 90)
+		    gain: Linear gain applied before the final 16-bit conversion
+		    use_reverb: Whether to run the output through the reverb
+		    voice: Name of the voice whose renderer and output buffer are used
 
-		if not success or not output_buffer_ptr:
-			log.error("Failed to apply reverb")
+		Returns:
+		    bytes: Stereo 16-bit audio samples as bytes, or None if failed
+		"""
+		if not self.initialized:
+			log.error("Steam Audio not initialized")
 			return None
 
-		try:
-			# Convert output to bytes
-			output_samples = output_length.value
-			if output_samples > 0:
-				# Pack int16 samples into bytes
-				result = struct.pack(
-					f"<{output_samples}h",
-					*[output_buffer_ptr[i] for i in range(output_samples)],
-				)
+		keys = _make_keyframes(keyframes)
+		if keys is None:
+			log.error("A path needs 1 to %d keyframes", MAX_DIRECTION_KEYFRAMES)
+			return None
 
-				# Free the output buffer
-				with _steam_audio_mutex:
-					self.dll.free_output_sound(output_buffer_ptr)
+		voice = self._get_voice(voice)
+		if voice is None:
+			return None
 
-				return result
-			else:
+		with voice.lock:
+			output_samples = self.dll.get_sound_output_length(voice.renderer, sound.handle, use_reverb)
+			if output_samples <= 0:
 				return b""
+			result = self._render_into(
+				voice,
+				output_samples,
+				lambda output_buffer, capacity, output_length: self.dll.process_sound_path(
+					voice.renderer,
+					sound.handle,
+					keys,
+					len(keys),
+					c_float(gain),
+					use_reverb,
+					output_buffer,
+					capacity,
+					output_length,
+				),
+			)
+		if result is None and not voice.cancelled:
+			log.error("Failed to render sound")
+		return result
 
-		except Exception as e:
-			log.error(f"Error processing reverb output buffer: {e}")
-			# Make sure to free the buffer even if there's an error
-			if output_buffer_ptr:
-				with _steam_audio_mutex:
-					self.dll.free_output_sound(output_buffer_ptr)
+	# Lay the batch out end to end instead of mixing it
+	BATCH_CONCATENATE = 1
+
+	def process_batch(self, items, concatenate=False, voice="main"):
+		"""Render several registered sounds in one call, spread over the native worker pool
+
+		Args:
+		    items: Sequence of (sound, angle_x, angle_y, gain, use_reverb, start_offset) tuples,
+		        where start_offset is in frames and only used when mixing
+		    concatenate: Lay the sounds out one after another instead of mixing them
+		    voice: Name of the voice whose renderer and output buffer are used
+
+		Returns:
+		    bytes: Stereo 16-bit audio samples as bytes, or None if failed
+		"""
+		if not self.initialized:
+			log.error("Steam Audio not initialized")
 			return None
+		if not items:
+			return b""
+
+		batch = (BatchSound * len(items))()
+		for entry, (sound, angle_x, angle_y, gain, use_reverb, start_offset) in zip(batch, items):
+			entry.sound = sound.handle
+			entry.angleX = angle_x
+			entry.angleY = angle_y
+			entry.gain = gain
+			entry.reverb = 1 if use_reverb else 0
+			entry.startOffset = int(start_offset)
+		flags = self.BATCH_CONCATENATE if concatenate else 0
+
+		voice = self._get_voice(voice)
+		if voice is None:
+			return None
+
+		with voice.lock:
+			output_samples = self.dll.get_batch_output_length(voice.renderer, batch, len(batch), flags)
+			if output_samples <= 0:
+				return b""
+			result = self._render_into(
+				voice,
+				output_samples,
+				lambda output_buffer, capacity, output_length: self.dll.process_batch(
+					voice.renderer, batch, len(batch), flags, output_buffer, capacity, output_length
+				),
+			)
+		if result is None and not voice.cancelled:
+			log.error("Failed to render batch")
+		return result
+
+	def bake_sounds(self, items):
+		"""Render sounds into the output cache on low-priority native threads, ahead of playback
+
+		Replaces any bake still in progress and returns straight away. Baking stops once the
+		cache budget is full, so it never evicts renders of recently played sounds.
+
+		Args:
+		    items: Sequence of (sound, angle_x, angle_y, gain, use_reverb) tuples, matching
+		        the arguments the sounds will later be played with
+
+		Returns:
+		    bool: True if the bake was queued
+		"""
+		if not self.initialized:
+			log.error("Steam Audio not initialized")
+			return False
+
+		batch = (BatchSound * len(items))()
+		for entry, (sound, angle_x, angle_y, gain, use_reverb) in zip(batch, items):
+			entry.sound = sound.handle
+			entry.angleX = angle_x
+			entry.angleY = angle_y
+			entry.gain = gain
+			entry.reverb = 1 if use_reverb else 0
+		return self.dll.bake_sounds(batch, len(batch))
+
+	def cancel_bake(self):
+		"""Drop every render still waiting to be baked"""
+		self.dll.cancel_bake()
+
+	def get_bake_progress(self):
+		"""Return (done, total) for the current bake"""
+		done = c_int()
+		total = c_int()
+		self.dll.get_bake_progress(byref(done), byref(total))
+		return done.value, total.value
+
+	def set_sound_memory_budget(self, max_bytes):
+		"""Limit how much of the theme packs' samples stays mapped; 0 for no limit
+
+		Past the budget the least recently played pack sounds are unmapped, to be mapped again when
+		next played.
+		"""
+		self.dll.set_sound_memory_budget(int(max_bytes))
+
+	def load_sound(self, sound):
+		"""Map a pack sound and read it in now, so its first play doesn't wait on the disk"""
+		return sound is not None and bool(sound.handle) and bool(self.dll.load_sound(sound.handle))
+
+	def set_output_cache_settings(self, max_bytes, angle_step=1.0):
+		"""Configure the cache of finished renders used by process_sound_handle
+
+		Args:
+		    max_bytes: Memory budget for cached renders (0 disables the cache)
+		    angle_step: Size of the direction buckets renders are snapped to
+		"""
+		self.dll.set_output_cache_settings(int(max_bytes), c_float(angle_step))
+
+	def get_output_cache_stats(self):
+		"""Return a dict with the render cache hits, misses, entries and bytes"""
+		hits = ctypes.c_longlong()
+		misses = ctypes.c_longlong()
+		entries = c_int()
+		cached_bytes = ctypes.c_longlong()
+		self.dll.get_output_cache_stats(
+			byref(hits), byref(misses), byref(entries), byref(cached_bytes)
+		)
+		return {
+			"hits": hits.value,
+			"misses": misses.value,
+			"entries": entries.value,
+			"bytes": cached_bytes.value,
+		}
+
+	def get_audio_stats(self):
+		"""Return the DLL's counters and per-stage timings since load or the last reset
+
+		Returns:
+		    dict: Counter values, plus a "stages" dict mapping each name in STAT_STAGES to its
+		    count, total_us, max_us and histogram (list of STAT_BUCKETS counts)
+		"""
+		stats = AudioStats()
+		self.dll.get_audio_stats(byref(stats))
+		stages = {}
+		for name, stage in zip(STAT_STAGES, stats.stages):
+			stages[name] = {
+				"count": stage.count,
+				"total_us": stage.totalNs / 1000.0,
+				"max_us": stage.maxNs / 1000.0,
+				"histogram": list(stage.buckets),
+			}
+		return {
+			"stages": stages,
+			"frames_rendered": stats.framesRendered,
+			"tail_frames_skipped": stats.tailFramesSkipped,
+			"cache_hits": stats.cacheHits,
+			"cache_misses": stats.cacheMisses,
+			"mixer_underruns": stats.mixerUnderruns,
+			"failures": stats.failures,
+			"renders_cancelled": stats.rendersCancelled,
+			"sounds_mapped": stats.soundsMapped,
+			"sounds_unmapped": stats.soundsUnmapped,
+			"sound_bytes_mapped": stats.soundBytesMapped,
+			"plays_coalesced": stats.playsCoalesced,
+			"plays_rejected": stats.playsRejected,
+			"voices_stolen": stats.voicesStolen,
+			"deadline_misses": stats.deadlineMisses,
+			"priority_inversions": stats.priorityInversions,
+			"realtime_threads": stats.realtimeThreads,
+			"device_outputs": stats.deviceOutputs,
+		}
+
+	def reset_audio_stats(self):
+		"""Zero the DLL's counters and timings, render cache hits and misses included"""
+		self.dll.reset_audio_stats()
+
+	def get_simd_name(self):
+		"""Name of the instruction set the DLL picked for its DSP kernels, from SIMD_LEVELS"""
+		level = self.dll.get_simd_level()
+		return SIMD_LEVELS[level] if 0 <= level < len(SIMD_LEVELS) else str(level)
+
+	def clear_output_cache(self):
+		"""Drop every cached render and reset the cache counters"""
+		self.dll.clear_output_cache()
+
+	def set_hrtf_interpolation(self, bilinear):
+		"""Use bilinear HRTF interpolation instead of the nearest measured direction"""
+		self.dll.set_hrtf_interpolation(bool(bilinear))
+
+	def set_output_dither(self, enabled):
+		"""Enable or disable TPDF dither on the final 16-bit conversion"""
+		self.dll.set_output_dither(bool(enabled))
+
+	def create_mixer(self, max_voices=8, ambisonic_order=0):
+		"""Start a native mixer with its own render thread
+
+		Args:
+		    max_voices: Number of sounds that can play at once before one of lower priority, or the
+		        oldest, is cut off
+		    ambisonic_order: 1 to 3 to encode sounds into one ambisonic bus and decode it once per
+		        frame, so overlapping sounds cost little more than one; 0 spatializes each sound itself
+
+		Returns:
+		    Mixer, or None if the mixer could not be started
+		"""
+		if not self.initialized:
+			log.error("Steam Audio not initialized")
+			return None
+		handle = self.dll.create_mixer(max_voices, ambisonic_order)
+		if not handle:
+			log.error("Failed to create mixer")
+			return None
+		return Mixer(self.dll, handle, self.frame_size)
+
+	def create_output(self, mixer, device_name, period_ms=3):
+		"""Play a mixer straight to an output device from a native WASAPI thread
+
+		Args:
+		    mixer: Mixer to play; it must not be read from while the output runs
+		    device_name: NVDA's outputDevice setting
+		    period_ms: Device period to ask for, or 0 for the shortest the audio engine offers
+
+		Returns:
+		    DeviceOutput, or None if there is no native output and the mixer has to be read instead
+		"""
+		if not self.initialized or mixer is None or not mixer._handle:
+			return None
+
+		handle = self.dll.create_output(mixer._handle, device_name, period_ms)
+		if not handle:
+			return None
+		return DeviceOutput(self.dll, handle)
 
 	def __del__(self):
 		"""Cleanup when object is destroyed"""
@@ -315,6 +1234,174 @@ class SteamAudio:
 			self.cleanup()
 
 
+class Mixer:
+	"""Native mixer that renders and mixes sounds on its own thread.
+
+	Mixed stereo 16-bit audio is pulled with read(); play() and interrupt() never block on rendering.
+	"""
+
+	# Stop everything that is playing or queued first
+	PLAY_INTERRUPT = 1
+	# Start once every previously started or queued sound has finished
+	PLAY_QUEUED = 2
+
+	def __init__(self, dll, handle, frame_size):
+		self._dll = dll
+		self._handle = handle
+		self.frame_size = frame_size
+		self._read_buffer = (ctypes.c_int16 * (2 * frame_size))()
+		self._interrupted = c_bool()
+
+	def play(self, sound, angle_x, angle_y, gain=1.0, reverb_send=0.0, flags=0, group=-1, priority=0):
+		"""Start a registered sound
+
+		Args:
+		    sound: NativeSound returned by register_sound()
+		    angle_x: Horizontal angle in degrees (-90 to 90)
+		    angle_y: Vertical angle in degrees (-90 to 90)
+		    gain: Linear gain applied to the sound
+		    reverb_send: Share of the sound sent to the mixer's shared reverb, 0.0 (dry) to 1.0
+		    flags: PLAY_INTERRUPT, PLAY_QUEUED or 0 to play on top of current sounds
+		    group: Sounds sharing a group share set_limits' voice limit; -1 for none
+		    priority: When every voice is busy, the sound only takes the place of one with a lower
+		        priority, or of the oldest with the same priority
+
+		Returns:
+		    bool: True if the sound was accepted
+		"""
+		if not self._handle or sound is None:
+			return False
+		return self._dll.mixer_play(
+			self._handle,
+			sound.handle,
+			c_float(angle_x),
+			c_float(angle_y),
+			c_float(gain),
+			c_float(reverb_send),
+			flags,
+			group,
+			priority,
+		)
+
+	def play_path(self, sound, keyframes, gain=1.0, reverb_send=0.0, flags=0, group=-1, priority=0):
+		"""Start a registered sound moving along a path, its direction interpolated every frame
+
+		Args:
+		    sound: NativeSound returned by register_sound()
+		    keyframes: Up to MAX_DIRECTION_KEYFRAMES (time, angle_x, angle_y) tuples in time order,
+		        time in seconds from the start of the sound and angles in degrees (-90 to 90)
+		    gain, reverb_send, flags, group, priority: As for play()
+
+		Returns:
+		    bool: True if the sound was accepted
+		"""
+		keys = _make_keyframes(keyframes)
+		if not self._handle or sound is None or keys is None:
+			return False
+		return self._dll.mixer_play_path(
+			self._handle,
+			sound.handle,
+			keys,
+			len(keys),
+			c_float(gain),
+			c_float(reverb_send),
+			flags,
+			group,
+			priority,
+		)
+
+	def interrupt(self):
+		"""Stop every playing and queued sound, fading out what is playing"""
+		if self._handle:
+			self._dll.mixer_interrupt(self._handle)
+
+	def set_lead(self, lead_ms):
+		"""Set how far ahead of real time the mixer renders, by default 40 ms
+
+		A sound played on top of others is heard after at most this much already mixed audio. 0 mixes
+		as far ahead as the mixer buffers, for output that isn't played in real time.
+		"""
+		if self._handle:
+			self._dll.set_mixer_lead(self._handle, int(lead_ms))
+
+	def set_fades(self, fade_in_ms, fade_out_ms):
+		"""Set how long sounds take to fade in when started and to fade out when interrupted
+
+		By default sounds start at full level and fade out over 5 ms. A fade out of 0 cuts interrupted
+		sounds off, and read() then reports the interrupt so the output can drop what it has buffered.
+		"""
+		if self._handle:
+			self._dll.set_mixer_fades(self._handle, int(fade_in_ms), int(fade_out_ms))
+
+	def set_limits(self, group_voices, max_queued, coalesce_ms):
+		"""Bound the work a burst of plays can queue up
+
+		Args:
+		    group_voices: Sounds of one group that may play at once before the oldest fades out, by default 2
+		    max_queued: Queued sounds that may wait before the oldest is dropped, by default 8
+		    coalesce_ms: A sound played again this soon after starting carries on rather than starting
+		        twice, by default 50
+
+		0 turns a limit off, though the mixer never keeps more than 64 sounds waiting.
+		"""
+		if self._handle:
+			self._dll.set_mixer_limits(self._handle, int(group_voices), int(max_queued), int(coalesce_ms))
+
+	def set_scheduling(self, pro_audio, cpu=-1):
+		"""Choose whether the render thread runs as an MMCSS Pro Audio task, as it does by default,
+		and the CPU it is kept to, or -1 for any"""
+		if self._handle:
+			self._dll.set_mixer_scheduling(self._handle, bool(pro_audio), int(cpu))
+
+	def read(self, timeout_ms=100):
+		"""Wait up to timeout_ms for one frame of mixed audio
+
+		Only one thread may read from a mixer.
+
+		Returns:
+		    tuple: (bytes of stereo 16-bit samples, possibly empty; whether earlier audio was interrupted)
+		"""
+		if not self._handle:
+			return b"", False
+		frames = self._dll.mixer_read(
+			self._handle,
+			self._read_buffer,
+			self.frame_size,
+			timeout_ms,
+			byref(self._interrupted),
+		)
+		return ctypes.string_at(self._read_buffer, frames * 4), self._interrupted.value
+
+	def destroy(self):
+		"""Stop the render thread and free the mixer. No reads may be in progress."""
+		if self._handle:
+			self._dll.destroy_mixer(self._handle)
+			self._handle = None
+
+
+class DeviceOutput:
+	"""Native WASAPI stream playing a mixer. Destroy it before the mixer."""
+
+	def __init__(self, dll, handle):
+		self._dll = dll
+		self._handle = handle
+
+	def get_format(self):
+		"""Return (sample_rate, channels, period_frames) of the stream"""
+		sample_rate = c_int()
+		channels = c_int()
+		period_frames = c_int()
+		if self._handle:
+			self._dll.get_output_format(self._handle, byref(sample_rate), byref(channels), byref(period_frames))
+		return sample_rate.value, channels.value, period_frames.value
+
+	def destroy(self):
+		"""Stop the stream and its thread"""
+		if self._handle:
+			self._dll.destroy_output(self._handle)
+			self._handle = None
+
+
 # Global instance for easy access
 _steam_audio_instance = None
 
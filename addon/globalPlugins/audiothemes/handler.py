@@ -9,6 +9,7 @@ from dataclasses import dataclass, field, asdict
 from zipfile import ZipFile, ZIP_DEFLATED
 from uuid import uuid4
 import os
+import re
 import ctypes
 import shutil
 import copy
@@ -26,6 +27,11 @@ addonHandler.initTranslation()
 
 THEMES_HOME = os.path.join(globalVars.appArgs.configPath, "audio-themes")
 INFO_FILE_NAME = "info.json"
+# The theme's sounds decoded at the renderer rate, rebuilt from the sound files whenever they change.
+# Each rebuild gets a new name (sounds.1.pack, sounds.2.pack, ...), as Windows won't replace a pack that
+# sounds still playing keep mapped. The highest numbered pack is the current one, and an unnumbered
+# sounds.pack from before packs were numbered counts as 0.
+PACK_FILE_PATTERN = re.compile(r"^sounds(?:\.(\d+))?\.pack$")
 SUPPORTED_FILE_TYPES = OrderedDict()
 # Translators: The file type to be shown in a dialog used to browse for audio files.
 SUPPORTED_FILE_TYPES["wav"] = _("Wave audio files")
@@ -47,6 +53,41 @@ audiothemes_config_defaults = {
     "WetLevel": "integer(default=9, min=0, max=100)",
     "DryLevel": "integer(default=30, min=0, max=100)",
     "Width": "integer(default=100, min=0, max=100)",
+    "output_cache_size": "integer(default=8, min=0, max=256)",
+    "dither": "boolean(default=False)",
+    # Milliseconds over which sounds fade in, and interrupted sounds fade out. 0 cuts them off, which
+    # also drops audio already buffered in the output device.
+    "fade_in_ms": "integer(default=0, min=0, max=50)",
+    "interrupt_fade_ms": "integer(default=5, min=0, max=50)",
+    # Bound the work bursts of events queue up: sounds of one role playing at once, queued sounds
+    # waiting, and milliseconds in which a repeat of a sound is dropped. 0 for no limit.
+    "role_voices": "integer(default=2, min=0, max=32)",
+    "max_queued": "integer(default=8, min=0, max=64)",
+    "coalesce_ms": "integer(default=50, min=0, max=500)",
+    # Run the mixer as a Pro Audio task so it keeps up while NVDA is busy, optionally on one CPU (-1 for any)
+    "realtime_mixer": "boolean(default=True)",
+    "mixer_cpu": "integer(default=-1, min=-1, max=63)",
+    # Pre-render the theme at a grid of screen zones; positions snap to the zone centres
+    "bake_theme": "boolean(default=False)",
+    "bake_columns": "integer(default=5, min=1, max=16)",
+    "bake_rows": "integer(default=3, min=1, max=16)",
+    # Match the output device's mix rate so Windows doesn't resample again; applies after a restart
+    "sample_rate": "integer(default=48000, min=8000, max=192000)",
+    # Samples per processing frame; 128 or 256 for low latency. Applies after a restart.
+    "frame_size": "integer(default=1024, min=64, max=4096)",
+    # 1 to 3 mixes overlapping sounds through one ambisonic bus, so they cost about as much as one;
+    # 0 spatializes each sound separately, which is sharper. Applies after a restart.
+    "ambisonic_order": "integer(default=0, min=0, max=3)",
+    # Sounds that can play at once; past it, newer sounds take the place of older ones. Applies after a restart.
+    "max_voices": "integer(default=8, min=1, max=32)",
+    # Play straight to the output device through WASAPI, at about this period in milliseconds (0 for the
+    # shortest the device allows), or through nvwave if it can't be opened. Applies after a restart.
+    "native_output": "boolean(default=True)",
+    "output_period_ms": "integer(default=3, min=0, max=100)",
+    # Megabytes of the theme's sounds kept in memory; the least recently played go first. 0 for no limit.
+    "sound_memory_budget": "integer(default=0, min=0, max=1024)",
+    # Bring the most used roles' sounds into memory in the background once a theme is activated
+    "prewarm_sounds": "boolean(default=True)",
 }
 
 
@@ -60,6 +101,23 @@ class SpecialProps(IntEnum):
     loaded = 2504
 
 
+# The roles navigation lands on most, most used first
+PREWARM_ROLES = (
+    controlTypes.Role.LINK,
+    controlTypes.Role.BUTTON,
+    controlTypes.Role.LISTITEM,
+    controlTypes.Role.MENUITEM,
+    controlTypes.Role.EDITABLETEXT,
+    controlTypes.Role.CHECKBOX,
+    controlTypes.Role.TREEVIEWITEM,
+    controlTypes.Role.TAB,
+    controlTypes.Role.COMBOBOX,
+    controlTypes.Role.RADIOBUTTON,
+    controlTypes.Role.HEADING,
+    SpecialProps.first,
+    SpecialProps.last,
+)
+
 theme_roles = copy.copy(controlTypes.roleLabels)
 theme_roles.update(
     {
@@ -91,6 +149,25 @@ class AudioTheme:
     def info_file_path(self):
         return os.path.join(self.directory, INFO_FILE_NAME)
 
+    @property
+    def pack_file_path(self):
+        """The current pack, or None if the theme has none."""
+        packs = self.pack_files()
+        return packs[-1][1] if packs else None
+
+    def pack_files(self):
+        """Every pack in the theme directory as (number, path), oldest first."""
+        packs = []
+        try:
+            with os.scandir(self.directory) as entries:
+                for entry in entries:
+                    match = PACK_FILE_PATTERN.match(entry.name)
+                    if match:
+                        packs.append((int(match.group(1) or 0), entry.path))
+        except OSError:
+            pass
+        return sorted(packs)
+
     @property
     def folder(self):
         return os.path.split(self.directory)[-1]
@@ -112,11 +189,63 @@ class AudioTheme:
             self.unload()
         if not os.path.isdir(self.directory):
             return
-        for filename in os.listdir(self.directory):
-            path = os.path.join(self.directory, filename)
-            rep_role = self.is_valid_audio_file(path)
-            if rep_role is not None:
-                self.sounds[rep_role] = player.make_sound_object(path)
+        files = self.audio_files()
+        sounds = self.load_pack(player, files)
+        if sounds is not None:
+            self.sounds = sounds
+            return
+        for rep_role, (path, _mtime) in files.items():
+            self.sounds[rep_role] = player.make_sound_object(path)
+        if self.save_pack(player):
+            # Swap the decoded sounds for the pack's, which are only in memory while they are in use
+            sounds = self.load_pack(player, files)
+            if sounds is not None:
+                self.sounds = sounds
+
+    def audio_files(self):
+        """Map every role with a sound file in the theme directory to (path, modification time)."""
+        files = {}
+        with os.scandir(self.directory) as entries:
+            for entry in entries:
+                rep_role = self.is_valid_audio_file(entry.path)
+                if rep_role is not None:
+                    files[rep_role] = (entry.path, entry.stat().st_mtime)
+        return files
+
+    def load_pack(self, player, files):
+        """Map the sounds of the theme's pack, or return None if the sound files changed since it was written."""
+        pack_path = self.pack_file_path
+        try:
+            pack_mtime = os.stat(pack_path).st_mtime if pack_path else None
+        except OSError:
+            pack_mtime = None
+        if pack_mtime is None:
+            return None
+        if not files or any(mtime > pack_mtime for _path, mtime in files.values()):
+            return None
+        sounds = player.load_theme_pack(pack_path)
+        # A sound file can have been added or removed without touching the others
+        if sounds is None or sounds.keys() != files.keys():
+            return None
+        return sounds
+
+    def save_pack(self, player):
+        """Write the loaded sounds to the theme's pack, so the next load maps them instead of decoding."""
+        # A sound that failed to decode is retried on the next load rather than left out of the pack
+        if not self.sounds or None in self.sounds.values():
+            return False
+        packs = self.pack_files()
+        number = packs[-1][0] + 1 if packs else 1
+        path = os.path.join(self.directory, f"sounds.{number}.pack")
+        if not player.save_theme_pack(path, self.sounds, json.dumps(self.todict())):
+            return False
+        # Older packs still mapped by playing sounds can't be deleted yet; the next save tries again
+        for _number, old_path in packs:
+            try:
+                os.remove(old_path)
+            except OSError:
+                pass
+        return True
 
     def unload(self):
         self.sounds.clear()
@@ -146,7 +275,15 @@ class AudioThemesHandler:
     def __init__(self):
         config.conf.spec["audiothemes"] = audiothemes_config_defaults
         self.enabled = True
-        self.player = SteamAudioPlayer()
+        user_config = config.conf["audiothemes"]
+        self.player = SteamAudioPlayer(
+            sample_rate=user_config["sample_rate"],
+            frame_size=user_config["frame_size"],
+            ambisonic_order=user_config["ambisonic_order"],
+            max_voices=user_config["max_voices"],
+            native_output=user_config["native_output"],
+            output_period_ms=user_config["output_period_ms"],
+        )
         self.active_theme = None
         self.configure()
         for action in (
@@ -181,6 +318,10 @@ class AudioThemesHandler:
         if self.active_theme is not None:
             self.active_theme.deactivate()
         self.enabled = user_config["enable_audio_themes"]
+        if not self.player.available:
+            # The engine failed to load and logged why
+            self.active_theme = None
+            return
         self.active_theme = self.get_active_theme()
         if self.active_theme is None:
             return
@@ -190,6 +331,23 @@ class AudioThemesHandler:
         self.player.use_synth_volume = user_config["use_synth_volume"]
         self.player.volume = user_config["volume"]
         self.player.use_reverb = user_config.get("use_reverb", True)
+        self.player.configure_output_cache(user_config["output_cache_size"])
+        self.player.configure_sound_memory(user_config["sound_memory_budget"])
+        self.player.set_dither(user_config["dither"])
+        self.player.set_fades(user_config["fade_in_ms"], user_config["interrupt_fade_ms"])
+        self.player.set_limits(
+            user_config["role_voices"], user_config["max_queued"], user_config["coalesce_ms"]
+        )
+        self.player.set_scheduling(user_config["realtime_mixer"], user_config["mixer_cpu"])
+        self.player.configure_reverb()
+        self.player.configure_bake(
+            user_config["bake_theme"], user_config["bake_columns"], user_config["bake_rows"]
+        )
+        self.player.bake(self.active_theme.sounds.values())
+        if user_config["prewarm_sounds"]:
+            sounds = self.active_theme.sounds
+            # Most used last, so they are the last to go if the budget can't hold them all
+            self.player.prewarm(sounds.get(role) for role in reversed(PREWARM_ROLES))
 
     def play(self, obj, sound):
         if not self.enabled or (self.active_theme is None):
@@ -269,5 +427,6 @@ class AudioThemesHandler:
         with ZipFile(output_filename, "w", ZIP_DEFLATED) as zip:
             for filename in os.listdir(source_dir):
                 file = os.path.join(source_dir, filename)
-                if os.path.isfile(file):
+                # The pack is rebuilt from the sound files wherever the theme is installed
+                if os.path.isfile(file) and not PACK_FILE_PATTERN.match(filename):
                     zip.write(file, filename)
@@ -311,6 +311,10 @@ class ThemeBlenderDialog(BaseDialog):
     def save_theme_package(self, dst_dir):
         theme = self.theme_state.theme
         AudioThemesHandler.write_info_file(theme.info_file_path, theme.todict())
+        if self.editing:
+            # Decode the installed theme's sounds into its pack now rather than on its next activation
+            theme.load(self.player)
+            theme.unload()
         AudioThemesHandler.make_zip_file(dst_dir, theme.directory)
 
 
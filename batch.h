@@ -0,0 +1,515 @@
+// Batches rendered across the BatchPool's threads, and the BakePool that fills the output cache in
+// the background.
+
+#pragma once
+
+#include "render.h"
+
+// One sound in a process_batch call. Plain ints and floats only, so ctypes can mirror the layout.
+struct BatchSound {
+	int sound;        // Handle from register_sound
+	float angleX;
+	float angleY;
+	float gain;
+	int reverb;       // Nonzero to run the sound through the reverb
+	int startOffset;  // Sample frames from the start of the output, or from the end of the previous sound when concatenating
+};
+
+enum BatchFlags {
+	BATCH_CONCATENATE = 1, // Play the sounds one after another instead of mixing them
+};
+
+// Render a registered sound from a clean effect and reverb into shared PCM
+static CachedPcm render_uncached(RenderState& state, const Sound& sound, float angle_x, float angle_y, float gain, bool use_reverb)
+{
+	auto input_length = static_cast<int>(sound.samples.size());
+
+	iplBinauralEffectReset(state.effect);
+	if (use_reverb) {
+		sync_reverb_settings(state);
+		verblib_mute(state.reverb.get());
+	}
+
+	std::shared_ptr<std::vector<int16_t>> pcm;
+	try {
+		StageTimer timer(STAT_ALLOCATION);
+		pcm = std::make_shared<std::vector<int16_t>>(output_length(state, input_length, use_reverb));
+	} catch (const std::bad_alloc&) {
+		stat_add(g_stats.failures);
+		return nullptr;
+	}
+
+	int length = 0;
+	if (!render_sound(state, sound.samples.data(), input_length, angle_x, angle_y, gain, use_reverb, pcm->data(), static_cast<int>(pcm->size()), &length)) {
+		return nullptr;
+	}
+	pcm->resize(length);
+	return pcm;
+}
+
+// render_uncached through the output cache
+static CachedPcm render_pcm(RenderState& state, int handle, const Sound& sound, float angle_x, float angle_y, float gain, bool use_reverb)
+{
+	use_reverb = use_reverb && state.reverbInitialized;
+	if (sound.samples.empty()) {
+		return std::make_shared<const std::vector<int16_t>>();
+	}
+
+	if (!g_outputCache.enabled()) {
+		return render_uncached(state, sound, angle_x, angle_y, gain, use_reverb);
+	}
+
+	CacheKey key = make_cache_key(state.audioSettings, handle, angle_x, angle_y, gain, use_reverb);
+	if (auto cached = g_outputCache.find(key)) {
+		return cached;
+	}
+	auto pcm = render_uncached(state, sound, angle_x, angle_y, gain, use_reverb);
+	if (pcm) {
+		g_outputCache.insert(key, pcm);
+	}
+	return pcm;
+}
+
+// Worker threads for process_batch, each with its own render state. The calling thread always
+// takes part, so a batch still completes if every worker is busy or the pool has no workers.
+class BatchPool {
+public:
+	// Call render(state, index) once for every index below count, spread over the caller and the workers.
+	// state is caller for work done on the calling thread.
+	void run(RenderState& caller, int count, const std::function<void(RenderState&, int)>& render)
+	{
+		std::unique_lock<std::mutex> batchLock(m_batchMutex, std::try_to_lock);
+		if (!batchLock.owns_lock() || count < 2) {
+			// Another batch owns the workers (or there is nothing to share), so do it all here
+			for (int i = 0; i < count; ++i) {
+				render(caller, i);
+			}
+			return;
+		}
+
+		start();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_task = &render;
+			m_caller = &caller;
+			m_count = count;
+			m_next = 0;
+			m_busy = static_cast<int>(m_workers.size());
+			m_batch++;
+		}
+		m_wake.notify_all();
+
+		claim(caller);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return m_busy == 0; });
+		m_task = nullptr;
+		m_caller = nullptr;
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_wake.notify_all();
+		for (auto& worker : m_workers) {
+			worker->thread.join();
+			destroy_render_state(worker->render);
+		}
+		m_workers.clear();
+		m_quit = false;
+	}
+
+private:
+	struct Worker {
+		std::thread thread;
+		RenderState render;
+	};
+
+	void start()
+	{
+		if (!m_workers.empty()) {
+			return;
+		}
+
+		// The caller renders too, and the mixers and other renderers need cores of their own
+		unsigned cores = std::thread::hardware_concurrency();
+		unsigned count = std::min(cores > 1 ? cores - 1 : 0u, 3u);
+
+		// Workers started after a cleanup must not mistake the last batch before it for a new one
+		unsigned long long seen;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			seen = m_batch;
+		}
+		for (unsigned i = 0; i < count; ++i) {
+			std::unique_ptr<Worker> worker(new Worker);
+			Worker* raw = worker.get();
+			worker->thread = std::thread([this, raw, seen] { worker_loop(*raw, seen); });
+			m_workers.push_back(std::move(worker));
+		}
+	}
+
+	void claim(RenderState& state)
+	{
+		int index;
+		while ((index = m_next++) < m_count) {
+			(*m_task)(state, index);
+		}
+	}
+
+	void worker_loop(Worker& worker, unsigned long long seen)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;) {
+			m_wake.wait(lock, [&] { return m_quit || m_batch != seen; });
+			if (m_quit) {
+				return;
+			}
+			seen = m_batch;
+			RenderState& caller = *m_caller;
+			lock.unlock();
+
+			// Follow the caller's renderer, recreating the state when its settings or HRTF differ
+			bool ready = worker.render.effect && worker.render.hrtf == caller.hrtf && worker.render.audioSettings.samplingRate == caller.audioSettings.samplingRate && worker.render.audioSettings.frameSize == caller.audioSettings.frameSize;
+			if (!ready) {
+				destroy_render_state(worker.render);
+				ready = create_render_state(worker.render, caller.context, caller.hrtf, caller.audioSettings);
+			}
+			if (ready) {
+				// Cancelling the caller's render cancels the whole batch
+				worker.render.cancelToken = caller.cancelToken;
+				worker.render.cancelSeen = caller.cancelSeen;
+				claim(worker.render);
+			}
+
+			lock.lock();
+			if (--m_busy == 0) {
+				m_done.notify_one();
+			}
+		}
+	}
+
+	std::mutex m_batchMutex; // Held for the duration of a batch
+	std::vector<std::unique_ptr<Worker>> m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	const std::function<void(RenderState&, int)>* m_task = nullptr;
+	RenderState* m_caller = nullptr;
+	int m_count = 0;
+	std::atomic<int> m_next{ 0 };
+	int m_busy = 0;
+	unsigned long long m_batch = 0;
+	bool m_quit = false;
+};
+
+// Never destroyed: joining threads while the DLL unloads can deadlock, so cleanup_steam_audio stops the workers
+static BatchPool& g_batchPool = *new BatchPool;
+
+static void stop_batch_pool()
+{
+	g_batchPool.stop();
+}
+
+// Output length of a batch given each sound's rendered length in samples
+static int batch_length(const BatchSound* sounds, int count, int flags, const std::function<int(int)>& sound_length)
+{
+	long long end = 0;
+	long long cursor = 0;
+	for (int i = 0; i < count; ++i) {
+		long long start = static_cast<long long>(std::max(0, sounds[i].startOffset)) * 2; // 2 channels
+		if (flags & BATCH_CONCATENATE) {
+			start += cursor;
+		}
+		cursor = start + sound_length(i);
+		end = std::max(end, cursor);
+	}
+	return static_cast<int>(std::min<long long>(end, INT32_MAX));
+}
+
+// Maximum number of 16-bit samples process_batch will write
+EXPORT int get_batch_output_length(Renderer* renderer, const BatchSound* sounds, int count, int flags)
+{
+	renderer = resolve_renderer(renderer);
+	if (!renderer || !sounds || count <= 0) {
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(renderer->mutex);
+	return batch_length(sounds, count, flags, [&](int i) {
+		auto sound = find_sound(sounds[i].sound);
+		return sound ? output_length(renderer->render, static_cast<int>(sound->samples.size()), sounds[i].reverb != 0) : 0;
+	});
+}
+
+// Render several registered sounds in one call, in parallel when there is more than one, and mix them
+// at their start offsets (or concatenate them with BATCH_CONCATENATE) into output_buffer.
+// Unknown handles are skipped. If output_capacity is too small, returns false with the needed size in output_length.
+EXPORT bool process_batch(Renderer* renderer, const BatchSound* sounds, int count, int flags, int16_t* output_buffer, int output_capacity, int* output_length)
+{
+	renderer = resolve_renderer(renderer);
+	if (!renderer || !output_length || count < 0 || (count > 0 && !sounds)) {
+		return false;
+	}
+
+	std::vector<std::shared_ptr<const Sound>> inputs(count);
+	std::vector<CachedPcm> rendered(count);
+	for (int i = 0; i < count; ++i) {
+		inputs[i] = find_sound(sounds[i].sound);
+	}
+
+	{
+		RenderLock lock(*renderer);
+		// Like process_sound_handle, turn away a buffer that can't hold the worst case before rendering anything
+		auto needed = batch_length(sounds, count, flags, [&](int i) {
+			return inputs[i] ? ::output_length(renderer->render, static_cast<int>(inputs[i]->samples.size()), sounds[i].reverb != 0) : 0;
+		});
+		if (needed > 0 && (!output_buffer || output_capacity < needed)) {
+			*output_length = needed; // Tell the caller how much room is needed
+			return false;
+		}
+
+		std::function<void(RenderState&, int)> render = [&](RenderState& state, int i) {
+			if (inputs[i]) {
+				rendered[i] = render_pcm(state, sounds[i].sound, *inputs[i], sounds[i].angleX, sounds[i].angleY, sounds[i].gain, sounds[i].reverb != 0);
+			}
+		};
+		g_batchPool.run(renderer->render, count, render);
+	}
+
+	for (int i = 0; i < count; ++i) {
+		if (inputs[i] && !rendered[i]) {
+			return false; // A render failed or the batch was cancelled
+		}
+	}
+
+	auto total_output_samples = batch_length(sounds, count, flags, [&](int i) {
+		return rendered[i] ? static_cast<int>(rendered[i]->size()) : 0;
+	});
+
+	// The renders only ever come in under the worst case, but the room size may have grown the tail since
+	if (total_output_samples > 0 && (!output_buffer || output_capacity < total_output_samples)) {
+		*output_length = total_output_samples;
+		return false;
+	}
+
+	// Mix with 32-bit headroom and saturate once at the end
+	std::vector<int32_t> mix(total_output_samples, 0);
+	long long cursor = 0;
+	for (int i = 0; i < count; ++i) {
+		long long start = static_cast<long long>(std::max(0, sounds[i].startOffset)) * 2; // 2 channels
+		if (flags & BATCH_CONCATENATE) {
+			start += cursor;
+		}
+		size_t length = rendered[i] ? rendered[i]->size() : 0;
+		for (size_t j = 0; j < length; ++j) {
+			mix[start + j] += (*rendered[i])[j];
+		}
+		cursor = start + length;
+	}
+	for (int j = 0; j < total_output_samples; ++j) {
+		output_buffer[j] = static_cast<int16_t>(std::max(-32768, std::min(32767, mix[j])));
+	}
+
+	*output_length = total_output_samples;
+	return true;
+}
+
+// Low-priority background threads that render queued sounds into the output cache ahead of time,
+// so playing them later is a cache lookup. Workers render for the global audio settings and HRTF,
+// the same ones mixers use.
+class BakePool {
+public:
+	// Replace whatever is still queued with items
+	void submit(const BatchSound* items, int count)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.assign(items, items + count);
+			m_generation++;
+			m_cancels++; // Abandon the renders of the bake being replaced
+			m_total = count;
+			m_done = 0;
+			start_locked();
+		}
+		m_wake.notify_all();
+	}
+
+	void cancel()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.clear();
+		m_generation++;
+		m_cancels++;
+		m_total = m_done;
+	}
+
+	void progress(int* done, int* total)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (done) *done = m_done;
+		if (total) *total = m_total;
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+			m_queue.clear();
+			m_cancels++; // Don't wait for the current renders to finish
+			m_total = m_done = 0;
+		}
+		m_wake.notify_all();
+		for (auto& worker : m_workers) {
+			worker->thread.join();
+			destroy_render_state(worker->render);
+		}
+		m_workers.clear();
+		m_quit = false;
+	}
+
+private:
+	struct Worker {
+		std::thread thread;
+		RenderState render;
+	};
+
+	void start_locked()
+	{
+		if (!m_workers.empty()) {
+			return;
+		}
+
+		unsigned cores = std::thread::hardware_concurrency();
+		unsigned count = std::min(cores > 2 ? cores - 2 : 1u, 2u);
+		for (unsigned i = 0; i < count; ++i) {
+			std::unique_ptr<Worker> worker(new Worker);
+			Worker* raw = worker.get();
+			worker->thread = std::thread([this, raw] { worker_loop(*raw); });
+			m_workers.push_back(std::move(worker));
+		}
+	}
+
+	// Returns false once the cache is full. Baking never evicts, or later items would push out earlier ones.
+	static bool bake(RenderState& state, const BatchSound& item)
+	{
+		auto sound = find_sound(item.sound);
+		if (!sound || sound->samples.empty()) {
+			return true; // Released since it was queued
+		}
+		if (!g_outputCache.enabled()) {
+			return false;
+		}
+
+		float angle_x = item.angleX;
+		float angle_y = item.angleY;
+		bool use_reverb = item.reverb != 0 && state.reverbInitialized;
+		CacheKey key = make_cache_key(state.audioSettings, item.sound, angle_x, angle_y, item.gain, use_reverb);
+		if (g_outputCache.contains(key)) {
+			return true;
+		}
+
+		auto input_length = static_cast<int>(sound->samples.size());
+		if (!g_outputCache.has_room(static_cast<size_t>(output_length(state, input_length, use_reverb)) * sizeof(int16_t))) {
+			return false;
+		}
+		if (auto pcm = render_uncached(state, *sound, angle_x, angle_y, item.gain, use_reverb)) {
+			g_outputCache.insert(key, std::move(pcm));
+		}
+		return true;
+	}
+
+	void worker_loop(Worker& worker)
+	{
+#ifdef _WIN32
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#endif
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_quit) {
+			if (m_queue.empty()) {
+				m_wake.wait(lock);
+				continue;
+			}
+			if (!steam_audio_ready()) {
+				// Bakes queued during a background initialization start once the HRTF has loaded
+				m_wake.wait_for(lock, std::chrono::milliseconds(50));
+				continue;
+			}
+
+			BatchSound item = m_queue.front();
+			m_queue.pop_front();
+			auto generation = m_generation;
+			unsigned cancelSeen = m_cancels.load();
+			lock.unlock();
+
+			if (!worker.render.effect && !create_render_state(worker.render, g_state.context, g_state.hrtf, g_state.audioSettings)) {
+				lock.lock();
+				if (generation == m_generation) {
+					m_queue.clear();
+					m_total = m_done; // Give up on the rest, so the progress shows the bake as finished
+				}
+				continue;
+			}
+			worker.render.cancelToken = &m_cancels;
+			worker.render.cancelSeen = cancelSeen;
+			bool more = bake(worker.render, item);
+
+			lock.lock();
+			if (generation != m_generation) {
+				continue; // Superseded while rendering
+			}
+			m_done++;
+			if (!more) {
+				m_queue.clear();
+				m_total = m_done;
+			}
+		}
+	}
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<BatchSound> m_queue;
+	unsigned long long m_generation = 0;
+	std::atomic<unsigned> m_cancels{ 0 }; // Bumped whenever the bake in progress is dropped, to abandon its renders
+	int m_total = 0;
+	int m_done = 0;
+	bool m_quit = false;
+};
+
+// Never destroyed, like g_batchPool
+static BakePool& g_bakePool = *new BakePool;
+
+static void stop_bake_pool()
+{
+	g_bakePool.stop();
+}
+
+// Render items into the output cache on background threads, replacing any bake still in progress.
+// Returns straight away; baking stops early once the cache budget is full. startOffset is ignored.
+EXPORT bool bake_sounds(const BatchSound* sounds, int count)
+{
+	int status = g_status.load(std::memory_order_acquire);
+	if ((status != STEAM_AUDIO_READY && status != STEAM_AUDIO_LOADING) || count < 0 || (count > 0 && !sounds) || !g_outputCache.enabled()) {
+		return false;
+	}
+	g_bakePool.submit(sounds, count);
+	return true;
+}
+
+EXPORT void cancel_bake()
+{
+	g_bakePool.cancel();
+}
+
+// Items baked so far out of the ones that will be
+EXPORT void get_bake_progress(int* done, int* total)
+{
+	g_bakePool.progress(done, total);
+}
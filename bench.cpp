@@ -0,0 +1,870 @@
+// Standalone benchmark for the rendering pipeline, built from the same main.cpp as the DLL (see
+// build_bench.bat). Runs the WAVs in addon/Default through process_sound and apply_reverb for every
+// combination of frame size, reverb settings, HRTF interpolation and thread count, then mixes
+// growing numbers of overlapping voices with and without the mixer's ambisonic bus.
+//
+// Results go to stdout as one JSON object per line, so two runs can be diffed or compared with a
+// script; progress and errors go to stderr.
+//
+// With --verify it instead checks every optimised render path against a scalar reference of the
+// original pipeline, on the same sounds and on synthetic inputs, and exits non-zero on a mismatch.
+//
+// --simd N caps the DSP kernels at a SimdLevel (0 scalar, 1 SSE2, 2 AVX2), to compare them on one machine.
+//
+// bench.exe [--sounds DIR] [--rate HZ] [--iterations N] [--quick] [--verify] [--simd N]
+
+#include "main.cpp"
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+// Every C++ heap allocation in the process, for allocations per call. Steam Audio's own allocations
+// go through its context allocator and aren't counted.
+static std::atomic<long long> g_allocations{ 0 };
+
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try {
+		return operator new(size);
+	} catch (const std::bad_alloc&) {
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+// Kept out of line: once GCC inlines it, it takes the free for a mismatch with operator new
+#ifdef _MSC_VER
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+// The sized, array and nothrow forms must come here too, or they could hand the blocks above to the library's own delete
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+struct ReverbPreset {
+	const char* name;
+	bool enabled;
+	float roomSize, damping, wetLevel, dryLevel, width;
+};
+
+static const ReverbPreset kReverbPresets[] = {
+	{ "off", false, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f },
+	{ "default", true, 0.1f, 1.0f, 0.09f, 0.3f, 1.0f }, // What the add-on uses without a theme setting
+	{ "large", true, 0.9f, 0.3f, 0.3f, 0.6f, 1.0f },
+};
+
+struct BenchSound {
+	std::string name;
+	std::shared_ptr<const Sound> sound;
+	float angleX, angleY;
+};
+
+struct BenchConfig {
+	int frameSize;
+	const ReverbPreset* reverb;
+	bool bilinear;
+	int threads;
+};
+
+struct ThreadResult {
+	bool ok = true;
+	long long processNs = 0;
+	long long reverbNs = 0;
+	long long samples = 0;
+	long long calls = 0;
+};
+
+static long long elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::vector<std::wstring> list_wavs(const std::wstring& dir)
+{
+	std::vector<std::wstring> paths;
+#ifdef _WIN32
+	WIN32_FIND_DATAW data;
+	HANDLE find = FindFirstFileW((dir + L"\\*.wav").c_str(), &data);
+	if (find != INVALID_HANDLE_VALUE) {
+		do {
+			paths.push_back(dir + L"\\" + data.cFileName);
+		} while (FindNextFileW(find, &data));
+		FindClose(find);
+	}
+#else
+	std::vector<char> narrow(dir.size() * 4 + 1);
+	if (wcstombs(narrow.data(), dir.c_str(), narrow.size()) == static_cast<size_t>(-1)) {
+		return paths;
+	}
+	if (DIR* handle = opendir(narrow.data())) {
+		while (dirent* entry = readdir(handle)) {
+			std::string name = entry->d_name;
+			if (name.size() > 4 && name.compare(name.size() - 4, 4, ".wav") == 0) {
+				std::wstring wide(name.size(), L'\0');
+				wide.resize(mbstowcs(&wide[0], name.c_str(), name.size()));
+				paths.push_back(dir + L"/" + wide);
+			}
+		}
+		closedir(handle);
+	}
+#endif
+	std::sort(paths.begin(), paths.end()); // Same order, and so the same angles, on every run
+	return paths;
+}
+
+static std::string narrow_name(const std::wstring& path)
+{
+	auto slash = path.find_last_of(L"\\/");
+	std::wstring name = slash == std::wstring::npos ? path : path.substr(slash + 1);
+	std::string result;
+	for (wchar_t c : name) {
+		result += c < 0x80 ? static_cast<char>(c) : '?';
+	}
+	return result;
+}
+
+// One thread's share of a run: every sound, `iterations` times, through its own renderer
+static void run_pipeline(Renderer* renderer, const std::vector<BenchSound>& sounds, bool reverb, int iterations, ThreadResult& result)
+{
+	for (int iteration = 0; iteration < iterations && result.ok; ++iteration) {
+		for (const auto& sound : sounds) {
+			auto length = static_cast<int>(sound.sound->samples.size());
+			int16_t* dry = nullptr;
+			int dryLength = 0;
+
+			auto start = std::chrono::steady_clock::now();
+			if (!process_sound(renderer, sound.sound->samples.data(), length, sound.angleX, sound.angleY, &dry, &dryLength)) {
+				result.ok = false;
+				return;
+			}
+			result.processNs += elapsed_ns(start);
+			result.calls++;
+
+			if (reverb) {
+				int16_t* wet = nullptr;
+				int wetLength = 0;
+				start = std::chrono::steady_clock::now();
+				bool ok = apply_reverb(renderer, dry, dryLength, &wet, &wetLength);
+				result.reverbNs += elapsed_ns(start);
+				result.calls++;
+				free_output_sound(wet);
+				if (!ok) {
+					free_output_sound(dry);
+					result.ok = false;
+					return;
+				}
+			}
+
+			free_output_sound(dry);
+			result.samples += length;
+		}
+	}
+}
+
+static bool run_config(const BenchConfig& config, int rate, int iterations, const std::vector<BenchSound>& sounds)
+{
+	if (config.reverb->enabled) {
+		const ReverbPreset& preset = *config.reverb;
+		set_reverb_settings(preset.roomSize, preset.damping, preset.wetLevel, preset.dryLevel, preset.width);
+	}
+	set_hrtf_interpolation(config.bilinear);
+
+	std::vector<Renderer*> renderers;
+	for (int i = 0; i < config.threads; ++i) {
+		Renderer* renderer = create_renderer(rate, config.frameSize);
+		if (!renderer) {
+			fprintf(stderr, "Could not create a renderer for frame size %d\n", config.frameSize);
+			for (auto* created : renderers) {
+				destroy_renderer(created);
+			}
+			return false;
+		}
+		renderers.push_back(renderer);
+	}
+
+	// Untimed pass, so every renderer has touched its buffers and the HRTF once
+	for (auto* renderer : renderers) {
+		ThreadResult warmup;
+		run_pipeline(renderer, sounds, config.reverb->enabled, 1, warmup);
+	}
+
+	std::vector<ThreadResult> results(config.threads);
+	std::vector<std::thread> threads;
+	std::mutex startMutex;
+	std::condition_variable startSignal;
+	bool started = false;
+	for (int i = 0; i < config.threads; ++i) {
+		threads.emplace_back([&, i] {
+			{
+				std::unique_lock<std::mutex> lock(startMutex);
+				startSignal.wait(lock, [&] { return started; });
+			}
+			run_pipeline(renderers[i], sounds, config.reverb->enabled, iterations, results[i]);
+		});
+	}
+
+	long long allocationsBefore = g_allocations.load();
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(startMutex);
+		started = true;
+	}
+	startSignal.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	long long wallNs = elapsed_ns(start);
+	long long allocations = g_allocations.load() - allocationsBefore;
+
+	for (auto* renderer : renderers) {
+		destroy_renderer(renderer);
+	}
+
+	ThreadResult total;
+	for (const auto& result : results) {
+		total.ok = total.ok && result.ok;
+		total.processNs += result.processNs;
+		total.reverbNs += result.reverbNs;
+		total.samples += result.samples;
+		total.calls += result.calls;
+	}
+	if (!total.ok || total.samples == 0) {
+		fprintf(stderr, "Rendering failed for frame size %d, reverb %s\n", config.frameSize, config.reverb->name);
+		return false;
+	}
+
+	// Costs are per input sample on one thread; realtime is the combined throughput of every thread
+	double samples = static_cast<double>(total.samples);
+	double audioSeconds = samples / rate;
+	printf("{\"frame_size\":%d,\"reverb\":\"%s\",\"interpolation\":\"%s\",\"threads\":%d,"
+		   "\"calls\":%lld,\"audio_seconds\":%.3f,\"wall_ms\":%.3f,"
+		   "\"process_ns_per_sample\":%.3f,\"reverb_ns_per_sample\":%.3f,\"ns_per_sample\":%.3f,"
+		   "\"realtime\":%.1f,\"allocations_per_call\":%.2f}\n",
+		config.frameSize, config.reverb->name, config.bilinear ? "bilinear" : "nearest", config.threads,
+		total.calls, audioSeconds, wallNs / 1e6,
+		total.processNs / samples, total.reverbNs / samples, (total.processNs + total.reverbNs) / samples,
+		audioSeconds / (wallNs / 1e9), static_cast<double>(allocations) / total.calls);
+	fflush(stdout);
+	return true;
+}
+
+// Mix `voices` overlapping sounds through a mixer, per-voice binaural or through an ambisonic bus of
+// order `order`, and report the render thread's cost per frame from the mixer frame stage timings and
+// how long the first frame took to come out once the sounds were started
+static bool run_mixer_config(int voices, int order, int rate, int iterations, const std::vector<BenchSound>& sounds)
+{
+	Mixer* mixer = create_mixer(voices, order);
+	if (!mixer) {
+		fprintf(stderr, "Could not create a mixer with %d voices\n", voices);
+		return false;
+	}
+	set_mixer_lead(mixer, 0); // Mix as fast as it can rather than in real time
+	set_mixer_limits(mixer, 0, 0, 0); // Every sound started is mixed, repeats of one included
+
+	// The bench's sounds were released after loading, so give the mixer handles to copies of them
+	std::vector<int> handles;
+	for (const auto& sound : sounds) {
+		handles.push_back(register_sound_pcm(sound.sound->samples.data(), static_cast<int>(sound.sound->samples.size()), rate));
+	}
+
+	const StageCounters& stage = g_stats.stages[STAT_MIXER_FRAME];
+	const StageCounters& first = g_stats.stages[STAT_FIRST_FRAME];
+	long long frames = 0, totalNs = 0, firsts = 0, firstNs = 0;
+	std::vector<int16_t> chunk(2 * g_state.audioSettings.frameSize);
+	for (int iteration = 0; iteration < iterations; ++iteration) {
+		long long countBefore = stage.count.load(), nsBefore = stage.totalNs.load();
+		long long firstsBefore = first.count.load(), firstNsBefore = first.totalNs.load();
+		for (int i = 0; i < voices; ++i) {
+			size_t index = (iteration * voices + i) % sounds.size();
+			mixer_play(mixer, handles[index], sounds[index].angleX, sounds[index].angleY, 1.0f, 0.0f, 0, -1, 0);
+		}
+		bool interrupted = false;
+		while (mixer_read(mixer, chunk.data(), g_state.audioSettings.frameSize, 1000, &interrupted) > 0) {
+		}
+		frames += stage.count.load() - countBefore;
+		totalNs += stage.totalNs.load() - nsBefore;
+		firsts += first.count.load() - firstsBefore;
+		firstNs += first.totalNs.load() - firstNsBefore;
+	}
+	destroy_mixer(mixer);
+	for (int handle : handles) {
+		release_sound(handle);
+	}
+
+	if (frames == 0) {
+		fprintf(stderr, "The mixer rendered nothing with %d voices\n", voices);
+		return false;
+	}
+	double nsPerFrame = static_cast<double>(totalNs) / frames;
+	double frameNs = 1e9 * g_state.audioSettings.frameSize / rate;
+	printf("{\"mixer\":\"%s\",\"order\":%d,\"voices\":%d,\"frame_size\":%d,\"frames\":%lld,"
+		   "\"ns_per_frame\":%.0f,\"realtime\":%.1f,\"first_frame_us\":%.1f}\n",
+		order > 0 ? "ambisonic" : "binaural", order, voices, g_state.audioSettings.frameSize, frames,
+		nsPerFrame, frameNs / nsPerFrame, firsts > 0 ? firstNs / 1000.0 / firsts : 0.0);
+	fflush(stdout);
+	return true;
+}
+
+// Scalar reference renders, following the original pipeline step by step: zero padded input, one
+// binaural pass per frame, interleave, truncating 16-bit conversion, and verblib_process over the
+// whole decay tail. They share only the Steam Audio effect and verblib with the paths they check,
+// so those paths can be optimised without the reference moving with them.
+static int16_t reference_sample(float sample, float gain)
+{
+	sample *= gain;
+	sample = std::max(-1.0f, std::min(1.0f, sample));
+	return static_cast<int16_t>(sample * 32767.0f);
+}
+
+static std::vector<int16_t> reference_quantize(const std::vector<float>& samples, float gain, size_t count)
+{
+	std::vector<int16_t> output(count);
+	for (size_t j = 0; j < count; ++j) {
+		output[j] = reference_sample(samples[j], gain);
+	}
+	return output;
+}
+
+// The original direction and binaural params, copied rather than shared so a change to where the
+// live paths place sounds shows up as a mismatch. verify runs with nearest-neighbour HRTF filters,
+// the only ones the original had.
+static IPLBinauralEffectParams reference_params(const RenderState& state, float angle_x, float angle_y)
+{
+	IPLVector3 direction;
+	direction.x = angle_x;
+	direction.y = angle_y;
+	direction.z = 1.0f;
+	float length = sqrtf(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+	direction.x /= length;
+	direction.y /= length;
+	direction.z /= length;
+
+	IPLBinauralEffectParams params;
+	params.direction = direction;
+	params.interpolation = IPL_HRTFINTERPOLATION_NEAREST;
+	params.spatialBlend = 1.0f;
+	params.hrtf = state.hrtf;
+	params.peakDelays = nullptr;
+	return params;
+}
+
+// Interleaved float binaural output for every padded frame of a mono input
+static std::vector<float> reference_binaural(RenderState& state, const std::vector<float>& input, float angle_x, float angle_y, int extra_frames = 0)
+{
+	auto framesize = state.audioSettings.frameSize;
+	auto numframes = static_cast<int>((input.size() + framesize - 1) / framesize);
+	std::vector<float> padded(static_cast<size_t>(numframes) * framesize, 0.0f);
+	std::copy(input.begin(), input.end(), padded.begin());
+
+	iplBinauralEffectReset(state.effect);
+	IPLBinauralEffectParams params = reference_params(state, angle_x, angle_y);
+	std::vector<float> output(static_cast<size_t>(numframes + extra_frames) * framesize * 2, 0.0f);
+	for (int i = 0; i < numframes; ++i) {
+		float* frameData[] = { padded.data() + static_cast<size_t>(i) * framesize };
+		IPLAudioBuffer inBuffer{ 1, framesize, frameData };
+		iplBinauralEffectApply(state.effect, &params, &inBuffer, &state.outBuffer);
+		iplAudioBufferInterleave(state.context, &state.outBuffer, output.data() + static_cast<size_t>(i) * framesize * 2);
+	}
+	return output;
+}
+
+// Frames of decay tail the original apply_reverb rendered after the input
+static int reference_tail_frames(RenderState& state)
+{
+	auto framesize = state.audioSettings.frameSize;
+	return static_cast<int>((verblib_get_decay_time_in_frames(state.reverb.get()) + framesize - 1) / framesize);
+}
+
+// Interleaved float stereo through the scalar verblib, in processing frames, from a clean reverb
+static std::vector<float> reference_reverb(RenderState& state, const std::vector<float>& input)
+{
+	auto framesize = static_cast<size_t>(state.audioSettings.frameSize);
+	std::vector<float> output(input.size());
+	verblib_mute(state.reverb.get());
+	for (size_t offset = 0; offset < input.size(); offset += 2 * framesize) {
+		verblib_process(state.reverb.get(), input.data() + offset, output.data() + offset, static_cast<unsigned long>(framesize));
+	}
+	return output;
+}
+
+// The original apply_reverb: 16-bit stereo in, the full tail out
+static std::vector<int16_t> reference_apply_reverb(RenderState& state, const std::vector<int16_t>& input)
+{
+	auto framesize = static_cast<size_t>(state.audioSettings.frameSize);
+	size_t numframes = (input.size() / 2 + framesize - 1) / framesize;
+	std::vector<float> padded((numframes + reference_tail_frames(state)) * framesize * 2, 0.0f);
+	for (size_t j = 0; j < input.size(); ++j) {
+		padded[j] = static_cast<float>(input[j]) / 32767.0f;
+	}
+	auto wet = reference_reverb(state, padded);
+	return reference_quantize(wet, 1.0f, wet.size());
+}
+
+struct VerifyResults {
+	int checks = 0;
+	int failed = 0;
+};
+
+// Largest error allowed between a path and the reference, in 16-bit steps. Reordered float sums
+// (SSE2 reverb, the mixer's bus) round differently, by far less than one step before truncation.
+static const double kMaxErrorLsb = 2.0;
+static const double kMaxRmsErrorLsb = 0.5;
+
+static double rms_lsb(const int16_t* samples, size_t count)
+{
+	double energy = 0.0;
+	for (size_t j = 0; j < count; ++j) {
+		energy += static_cast<double>(samples[j]) * samples[j];
+	}
+	return count ? std::sqrt(energy / count) : 0.0;
+}
+
+// Compare one path's output with the reference. With tail_may_end the lengths may differ by a reverb
+// tail cut short once inaudible: whatever only one of them has must be below the silence level.
+static void compare(VerifyResults& results, const char* check, const std::string& input, int frame_size, const int16_t* got, int got_length, const std::vector<int16_t>& expected, bool tail_may_end)
+{
+	size_t gotSize = got_length > 0 ? static_cast<size_t>(got_length) : 0;
+	size_t overlap = std::min(gotSize, expected.size());
+	double maxError = 0.0;
+	double errorEnergy = 0.0;
+	for (size_t j = 0; j < overlap; ++j) {
+		double error = std::abs(static_cast<double>(got[j]) - expected[j]);
+		maxError = std::max(maxError, error);
+		errorEnergy += error * error;
+	}
+	double rmsError = overlap ? std::sqrt(errorEnergy / overlap) : 0.0;
+
+	bool lengthOk = gotSize == expected.size();
+	double leftoverRms = 0.0;
+	if (!lengthOk && tail_may_end) {
+		const int16_t* leftover = gotSize > expected.size() ? got + overlap : expected.data() + overlap;
+		leftoverRms = rms_lsb(leftover, std::max(gotSize, expected.size()) - overlap);
+		lengthOk = leftoverRms <= kReverbSilenceLevel * 32767.0f;
+	}
+
+	bool pass = lengthOk && maxError <= kMaxErrorLsb && rmsError <= kMaxRmsErrorLsb;
+	results.checks++;
+	if (!pass) {
+		results.failed++;
+	}
+	printf("{\"check\":\"%s\",\"input\":\"%s\",\"frame_size\":%d,\"length\":%zu,\"expected_length\":%zu,"
+		   "\"max_abs_error\":%.0f,\"rms_error\":%.4f,\"leftover_rms\":%.4f,\"pass\":%s}\n",
+		check, input.c_str(), frame_size, gotSize, expected.size(), maxError, rmsError, leftoverRms, pass ? "true" : "false");
+	fflush(stdout);
+}
+
+// Every path that renders a mono sound, at one frame size, against the reference
+static void verify_renderer(VerifyResults& results, Renderer* renderer, RenderState& reference, const std::string& name, const std::vector<float>& input, float angle_x, float angle_y)
+{
+	RenderState& state = renderer->render;
+	auto framesize = state.audioSettings.frameSize;
+	auto length = static_cast<int>(input.size());
+	size_t dryLength = input.size() * 2;
+	const float gain = 0.7f;
+
+	auto binaural = reference_binaural(reference, input, angle_x, angle_y);
+	auto dry = reference_quantize(binaural, 1.0f, dryLength);
+
+	int16_t* output = nullptr;
+	int outputLength = 0;
+	iplBinauralEffectReset(state.effect);
+	bool ok = process_sound(renderer, input.data(), length, angle_x, angle_y, &output, &outputLength);
+	compare(results, "process_sound", name, framesize, output, ok ? outputLength : 0, dry, false);
+	free_output_sound(output);
+
+	std::vector<int16_t> buffer(get_output_length(renderer, length, true));
+	iplBinauralEffectReset(state.effect);
+	ok = render_sound_into(renderer, input.data(), length, angle_x, angle_y, gain, false, buffer.data(), static_cast<int>(buffer.size()), &outputLength);
+	compare(results, "render_sound_dry", name, framesize, buffer.data(), ok ? outputLength : 0, reference_quantize(binaural, gain, dryLength), false);
+
+	// The reverb takes the dry render as it reached Python: trimmed 16-bit stereo
+	verblib_mute(state.reverb.get());
+	ok = apply_reverb(renderer, dry.data(), static_cast<int>(dry.size()), &output, &outputLength);
+	compare(results, "apply_reverb", name, framesize, output, ok ? outputLength : 0, reference_apply_reverb(reference, dry), true);
+	free_output_sound(output);
+
+	// Fused path: float all the way from the binaural pass through the reverb
+	auto wet = reference_reverb(reference, reference_binaural(reference, input, angle_x, angle_y, reference_tail_frames(reference)));
+	iplBinauralEffectReset(state.effect);
+	verblib_mute(state.reverb.get());
+	ok = render_sound_into(renderer, input.data(), length, angle_x, angle_y, gain, true, buffer.data(), static_cast<int>(buffer.size()), &outputLength);
+	compare(results, "render_sound_reverb", name, framesize, buffer.data(), ok ? outputLength : 0, reference_quantize(wet, gain, wet.size()), true);
+}
+
+// Paths that start from a registered sound and share the default renderer's frame size
+static void verify_handle(VerifyResults& results, RenderState& reference, const std::string& name, int handle, float angle_x, float angle_y)
+{
+	auto sound = find_sound(handle);
+	auto framesize = reference.audioSettings.frameSize;
+	auto& input = sound->samples;
+	std::vector<float> samples(input.begin(), input.end());
+
+	auto binaural = reference_binaural(reference, samples, angle_x, angle_y, reference_tail_frames(reference));
+	auto dry = reference_quantize(binaural, 1.0f, samples.size() * 2);
+	auto wet = reference_reverb(reference, binaural);
+	auto reverb = reference_quantize(wet, 1.0f, wet.size());
+
+	// Output cache angles snap to whole degrees, so integral angles render where they're asked to
+	clear_output_cache();
+	std::vector<int16_t> buffer(get_sound_output_length(nullptr, handle, true));
+	int outputLength = 0;
+	for (const char* check : { "handle_uncached", "handle_cached" }) {
+		bool ok = process_sound_handle(nullptr, handle, angle_x, angle_y, 1.0f, true, buffer.data(), static_cast<int>(buffer.size()), &outputLength);
+		compare(results, check, name, framesize, buffer.data(), ok ? outputLength : 0, reverb, true);
+	}
+
+	// One voice sending everything to the mixer's bus sounds like a render through its own reverb. The
+	// first play renders live and caches its dry render; the replay feeds the bus that 16-bit render,
+	// which is what apply_reverb does with process_sound's output.
+	Mixer* mixer = create_mixer(1, 0);
+	set_mixer_lead(mixer, 0);
+	auto dryReverb = reference_apply_reverb(reference, dry);
+	for (const char* check : { "mixer_send", "mixer_send_cached" }) {
+		std::vector<int16_t> mixed;
+		if (mixer && mixer_play(mixer, handle, angle_x, angle_y, 1.0f, 1.0f, 0, -1, 0)) {
+			std::vector<int16_t> chunk(2 * framesize);
+			bool interrupted = false;
+			while (int frames = mixer_read(mixer, chunk.data(), framesize, 1000, &interrupted)) {
+				mixed.insert(mixed.end(), chunk.begin(), chunk.begin() + 2 * frames);
+			}
+		}
+		bool live = check == std::string("mixer_send");
+		compare(results, check, name, framesize, mixed.data(), static_cast<int>(mixed.size()), live ? reverb : dryReverb, true);
+	}
+	destroy_mixer(mixer);
+
+	BatchSound item{ handle, angle_x, angle_y, 1.0f, 0, 0 };
+	buffer.resize(std::max(1, get_batch_output_length(nullptr, &item, 1, 0)));
+	bool ok = process_batch(nullptr, &item, 1, 0, buffer.data(), static_cast<int>(buffer.size()), &outputLength);
+	compare(results, "batch_dry", name, framesize, buffer.data(), ok ? outputLength : 0, dry, false);
+}
+
+// Everything a mixer plays of one dry sound, with every voice spatialized directly (order 0) or mixed
+// through an ambisonic bus of that order
+static std::vector<int16_t> mix_sound(int handle, int ambisonic_order, float angle_x, float angle_y)
+{
+	std::vector<int16_t> mixed;
+	Mixer* mixer = create_mixer(1, ambisonic_order);
+	if (!mixer) {
+		return mixed;
+	}
+	set_mixer_lead(mixer, 0);
+	int framesize = g_state.audioSettings.frameSize;
+	if (mixer_play(mixer, handle, angle_x, angle_y, 1.0f, 0.0f, 0, -1, 0)) {
+		std::vector<int16_t> chunk(2 * framesize);
+		bool interrupted = false;
+		while (int frames = mixer_read(mixer, chunk.data(), framesize, 1000, &interrupted)) {
+			mixed.insert(mixed.end(), chunk.begin(), chunk.begin() + 2 * frames);
+		}
+	}
+	destroy_mixer(mixer);
+	return mixed;
+}
+
+// Left over right channel energy of interleaved stereo, in dB
+static double level_difference_db(const std::vector<int16_t>& stereo)
+{
+	double left = 1e-3;
+	double right = 1e-3;
+	for (size_t j = 0; j + 1 < stereo.size(); j += 2) {
+		left += static_cast<double>(stereo[j]) * stereo[j];
+		right += static_cast<double>(stereo[j + 1]) * stereo[j + 1];
+	}
+	return 10.0 * std::log10(left / right);
+}
+
+// The ambisonic bus and direct binaural rendering share a listener: a source hard left is clearly
+// louder on the left through both, and a source at the centre of the sound plane is balanced through both. Lower orders
+// image less sharply than the HRTF, so the paths are compared by side rather than sample by sample.
+static void verify_listener_frame(VerifyResults& results, int rate)
+{
+	// Noise, so no one frequency's HRTF response decides the balance
+	std::vector<float> noise(rate / 4);
+	uint32_t state = 0x2468aceu;
+	for (auto& sample : noise) {
+		sample = 0.25f * (static_cast<int>(xorshift32(state) >> 8) - (1 << 23)) / static_cast<float>(1 << 23);
+	}
+	int handle = register_sound_pcm(noise.data(), static_cast<int>(noise.size()), rate);
+
+	struct Source {
+		const char* name;
+		float angleX;
+	};
+	for (const Source& source : { Source{ "hard_left", -90.0f }, Source{ "centre", 0.0f } }) {
+		double direct = level_difference_db(mix_sound(handle, 0, source.angleX, 0.0f));
+		for (int order : { 1, 2 }) {
+			double ambisonic = level_difference_db(mix_sound(handle, order, source.angleX, 0.0f));
+			bool pass = source.angleX < 0.0f ? direct > 3.0 && ambisonic > 3.0 : std::abs(direct) < 1.5 && std::abs(ambisonic) < 1.5;
+			results.checks++;
+			if (!pass) {
+				results.failed++;
+			}
+			printf("{\"check\":\"listener_frame\",\"source\":\"%s\",\"ambisonic_order\":%d,\"direct_level_difference_db\":%.2f,"
+				   "\"ambisonic_level_difference_db\":%.2f,\"pass\":%s}\n",
+				source.name, order, direct, ambisonic, pass ? "true" : "false");
+			fflush(stdout);
+		}
+	}
+	release_sound(handle);
+}
+
+// A batch rendered after cleanup_steam_audio and a fresh initialize matches one rendered before it.
+// The restart stops the batch workers, so this also covers workers started for a second engine.
+static void verify_batch_restart(VerifyResults& results, int rate, const std::string& name, const std::vector<float>& input)
+{
+	auto render_batch = [&](std::vector<int16_t>& output) {
+		int handle = register_sound_pcm(input.data(), static_cast<int>(input.size()), rate);
+		BatchSound items[] = {
+			{ handle, -90.0f, 0.0f, 0.5f, 0, 0 },
+			{ handle, 0.0f, 10.0f, 0.5f, 0, 0 },
+			{ handle, 45.0f, -20.0f, 0.5f, 0, 0 },
+			{ handle, 90.0f, 0.0f, 0.5f, 0, 0 },
+		};
+		const int count = static_cast<int>(sizeof(items) / sizeof(items[0]));
+		output.resize(std::max(1, get_batch_output_length(nullptr, items, count, 0)));
+		int outputLength = 0;
+		bool ok = handle && process_batch(nullptr, items, count, 0, output.data(), static_cast<int>(output.size()), &outputLength);
+		output.resize(ok ? outputLength : 0);
+		release_sound(handle);
+	};
+
+	std::vector<int16_t> before;
+	render_batch(before);
+
+	cleanup_steam_audio();
+	std::vector<int16_t> after;
+	if (initialize_steam_audio(rate, 1024)) {
+		render_batch(after);
+	}
+	compare(results, "batch_restart", name, 1024, after.data(), static_cast<int>(after.size()), before, false);
+}
+
+struct SyntheticInput {
+	std::string name;
+	std::vector<float> samples;
+};
+
+static std::vector<SyntheticInput> synthetic_inputs(int rate)
+{
+	std::vector<SyntheticInput> inputs;
+	inputs.push_back({ "silence", std::vector<float>(rate / 2, 0.0f) });
+
+	// Square wave at full scale, clipping after the HRTF gain
+	std::vector<float> square(rate / 2);
+	for (size_t j = 0; j < square.size(); ++j) {
+		square[j] = (j / 24) % 2 ? 1.0f : -1.0f;
+	}
+	inputs.push_back({ "full_scale", std::move(square) });
+
+	// A short burst, then values in the denormal range and a long silence for the tail to decay into denormals
+	std::vector<float> denormal(rate * 2, 0.0f);
+	uint32_t noise = 0x12345678u;
+	for (int j = 0; j < rate / 20; ++j) {
+		denormal[j] = (static_cast<int>(xorshift32(noise) >> 8) - (1 << 23)) / static_cast<float>(1 << 23);
+	}
+	for (int j = rate / 20; j < rate / 10; ++j) {
+		denormal[j] = (j % 2 ? 1.0f : -1.0f) * 1e-39f;
+	}
+	inputs.push_back({ "denormal_tail", std::move(denormal) });
+
+	// Ends part way through a frame at every frame size checked
+	std::vector<float> ragged(1001);
+	for (size_t j = 0; j < ragged.size(); ++j) {
+		ragged[j] = 0.5f * static_cast<float>(std::sin(2.0 * M_PI * 440.0 * j / rate));
+	}
+	inputs.push_back({ "ragged_sine", std::move(ragged) });
+	return inputs;
+}
+
+static bool verify(int rate, const std::vector<BenchSound>& sounds)
+{
+	// A long tail, so every reverb path renders well into its decay
+	const ReverbPreset& preset = kReverbPresets[2];
+	set_reverb_settings(preset.roomSize, preset.damping, preset.wetLevel, preset.dryLevel, preset.width);
+	set_hrtf_interpolation(false);
+	set_output_dither(false); // Dither makes every path differ
+	set_output_cache_settings(64 * 1024 * 1024, 1.0f);
+
+	std::vector<SyntheticInput> inputs = synthetic_inputs(rate);
+	for (const auto& sound : sounds) {
+		inputs.push_back({ sound.name, std::vector<float>(sound.sound->samples.begin(), sound.sound->samples.end()) });
+	}
+
+	VerifyResults results;
+	for (int frameSize : { 256, 1024 }) {
+		Renderer* renderer = create_renderer(rate, frameSize);
+		RenderState reference;
+		IPLAudioSettings audioSettings{ rate, frameSize };
+		if (!renderer || !create_render_state(reference, g_state.context, g_state.hrtf, audioSettings)) {
+			fprintf(stderr, "Could not create renderers for frame size %d\n", frameSize);
+			destroy_renderer(renderer);
+			return false;
+		}
+		sync_reverb_settings(reference);
+
+		for (size_t i = 0; i < inputs.size(); ++i) {
+			float angleX = -90.0f + (static_cast<int>(i) * 37) % 181;
+			float angleY = -30.0f + (static_cast<int>(i) * 13) % 61;
+			verify_renderer(results, renderer, reference, inputs[i].name, inputs[i].samples, angleX, angleY);
+
+			if (frameSize == g_state.audioSettings.frameSize) {
+				int handle = register_sound_pcm(inputs[i].samples.data(), static_cast<int>(inputs[i].samples.size()), rate);
+				if (handle) {
+					verify_handle(results, reference, inputs[i].name, handle, angleX, angleY);
+					release_sound(handle);
+				}
+			}
+		}
+
+		destroy_render_state(reference);
+		destroy_renderer(renderer);
+	}
+
+	verify_listener_frame(results, rate);
+	verify_batch_restart(results, rate, inputs.back().name, inputs.back().samples);
+
+	printf("{\"verify\":\"steam_audio\",\"simd_level\":%d,\"checks\":%d,\"failed\":%d}\n", get_simd_level(), results.checks, results.failed);
+	return results.failed == 0;
+}
+
+int main(int argc, char** argv)
+{
+	std::wstring soundsDir = L"addon/Default";
+	int rate = 48000;
+	int iterations = 3;
+	bool quick = false;
+	bool verifyOnly = false;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--sounds" && i + 1 < argc) {
+			std::string value = argv[++i];
+			soundsDir.assign(value.begin(), value.end());
+		} else if (arg == "--rate" && i + 1 < argc) {
+			rate = std::atoi(argv[++i]);
+		} else if (arg == "--iterations" && i + 1 < argc) {
+			iterations = std::max(1, std::atoi(argv[++i]));
+		} else if (arg == "--quick") {
+			quick = true;
+		} else if (arg == "--verify") {
+			verifyOnly = true;
+		} else if (arg == "--simd" && i + 1 < argc) {
+			set_simd_limit(std::atoi(argv[++i]));
+		} else {
+			fprintf(stderr, "usage: bench [--sounds DIR] [--rate HZ] [--iterations N] [--quick] [--verify] [--simd N]\n");
+			return 2;
+		}
+	}
+
+	if (!initialize_steam_audio(rate, 1024)) {
+		fprintf(stderr, "Could not initialize Steam Audio at %d Hz\n", rate);
+		return 1;
+	}
+	// Every call should do the full render, not replay a cached one
+	set_output_cache_settings(0, 1.0f);
+
+	std::vector<BenchSound> sounds;
+	for (const auto& path : list_wavs(soundsDir)) {
+		int handle = register_sound(path.c_str());
+		if (!handle) {
+			fprintf(stderr, "Skipping %s, not a WAV the DLL can decode\n", narrow_name(path).c_str());
+			continue;
+		}
+		// Spread the sounds over the field, deterministically
+		auto index = static_cast<int>(sounds.size());
+		sounds.push_back({ narrow_name(path), find_sound(handle), -90.0f + (index * 37) % 181, -30.0f + (index * 13) % 61 });
+		release_sound(handle); // The shared_ptr keeps the samples
+	}
+	if (sounds.empty()) {
+		fprintf(stderr, "No sounds found in the sounds directory\n");
+		cleanup_steam_audio();
+		return 1;
+	}
+
+	if (verifyOnly) {
+		bool ok = verify(rate, sounds);
+		sounds.clear();
+		cleanup_steam_audio();
+		return ok ? 0 : 1;
+	}
+
+	long long totalSamples = 0;
+	for (const auto& sound : sounds) {
+		totalSamples += static_cast<long long>(sound.sound->samples.size());
+	}
+	printf("{\"bench\":\"steam_audio\",\"format\":1,\"sample_rate\":%d,\"sounds\":%zu,\"audio_seconds_per_pass\":%.3f,\"iterations\":%d,\"hardware_threads\":%u,\"simd_level\":%d}\n",
+		rate, sounds.size(), static_cast<double>(totalSamples) / rate, iterations, std::thread::hardware_concurrency(), get_simd_level());
+
+	std::vector<int> frameSizes = quick ? std::vector<int>{ 1024 } : std::vector<int>{ 256, 512, 1024, 2048 };
+	std::vector<int> threadCounts = quick ? std::vector<int>{ 1 } : std::vector<int>{ 1, 2, 4 };
+
+	bool ok = true;
+	for (int frameSize : frameSizes) {
+		for (const auto& reverb : kReverbPresets) {
+			for (bool bilinear : { false, true }) {
+				for (int threads : threadCounts) {
+					ok = run_config(BenchConfig{ frameSize, &reverb, bilinear, threads }, rate, iterations, sounds) && ok;
+				}
+			}
+		}
+	}
+
+	// Mixer cost against the number of overlapping voices, with and without the ambisonic bus
+	std::vector<int> voiceCounts = quick ? std::vector<int>{ 1, 8 } : std::vector<int>{ 1, 2, 4, 8, 16 };
+	for (int order : { 0, 1, 2 }) {
+		for (int voices : voiceCounts) {
+			ok = run_mixer_config(voices, order, rate, iterations, sounds) && ok;
+		}
+	}
+
+	sounds.clear();
+	cleanup_steam_audio();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+@echo off
+rem Builds the 64-bit steam_audio.dll for 64-bit NVDA, next to the 32-bit one from build32.bat.
+call "C:\Program Files\Microsoft Visual Studio\2022\Community\VC\Auxiliary\Build\vcvars64.bat"
+if errorlevel 1 (
+    call "C:\Program Files (x86)\Microsoft Visual Studio\2022\BuildTools\VC\Auxiliary\Build\vcvars64.bat"
+)
+if errorlevel 1 (
+    echo Could not find Visual Studio environment
+    exit /b 1
+)
+cl /nologo /O2 /EHsc /LD main.cpp /I"..\steamaudio\steamaudio\include" "..\steamaudio\steamaudio\lib\windows-x64\phonon.lib" /Fo:main64.obj /link /out:steam_audio64.dll /implib:main64.lib
+if errorlevel 1 (
+    echo Build failed
+    exit /b 1
+)
+echo Build successful
+if not exist addon\globalPlugins\audiothemes\x64 mkdir addon\globalPlugins\audiothemes\x64
+copy /y steam_audio64.dll addon\globalPlugins\audiothemes\x64\steam_audio.dll
+copy /y "..\steamaudio\steamaudio\lib\windows-x64\phonon.dll" addon\globalPlugins\audiothemes\x64\
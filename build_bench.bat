@@ -0,0 +1,19 @@
+@echo off
+rem Builds bench.exe, the standalone rendering benchmark, from the same main.cpp as the DLL.
+rem Run it from the repository root: bench.exe > bench_output.txt
+rem bench.exe --verify checks the optimised render paths against the scalar reference instead.
+call "C:\Program Files\Microsoft Visual Studio\2022\Community\VC\Auxiliary\Build\vcvars32.bat"
+if errorlevel 1 (
+    call "C:\Program Files (x86)\Microsoft Visual Studio\2022\BuildTools\VC\Auxiliary\Build\vcvars32.bat"
+)
+if errorlevel 1 (
+    echo Could not find Visual Studio environment
+    exit /b 1
+)
+cl /nologo /O2 /EHsc bench.cpp /I"..\steamaudio\steamaudio\include" "..\steamaudio\steamaudio\lib\windows-x86\phonon.lib" /link /out:bench.exe
+if errorlevel 1 (
+    echo Build failed
+    exit /b 1
+)
+echo Build successful
+copy /y "..\steamaudio\steamaudio\lib\windows-x86\phonon.dll" .
@@ -0,0 +1,164 @@
+// Standard and platform headers, the export macro, SIMD level selection and aligned storage used by
+// every other part of the DLL.
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <list>
+#include <unordered_map>
+#include <string>
+#include <system_error>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include <phonon.h>
+
+#define VERBLIB_IMPLEMENTATION
+#define verblib_external_buffers // Delay lines live in RenderState::reverbDelayLines, sized for the real rate
+#include "verblib.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define HAVE_SSE2 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC accepts AVX2 intrinsics in any function, so the AVX2 kernels need no special flags
+#define AVX2_TARGET
+#define AVX2_FMA_TARGET
+#else
+// Only the resampler opts into FMA: everywhere else contracting a multiply and add would make the
+// AVX2 kernels round differently from the SSE2 ones
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX2_FMA_TARGET __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <avrt.h>
+#include <objbase.h>
+#include <mmreg.h>
+#include <mmdeviceapi.h>
+#include <audioclient.h>
+#pragma comment(lib, "avrt.lib")
+#pragma comment(lib, "ole32.lib")
+#define EXPORT extern "C" __declspec(dllexport)
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define EXPORT extern "C"
+#endif
+
+// Instruction sets the DSP kernels can use. initialize_steam_audio picks the best the CPU and OS
+// support; the SSE2 kernels are the baseline on x86 and x64.
+enum SimdLevel {
+	SIMD_SCALAR = 0,
+	SIMD_SSE2 = 1,
+	SIMD_AVX2 = 2 // AVX2 and FMA
+};
+
+#ifdef HAVE_SSE2
+static std::atomic<int> g_simdLevel{ SIMD_SSE2 };
+#else
+static std::atomic<int> g_simdLevel{ SIMD_SCALAR };
+#endif
+static std::atomic<int> g_simdLimit{ SIMD_AVX2 }; // Set by set_simd_limit
+
+static bool use_avx2()
+{
+	return g_simdLevel.load(std::memory_order_relaxed) >= SIMD_AVX2;
+}
+
+static int detect_simd_level()
+{
+#if defined(HAVE_SSE2) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return SIMD_SSE2;
+	}
+	__cpuid(info, 1);
+	bool fma = (info[2] & (1 << 12)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	// The OS must save the YMM registers on context switches too
+	if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+		return SIMD_SSE2;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0 ? SIMD_AVX2 : SIMD_SSE2;
+#elif defined(HAVE_SSE2)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? SIMD_AVX2 : SIMD_SSE2;
+#else
+	return SIMD_SCALAR;
+#endif
+}
+
+// Allocator for SIMD-friendly sample storage
+template <typename T, size_t Alignment>
+struct AlignedAllocator {
+	using value_type = T;
+
+	template <typename U>
+	struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() = default;
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t n)
+	{
+#ifdef _WIN32
+		void* p = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+		void* p = std::aligned_alloc(Alignment, ((n * sizeof(T) + Alignment - 1) / Alignment) * Alignment);
+#endif
+		if (!p) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T, 32>>;
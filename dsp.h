@@ -0,0 +1,565 @@
+// Sample kernels in scalar, SSE2 and AVX2 forms: dithered 16-bit conversion, mixing and the stereo
+// reverb comb and allpass banks.
+
+#pragma once
+
+#include "common.h"
+
+// TPDF dither state: one xorshift32 generator per SSE lane
+struct Dither {
+	uint32_t state[4];
+
+	Dither()
+	{
+		static std::atomic<uint32_t> seed{ 0x9e3779b9u };
+		for (auto& lane : state) {
+			lane = seed.fetch_add(0x9e3779b9u) | 1u; // xorshift must never be seeded with zero
+		}
+	}
+};
+
+// Set by set_output_dither
+static std::atomic<bool> g_ditherEnabled{ false };
+
+static inline uint32_t xorshift32(uint32_t& x)
+{
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+// Scale, clamp and quantise one sample. Without dither this truncates, exactly as the original
+// conversion loops did; with dither it adds +-1 LSB of triangular noise and rounds.
+static inline int16_t quantize_sample(float sample, float gain, Dither* dither)
+{
+	sample *= gain;
+	// Clamp to prevent overflow
+	sample = std::max(-1.0f, std::min(1.0f, sample));
+	sample *= 32767.0f;
+	if (!dither) {
+		return static_cast<int16_t>(sample);
+	}
+
+	const float scale = 1.0f / 16777216.0f;
+	sample += (xorshift32(dither->state[0]) >> 8) * scale - (xorshift32(dither->state[0]) >> 8) * scale;
+	return static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, std::nearbyint(sample))));
+}
+
+#ifdef HAVE_SSE2
+static inline __m128i xorshift32_sse2(__m128i& x)
+{
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+	return x;
+}
+
+// quantize_sample for four samples, returned as 32-bit integers for _mm_packs_epi32 to saturate
+static inline __m128i quantize_sse2(__m128 samples, __m128 gain, bool dither, __m128i& rng)
+{
+	samples = _mm_mul_ps(samples, gain);
+	// Operand order matches std::min/std::max, so NaN clamps the same way as the scalar path
+	samples = _mm_max_ps(_mm_min_ps(samples, _mm_set1_ps(1.0f)), _mm_set1_ps(-1.0f));
+	samples = _mm_mul_ps(samples, _mm_set1_ps(32767.0f));
+	if (!dither) {
+		return _mm_cvttps_epi32(samples);
+	}
+
+	const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+	__m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(xorshift32_sse2(rng), 8)), scale);
+	__m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(xorshift32_sse2(rng), 8)), scale);
+	return _mm_cvtps_epi32(_mm_add_ps(samples, _mm_sub_ps(a, b)));
+}
+
+// quantize_sse2 without dither for eight samples, with the same operations so the results are identical
+AVX2_TARGET static inline __m256i quantize_avx2(__m256 samples, __m256 gain)
+{
+	samples = _mm256_mul_ps(samples, gain);
+	samples = _mm256_max_ps(_mm256_min_ps(samples, _mm256_set1_ps(1.0f)), _mm256_set1_ps(-1.0f));
+	return _mm256_cvttps_epi32(_mm256_mul_ps(samples, _mm256_set1_ps(32767.0f)));
+}
+
+// Eight 32-bit samples from each of lo and hi saturated to sixteen 16-bit ones, in order. The pack
+// works within 128-bit lanes, so the middle two quarters come out swapped.
+AVX2_TARGET static inline __m256i pack_avx2(__m256i lo, __m256i hi)
+{
+	return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// Undithered convert_to_int16, sixteen samples at a time. Dithered conversions stay on the SSE2 loop,
+// whose four generator lanes are the Dither state.
+AVX2_TARGET static void convert_to_int16_avx2(const float* input, float gain, int count, int16_t* output)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	int j = 0;
+	for (; j + 16 <= count; j += 16) {
+		__m256i lo = quantize_avx2(_mm256_loadu_ps(input + j), g);
+		__m256i hi = quantize_avx2(_mm256_loadu_ps(input + j + 8), g);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + j), pack_avx2(lo, hi));
+	}
+	_mm256_zeroupper();
+	for (; j < count; ++j) {
+		output[j] = quantize_sample(input[j], gain, nullptr);
+	}
+}
+
+AVX2_TARGET static void convert_stereo_to_int16_avx2(const float* left, const float* right, float gain, int frames, int16_t* output)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	int i = 0;
+	for (; i + 16 <= frames; i += 16) {
+		__m256i l = pack_avx2(quantize_avx2(_mm256_loadu_ps(left + i), g), quantize_avx2(_mm256_loadu_ps(left + i + 8), g));
+		__m256i r = pack_avx2(quantize_avx2(_mm256_loadu_ps(right + i), g), quantize_avx2(_mm256_loadu_ps(right + i + 8), g));
+		// The unpacks work within lanes too: lo holds frames 0-3 and 8-11, hi frames 4-7 and 12-15
+		__m256i lo = _mm256_unpacklo_epi16(l, r);
+		__m256i hi = _mm256_unpackhi_epi16(l, r);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 2 * i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	_mm256_zeroupper();
+	for (; i < frames; ++i) {
+		output[2 * i] = quantize_sample(left[i], gain, nullptr);
+		output[2 * i + 1] = quantize_sample(right[i], gain, nullptr);
+	}
+}
+#endif
+
+// Apply gain and convert interleaved float samples to saturated 16-bit integers, with TPDF dither if dither is set
+static void convert_to_int16(const float* input, float gain, int count, int16_t* output, Dither* dither = nullptr)
+{
+#ifdef HAVE_SSE2
+	if (!dither && use_avx2()) {
+		convert_to_int16_avx2(input, gain, count, output);
+		return;
+	}
+#endif
+	int j = 0;
+#ifdef HAVE_SSE2
+	const __m128 g = _mm_set1_ps(gain);
+	__m128i rng = dither ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->state)) : _mm_setzero_si128();
+	for (; j + 8 <= count; j += 8) {
+		__m128i lo = quantize_sse2(_mm_loadu_ps(input + j), g, dither != nullptr, rng);
+		__m128i hi = quantize_sse2(_mm_loadu_ps(input + j + 4), g, dither != nullptr, rng);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + j), _mm_packs_epi32(lo, hi));
+	}
+	if (dither) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dither->state), rng);
+	}
+#endif
+	for (; j < count; ++j) {
+		output[j] = quantize_sample(input[j], gain, dither);
+	}
+}
+
+// convert_to_int16 for deinterleaved stereo, interleaving into output as it converts
+static void convert_stereo_to_int16(const float* left, const float* right, float gain, int frames, int16_t* output, Dither* dither = nullptr)
+{
+#ifdef HAVE_SSE2
+	if (!dither && use_avx2()) {
+		convert_stereo_to_int16_avx2(left, right, gain, frames, output);
+		return;
+	}
+#endif
+	int i = 0;
+#ifdef HAVE_SSE2
+	const __m128 g = _mm_set1_ps(gain);
+	__m128i rng = dither ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->state)) : _mm_setzero_si128();
+	for (; i + 8 <= frames; i += 8) {
+		__m128i l = _mm_packs_epi32(quantize_sse2(_mm_loadu_ps(left + i), g, dither != nullptr, rng), quantize_sse2(_mm_loadu_ps(left + i + 4), g, dither != nullptr, rng));
+		__m128i r = _mm_packs_epi32(quantize_sse2(_mm_loadu_ps(right + i), g, dither != nullptr, rng), quantize_sse2(_mm_loadu_ps(right + i + 4), g, dither != nullptr, rng));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2 * i), _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2 * i + 8), _mm_unpackhi_epi16(l, r));
+	}
+	if (dither) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dither->state), rng);
+	}
+#endif
+	for (; i < frames; ++i) {
+		output[2 * i] = quantize_sample(left[i], gain, dither);
+		output[2 * i + 1] = quantize_sample(right[i], gain, dither);
+	}
+}
+
+#ifdef HAVE_SSE2
+AVX2_TARGET static void mix_add_avx2(float* dst, const float* src, float gain, size_t count)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	size_t j = 0;
+	for (; j + 8 <= count; j += 8) {
+		_mm256_storeu_ps(dst + j, _mm256_add_ps(_mm256_loadu_ps(dst + j), _mm256_mul_ps(_mm256_loadu_ps(src + j), g)));
+	}
+	_mm256_zeroupper();
+	for (; j < count; ++j) {
+		dst[j] += src[j] * gain;
+	}
+}
+#endif
+
+// dst[j] += src[j] * gain, for mixing a voice or the reverb bus into a frame
+static void mix_add(float* dst, const float* src, float gain, size_t count)
+{
+	size_t j = 0;
+#ifdef HAVE_SSE2
+	if (use_avx2()) {
+		mix_add_avx2(dst, src, gain, count);
+		return;
+	}
+	const __m128 g = _mm_set1_ps(gain);
+	for (; j + 4 <= count; j += 4) {
+		_mm_storeu_ps(dst + j, _mm_add_ps(_mm_loadu_ps(dst + j), _mm_mul_ps(_mm_loadu_ps(src + j), g)));
+	}
+#endif
+	for (; j < count; ++j) {
+		dst[j] += src[j] * gain;
+	}
+}
+
+// dst[j] += src[j] * gain * envelope[i] over frames interleaved frames of channels samples each, for
+// mixing a fading voice. Only runs for the few frames a fade lasts.
+static void mix_add_envelope(float* dst, const float* src, const float* envelope, float gain, size_t frames, int channels)
+{
+	for (size_t i = 0; i < frames; ++i) {
+		float scale = envelope[i] * gain;
+		for (int c = 0; c < channels; ++c) {
+			dst[i * channels + c] += src[i * channels + c] * scale;
+		}
+	}
+}
+
+#ifdef HAVE_SSE2
+// Sets flush-to-zero and denormals-are-zero for the current thread while in scope, so the reverb
+// feedback loops can decay into denormals without the per-sample undenormalise checks
+class DenormalGuard {
+public:
+	DenormalGuard() : m_csr(_mm_getcsr())
+	{
+		_mm_setcsr(m_csr | 0x8040); // FTZ | DAZ
+	}
+
+	~DenormalGuard()
+	{
+		_mm_setcsr(m_csr);
+	}
+
+private:
+	unsigned int m_csr;
+};
+
+// Move an allpass's index on past count samples just processed
+static void allpass_advance(verblib_allpass* allpass, unsigned long count)
+{
+	allpass->bufidx += static_cast<int>(count);
+	if (allpass->bufidx >= allpass->bufsize) {
+		allpass->bufidx = 0;
+	}
+}
+
+// Run one allpass over count samples in place. count must not exceed the delay or cross the wrap.
+static void allpass_block(verblib_allpass* allpass, float* samples, unsigned long count)
+{
+	float* buffer = allpass->buffer + allpass->bufidx;
+	const __m128 feedback = _mm_set1_ps(allpass->feedback);
+	unsigned long n = 0;
+	for (; n + 4 <= count; n += 4) {
+		__m128 input = _mm_load_ps(samples + n);
+		__m128 bufout = _mm_loadu_ps(buffer + n);
+		_mm_storeu_ps(buffer + n, _mm_add_ps(input, _mm_mul_ps(bufout, feedback)));
+		_mm_store_ps(samples + n, _mm_sub_ps(bufout, input));
+	}
+	for (; n < count; ++n) {
+		float bufout = buffer[n];
+		buffer[n] = samples[n] + bufout * allpass->feedback;
+		samples[n] = bufout - samples[n];
+	}
+	allpass_advance(allpass, count);
+}
+
+AVX2_TARGET static void allpass_block_avx2(verblib_allpass* allpass, float* samples, unsigned long count)
+{
+	float* buffer = allpass->buffer + allpass->bufidx;
+	const __m256 feedback = _mm256_set1_ps(allpass->feedback);
+	unsigned long n = 0;
+	for (; n + 8 <= count; n += 8) {
+		__m256 input = _mm256_loadu_ps(samples + n);
+		__m256 bufout = _mm256_loadu_ps(buffer + n);
+		_mm256_storeu_ps(buffer + n, _mm256_add_ps(input, _mm256_mul_ps(bufout, feedback)));
+		_mm256_storeu_ps(samples + n, _mm256_sub_ps(bufout, input));
+	}
+	for (; n < count; ++n) {
+		float bufout = buffer[n];
+		buffer[n] = samples[n] + bufout * allpass->feedback;
+		samples[n] = bufout - samples[n];
+	}
+	allpass_advance(allpass, count);
+}
+
+// The 8 left then 8 right combs of a stereo verblib as 16 SIMD lanes, which share the damping and
+// feedback arithmetic. Comb reads and writes are staged in lane-major blocks. A block never spans a
+// wrap and is shorter than every comb delay, so no sample read in a block was written earlier in the
+// same block. The SSE2 and AVX2 comb banks differ only in how they step the lanes.
+struct CombLanes {
+	static const int count = 2 * verblib_numcombs;
+	static const unsigned long block = 64;
+
+	verblib_comb* combs[count];
+	float* pos[count];
+	float* end[count];
+	alignas(16) float feedback[count];
+	alignas(16) float damp1[count];
+	alignas(16) float damp2[count];
+	alignas(16) float filterstore[count];
+
+	explicit CombLanes(verblib* verb)
+	{
+		for (int k = 0; k < count; ++k) {
+			verblib_comb* comb = k < verblib_numcombs ? &verb->combL[k] : &verb->combR[k - verblib_numcombs];
+			combs[k] = comb;
+			pos[k] = comb->buffer + comb->bufidx;
+			end[k] = comb->buffer + comb->bufsize;
+			feedback[k] = comb->feedback;
+			damp1[k] = comb->damp1;
+			damp2[k] = comb->damp2;
+			filterstore[k] = comb->filterstore;
+		}
+	}
+
+	// Samples the next block can take without any comb or allpass wrapping part way
+	unsigned long next_run(const verblib* verb, unsigned long frames) const
+	{
+		unsigned long run = frames < block ? frames : block;
+		for (int k = 0; k < count; ++k) {
+			run = std::min(run, static_cast<unsigned long>(end[k] - pos[k]));
+		}
+		for (int i = 0; i < verblib_numallpasses; ++i) {
+			run = std::min(run, static_cast<unsigned long>(verb->allpassL[i].bufsize - verb->allpassL[i].bufidx));
+			run = std::min(run, static_cast<unsigned long>(verb->allpassR[i].bufsize - verb->allpassR[i].bufidx));
+		}
+		return run;
+	}
+
+	void gather(float* reads, unsigned long run) const
+	{
+		for (int k = 0; k < count; ++k) {
+			const float* src = pos[k];
+			for (unsigned long n = 0; n < run; ++n) {
+				reads[n * count + k] = src[n];
+			}
+		}
+	}
+
+	void scatter(const float* writes, unsigned long run)
+	{
+		for (int k = 0; k < count; ++k) {
+			float* dst = pos[k];
+			for (unsigned long n = 0; n < run; ++n) {
+				dst[n] = writes[n * count + k];
+			}
+			pos[k] += run;
+			if (pos[k] == end[k]) {
+				pos[k] = combs[k]->buffer;
+			}
+		}
+	}
+
+	// Write the positions and filter states back, once filterstore holds the lanes' final values
+	void finish()
+	{
+		for (int k = 0; k < count; ++k) {
+			combs[k]->bufidx = static_cast<int>(pos[k] - combs[k]->buffer);
+			combs[k]->filterstore = filterstore[k];
+		}
+	}
+};
+
+// Same input scaling as the two stereo branches of verblib_process, into per-sample left and right comb inputs
+static void reverb_block_inputs(const verblib* verb, const float* input_buffer, float* inputs, unsigned long run)
+{
+	float coef_mid = 0.0f, coef_side = 0.0f;
+	if (verb->input_width > 0.0f) {
+		const float tmp = 1 / verblib_max(1 + verb->input_width, 2);
+		coef_mid = tmp;
+		coef_side = verb->input_width * tmp;
+	}
+
+	for (unsigned long n = 0; n < run; ++n) {
+		const float* in = input_buffer + 2 * n;
+		if (verb->input_width > 0.0f) {
+			const float mid = (in[0] + in[1]) * coef_mid;
+			const float side = (in[1] - in[0]) * coef_side;
+			inputs[2 * n] = (mid - side) * (verb->gain * 2.0f);
+			inputs[2 * n + 1] = (mid + side) * (verb->gain * 2.0f);
+		} else {
+			inputs[2 * n] = inputs[2 * n + 1] = (in[0] + in[1]) * verb->gain;
+		}
+	}
+}
+
+// Mix the wet signal after the allpasses with the dry input into run output frames
+static void reverb_block_output(const verblib* verb, const float* wetL, const float* wetR, const float* input_buffer, float* output_buffer, unsigned long run)
+{
+	for (unsigned long n = 0; n < run; ++n) {
+		const float outL = wetL[n];
+		const float outR = wetR[n];
+		// Read the dry input before writing, so in place processing still works
+		const float dryL = input_buffer[0] * verb->dry;
+		const float dryR = input_buffer[1] * verb->dry;
+		output_buffer[0] = outL * verb->wet1 + outR * verb->wet2 + dryL;
+		output_buffer[1] = outR * verb->wet1 + outL * verb->wet2 + dryR;
+
+		input_buffer += 2;
+		output_buffer += 2;
+	}
+}
+
+// verblib_process for stereo input: the combs as 4 SSE vectors of lanes, and the allpasses
+// vectorised across each block of samples
+static void reverb_process_sse2(verblib* verb, const float* input_buffer, float* output_buffer, unsigned long frames)
+{
+	CombLanes lanes(verb);
+	const int count = CombLanes::count;
+	__m128 fb[4], d1[4], d2[4], fs[4];
+	for (int v = 0; v < 4; ++v) {
+		fb[v] = _mm_load_ps(lanes.feedback + 4 * v);
+		d1[v] = _mm_load_ps(lanes.damp1 + 4 * v);
+		d2[v] = _mm_load_ps(lanes.damp2 + 4 * v);
+		fs[v] = _mm_load_ps(lanes.filterstore + 4 * v);
+	}
+
+	alignas(16) float reads[CombLanes::block * count];
+	alignas(16) float writes[CombLanes::block * count];
+	alignas(16) float inputs[CombLanes::block * 2];
+	alignas(16) float wetL[CombLanes::block];
+	alignas(16) float wetR[CombLanes::block];
+
+	while (frames > 0) {
+		unsigned long run = lanes.next_run(verb, frames);
+		lanes.gather(reads, run);
+		reverb_block_inputs(verb, input_buffer, inputs, run);
+
+		for (unsigned long n = 0; n < run; ++n) {
+			const float* read = reads + n * count;
+			float* write = writes + n * count;
+			__m128 inL = _mm_set1_ps(inputs[2 * n]);
+			__m128 inR = _mm_set1_ps(inputs[2 * n + 1]);
+
+			__m128 out0 = _mm_load_ps(read);
+			__m128 out1 = _mm_load_ps(read + 4);
+			__m128 out2 = _mm_load_ps(read + 8);
+			__m128 out3 = _mm_load_ps(read + 12);
+			fs[0] = _mm_add_ps(_mm_mul_ps(out0, d2[0]), _mm_mul_ps(fs[0], d1[0]));
+			fs[1] = _mm_add_ps(_mm_mul_ps(out1, d2[1]), _mm_mul_ps(fs[1], d1[1]));
+			fs[2] = _mm_add_ps(_mm_mul_ps(out2, d2[2]), _mm_mul_ps(fs[2], d1[2]));
+			fs[3] = _mm_add_ps(_mm_mul_ps(out3, d2[3]), _mm_mul_ps(fs[3], d1[3]));
+			_mm_store_ps(write, _mm_add_ps(inL, _mm_mul_ps(fs[0], fb[0])));
+			_mm_store_ps(write + 4, _mm_add_ps(inL, _mm_mul_ps(fs[1], fb[1])));
+			_mm_store_ps(write + 8, _mm_add_ps(inR, _mm_mul_ps(fs[2], fb[2])));
+			_mm_store_ps(write + 12, _mm_add_ps(inR, _mm_mul_ps(fs[3], fb[3])));
+
+			alignas(16) float sums[8];
+			_mm_store_ps(sums, _mm_add_ps(out0, out1));
+			_mm_store_ps(sums + 4, _mm_add_ps(out2, out3));
+			wetL[n] = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+			wetR[n] = (sums[4] + sums[5]) + (sums[6] + sums[7]);
+		}
+
+		// The allpasses are in series, but each delay is longer than a block, so every stage
+		// vectorises across the samples of the block
+		for (int i = 0; i < verblib_numallpasses; ++i) {
+			allpass_block(&verb->allpassL[i], wetL, run);
+			allpass_block(&verb->allpassR[i], wetR, run);
+		}
+
+		reverb_block_output(verb, wetL, wetR, input_buffer, output_buffer, run);
+		input_buffer += 2 * run;
+		output_buffer += 2 * run;
+		lanes.scatter(writes, run);
+		frames -= run;
+	}
+
+	for (int v = 0; v < 4; ++v) {
+		_mm_store_ps(lanes.filterstore + 4 * v, fs[v]);
+	}
+	lanes.finish();
+}
+
+// reverb_process_sse2 with the left and right combs as one AVX vector each. The arithmetic and the
+// order of the sums are the same, so the output is identical.
+AVX2_TARGET static void reverb_process_avx2(verblib* verb, const float* input_buffer, float* output_buffer, unsigned long frames)
+{
+	CombLanes lanes(verb);
+	const int count = CombLanes::count;
+	__m256 fb[2], d1[2], d2[2], fs[2];
+	for (int v = 0; v < 2; ++v) {
+		fb[v] = _mm256_loadu_ps(lanes.feedback + 8 * v);
+		d1[v] = _mm256_loadu_ps(lanes.damp1 + 8 * v);
+		d2[v] = _mm256_loadu_ps(lanes.damp2 + 8 * v);
+		fs[v] = _mm256_loadu_ps(lanes.filterstore + 8 * v);
+	}
+
+	alignas(16) float reads[CombLanes::block * count];
+	alignas(16) float writes[CombLanes::block * count];
+	alignas(16) float inputs[CombLanes::block * 2];
+	alignas(16) float wetL[CombLanes::block];
+	alignas(16) float wetR[CombLanes::block];
+
+	while (frames > 0) {
+		unsigned long run = lanes.next_run(verb, frames);
+		lanes.gather(reads, run);
+		reverb_block_inputs(verb, input_buffer, inputs, run);
+
+		for (unsigned long n = 0; n < run; ++n) {
+			const float* read = reads + n * count;
+			float* write = writes + n * count;
+
+			__m256 outL = _mm256_loadu_ps(read);
+			__m256 outR = _mm256_loadu_ps(read + 8);
+			fs[0] = _mm256_add_ps(_mm256_mul_ps(outL, d2[0]), _mm256_mul_ps(fs[0], d1[0]));
+			fs[1] = _mm256_add_ps(_mm256_mul_ps(outR, d2[1]), _mm256_mul_ps(fs[1], d1[1]));
+			_mm256_storeu_ps(write, _mm256_add_ps(_mm256_set1_ps(inputs[2 * n]), _mm256_mul_ps(fs[0], fb[0])));
+			_mm256_storeu_ps(write + 8, _mm256_add_ps(_mm256_set1_ps(inputs[2 * n + 1]), _mm256_mul_ps(fs[1], fb[1])));
+
+			// Combs k and k + 4 first, as the SSE2 bank adds its vectors
+			alignas(16) float sums[8];
+			_mm_store_ps(sums, _mm_add_ps(_mm256_castps256_ps128(outL), _mm256_extractf128_ps(outL, 1)));
+			_mm_store_ps(sums + 4, _mm_add_ps(_mm256_castps256_ps128(outR), _mm256_extractf128_ps(outR, 1)));
+			wetL[n] = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+			wetR[n] = (sums[4] + sums[5]) + (sums[6] + sums[7]);
+		}
+
+		for (int i = 0; i < verblib_numallpasses; ++i) {
+			allpass_block_avx2(&verb->allpassL[i], wetL, run);
+			allpass_block_avx2(&verb->allpassR[i], wetR, run);
+		}
+
+		reverb_block_output(verb, wetL, wetR, input_buffer, output_buffer, run);
+		input_buffer += 2 * run;
+		output_buffer += 2 * run;
+		lanes.scatter(writes, run);
+		frames -= run;
+	}
+
+	for (int v = 0; v < 2; ++v) {
+		_mm256_storeu_ps(lanes.filterstore + 8 * v, fs[v]);
+	}
+	_mm256_zeroupper();
+	lanes.finish();
+}
+#endif
+
+// Run the reverb over interleaved frames, on the SIMD comb banks when the reverb is stereo
+static void reverb_process(verblib* verb, const float* input_buffer, float* output_buffer, unsigned long frames)
+{
+#ifdef HAVE_SSE2
+	if (verb->channels == 2) {
+		DenormalGuard guard;
+		if (use_avx2()) {
+			reverb_process_avx2(verb, input_buffer, output_buffer, frames);
+		} else {
+			reverb_process_sse2(verb, input_buffer, output_buffer, frames);
+		}
+		return;
+	}
+#endif
+	verblib_process(verb, input_buffer, output_buffer, frames);
+}
@@ -0,0 +1,238 @@
+// Steam Audio initialization and cleanup, shared HRTFs, renderers and the global reverb settings.
+
+#pragma once
+
+#include "render_state.h"
+#include "sounds.h"
+#include "output_cache.h"
+
+static bool create_hrtf(IPLContext context, const IPLAudioSettings& audioSettings, IPLHRTF* hrtf)
+{
+	IPLAudioSettings settings = audioSettings;
+	IPLHRTFSettings hrtfSettings;
+	hrtfSettings.type = IPL_HRTFTYPE_DEFAULT;
+	hrtfSettings.volume = 1.0f;
+
+	return iplHRTFCreate(context, &settings, &hrtfSettings, hrtf) == IPL_STATUS_SUCCESS;
+}
+
+// Create the context, the default HRTF and the default renderer for g_state.audioSettings
+static bool create_steam_audio()
+{
+	IPLContextSettings contextSettings{};
+	contextSettings.version = STEAMAUDIO_VERSION;
+
+	if (iplContextCreate(&contextSettings, &g_state.context) != IPL_STATUS_SUCCESS) {
+		return false;
+	}
+
+	if (!create_hrtf(g_state.context, g_state.audioSettings, &g_state.hrtf)) {
+		iplContextRelease(&g_state.context);
+		return false;
+	}
+
+	try {
+		g_state.renderer.reset(new Renderer);
+	} catch (const std::bad_alloc&) {
+		iplHRTFRelease(&g_state.hrtf);
+		iplContextRelease(&g_state.context);
+		return false;
+	}
+
+	if (!create_render_state(g_state.renderer->render, g_state.context, g_state.hrtf, g_state.audioSettings)) {
+		g_state.renderer.reset();
+		iplHRTFRelease(&g_state.hrtf);
+		iplContextRelease(&g_state.context);
+		return false;
+	}
+	return true;
+}
+
+// Pick the DSP kernels for this CPU, before anything renders
+static void select_simd_level()
+{
+	g_simdLevel.store(std::min(detect_simd_level(), g_simdLimit.load()));
+}
+
+// Wait for a background initialization to finish. Called with g_initMutex held.
+static void join_init_thread()
+{
+	if (g_initThread.joinable()) {
+		g_initThread.join();
+	}
+}
+
+EXPORT bool initialize_steam_audio(int samplingrate, int framesize)
+{
+	std::lock_guard<std::mutex> lock(g_initMutex);
+	if (g_status.load() == STEAM_AUDIO_LOADING) {
+		join_init_thread();
+	}
+	if (g_status.load() == STEAM_AUDIO_READY) {
+		return true; // Already initialized
+	}
+	join_init_thread(); // Reap a background attempt that failed
+
+	select_simd_level();
+	g_state.audioSettings = { samplingrate, framesize };
+	bool success = create_steam_audio();
+	g_status.store(success ? STEAM_AUDIO_READY : STEAM_AUDIO_FAILED, std::memory_order_release);
+	if (success) {
+		resample_registered_sounds(); // Registered before now, or at the rate of an earlier initialization
+	}
+	return success;
+}
+
+// Start initialization on a background thread and return straight away. Mixers can be created and
+// reverb settings changed while it runs; get_steam_audio_status reports when renderers are available.
+EXPORT bool initialize_steam_audio_async(int samplingrate, int framesize)
+{
+	std::lock_guard<std::mutex> lock(g_initMutex);
+	int status = g_status.load();
+	if (status == STEAM_AUDIO_READY || status == STEAM_AUDIO_LOADING) {
+		return true;
+	}
+	join_init_thread();
+
+	select_simd_level();
+	// Written before the thread starts and left alone by it, so it can be read at any point while loading
+	g_state.audioSettings = { samplingrate, framesize };
+	g_status.store(STEAM_AUDIO_LOADING);
+	try {
+		g_initThread = std::thread([] {
+			resample_registered_sounds(); // Registered before now, or at the rate of an earlier initialization
+			g_status.store(create_steam_audio() ? STEAM_AUDIO_READY : STEAM_AUDIO_FAILED, std::memory_order_release);
+		});
+	} catch (const std::system_error&) {
+		g_status.store(STEAM_AUDIO_FAILED);
+		return false;
+	}
+	return true;
+}
+
+// One of SteamAudioStatus
+EXPORT int get_steam_audio_status()
+{
+	return g_status.load(std::memory_order_acquire);
+}
+
+static void stop_all_mixers();
+static void stop_batch_pool();
+static void stop_bake_pool();
+
+static std::mutex g_hrtfsMutex; // Guards g_state.hrtfs
+
+EXPORT void cleanup_steam_audio()
+{
+	std::lock_guard<std::mutex> lock(g_initMutex);
+	join_init_thread();
+	if (g_status.load() != STEAM_AUDIO_READY) {
+		stop_all_mixers(); // Mixers and bakes may have been started while loading
+		stop_bake_pool();
+		g_state = SteamAudioState{};
+		g_status.store(STEAM_AUDIO_UNINITIALIZED);
+		return;
+	}
+
+	stop_all_mixers();
+	stop_batch_pool();
+	stop_bake_pool();
+	destroy_render_state(g_state.renderer->render);
+	g_state.renderer.reset();
+	{
+		// Renderers that are still alive keep their own references
+		std::lock_guard<std::mutex> lock(g_hrtfsMutex);
+		for (auto& shared : g_state.hrtfs) {
+			iplHRTFRelease(&shared.hrtf);
+		}
+	}
+	iplHRTFRelease(&g_state.hrtf);
+	iplContextRelease(&g_state.context);
+
+	g_state = SteamAudioState{}; // Reset to default state
+	g_status.store(STEAM_AUDIO_UNINITIALIZED);
+	g_outputCache.clear(); // Renders depend on the frame size and reverb state
+}
+
+// The HRTF for audio settings, created the first time a renderer asks for them.
+// The returned reference is owned by g_state.
+static IPLHRTF find_or_create_hrtf(const IPLAudioSettings& audioSettings)
+{
+	if (audioSettings.samplingRate == g_state.audioSettings.samplingRate && audioSettings.frameSize == g_state.audioSettings.frameSize) {
+		return g_state.hrtf;
+	}
+
+	std::lock_guard<std::mutex> lock(g_hrtfsMutex);
+	for (auto& shared : g_state.hrtfs) {
+		if (shared.audioSettings.samplingRate == audioSettings.samplingRate && shared.audioSettings.frameSize == audioSettings.frameSize) {
+			return shared.hrtf;
+		}
+	}
+
+	IPLHRTF hrtf = nullptr;
+	if (!create_hrtf(g_state.context, audioSettings, &hrtf)) {
+		return nullptr;
+	}
+	g_state.hrtfs.push_back(SharedHrtf{ audioSettings, hrtf });
+	return hrtf;
+}
+
+// Create an independent renderer sharing the global context and HRTF. initialize_steam_audio must have been called.
+EXPORT Renderer* create_renderer(int samplingrate, int framesize)
+{
+	if (!steam_audio_ready() || samplingrate <= 0 || framesize <= 0) {
+		return nullptr;
+	}
+
+	IPLAudioSettings audioSettings{ samplingrate, framesize };
+	IPLHRTF hrtf = find_or_create_hrtf(audioSettings);
+	if (!hrtf) {
+		return nullptr;
+	}
+
+	std::unique_ptr<Renderer> renderer(new Renderer);
+	if (!create_render_state(renderer->render, g_state.context, hrtf, audioSettings)) {
+		return nullptr;
+	}
+	return renderer.release();
+}
+
+EXPORT void destroy_renderer(Renderer* renderer)
+{
+	if (!renderer) {
+		return;
+	}
+
+	destroy_render_state(renderer->render);
+	delete renderer;
+}
+
+// Exports that are passed a null renderer use the one created by initialize_steam_audio
+static Renderer* resolve_renderer(Renderer* renderer)
+{
+	if (renderer) {
+		return renderer;
+	}
+	return steam_audio_ready() ? g_state.renderer.get() : nullptr;
+}
+
+EXPORT bool set_reverb_settings(float room_size, float damping, float wet_level, float dry_level, float width)
+{
+	if (steam_audio_ready() && !g_state.renderer->render.reverbInitialized) {
+		return false;
+	}
+
+	// Not tied to any render state, so settings made while loading apply once the renderers exist
+	{
+		std::lock_guard<std::mutex> lock(g_reverbSettingsMutex);
+		const ReverbSettings& current = g_reverbSettings;
+		if (current.roomSize == room_size && current.damping == damping && current.wetLevel == wet_level && current.dryLevel == dry_level && current.width == width) {
+			return true; // Unchanged, so cached and baked reverb renders stay valid
+		}
+		g_reverbSettings = ReverbSettings{ room_size, damping, wet_level, dry_level, width };
+	}
+
+	// Every render state picks the new settings up before its next reverb render, and cached reverb renders no longer match
+	g_reverbGeneration++;
+	return true;
+}
@@ -1,282 +1,114 @@
-#include <algorithm>
-#include <vector>
-#include <memory>
-
-#define _USE_MATH_DEFINES
-#include <cmath>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
-#include <phonon.h>
-
-#define VERBLIB_IMPLEMENTATION
-#include "verblib.h"
-
-#ifdef _WIN32
-#define EXPORT extern "C" __declspec(dllexport)
-#else
-#define EXPORT extern "C"
-#endif
-
-// Global state for Steam Audio + Verblib
-struct SteamAudioState {
-	IPLContext context = nullptr;
-	IPLHRTF hrtf = nullptr;
-	IPLBinauralEffect effect = nullptr;
-	IPLAudioSettings audioSettings{};
-	IPLAudioBuffer outBuffer{};
-	std::vector<float> outputaudioframe;
-	std::vector<int16_t> outputInt16;
-	std::vector<float> reverbInputBuffer;
-	std::vector<float> reverbOutputBuffer;
-	bool initialized = false;
-	verblib reverb;
-	bool reverbInitialized = false;
-};
-
-static SteamAudioState g_state;
-
-EXPORT bool initialize_steam_audio(int samplingrate, int framesize)
+// steam_audio.dll is built as this one translation unit (see build32.bat and build64.bat), and
+// bench.cpp includes it whole. Each header holds one part of the engine and includes what it uses;
+// the settings and statistics exports that reach across them live here.
+
+#include "common.h"
+#include "stats.h"
+#include "dsp.h"
+#include "render_state.h"
+#include "output_cache.h"
+#include "sounds.h"
+#include "engine.h"
+#include "render.h"
+#include "batch.h"
+#include "queues.h"
+#include "mixer.h"
+#include "output.h"
+
+// Snapshot of the counters and stage timings since load or the last reset_audio_stats. Each value is
+// read atomically, but the snapshot as a whole isn't, so counts may be off by the calls in flight.
+EXPORT void get_audio_stats(AudioStats* stats)
 {
-	if (g_state.initialized) {
-		return true; // Already initialized
-	}
-
-	IPLContextSettings contextSettings{};
-	contextSettings.version = STEAMAUDIO_VERSION;
-
-	if (iplContextCreate(&contextSettings, &g_state.context) != IPL_STATUS_SUCCESS) {
-		return false;
-	}
-
-	g_state.audioSettings = { samplingrate, framesize };
-
-	IPLHRTFSettings hrtfSettings;
-	hrtfSettings.type = IPL_HRTFTYPE_DEFAULT;
-	hrtfSettings.volume = 1.0f;
-
-	if (iplHRTFCreate(g_state.context, &g_state.audioSettings, &hrtfSettings, &g_state.hrtf) != IPL_STATUS_SUCCESS) {
-		iplContextRelease(&g_state.context);
-		return false;
-	}
-
-	IPLBinauralEffectSettings effectSettings;
-	effectSettings.hrtf = g_state.hrtf;
-
-	if (iplBinauralEffectCreate(g_state.context, &g_state.audioSettings, &effectSettings, &g_state.effect) != IPL_STATUS_SUCCESS) {
-		iplHRTFRelease(&g_state.hrtf);
-		iplContextRelease(&g_state.context);
-		return false;
+	if (!stats) {
+		return;
 	}
 
-	if (iplAudioBufferAllocate(g_state.context, 2, g_state.audioSettings.frameSize, &g_state.outBuffer) != IPL_STATUS_SUCCESS) {
-		iplBinauralEffectRelease(&g_state.effect);
-		iplHRTFRelease(&g_state.hrtf);
-		iplContextRelease(&g_state.context);
-		return false;
+	for (int i = 0; i < STAT_STAGE_COUNT; ++i) {
+		const StageCounters& counters = g_stats.stages[i];
+		StageStats& stage = stats->stages[i];
+		stage.count = counters.count.load(std::memory_order_relaxed);
+		stage.totalNs = counters.totalNs.load(std::memory_order_relaxed);
+		stage.maxNs = counters.maxNs.load(std::memory_order_relaxed);
+		for (int j = 0; j < kStatBuckets; ++j) {
+			stage.buckets[j] = counters.buckets[j].load(std::memory_order_relaxed);
+		}
 	}
-
-	// Initialize verblib for reverb
-	if (verblib_initialize(&g_state.reverb, samplingrate, 2)) {
-		g_state.reverbInitialized = true;
-		g_state.reverbInputBuffer.resize(2 * framesize);
-		g_state.reverbOutputBuffer.resize(2 * framesize);
+	stats->framesRendered = g_stats.framesRendered.load(std::memory_order_relaxed);
+	stats->tailFramesSkipped = g_stats.tailFramesSkipped.load(std::memory_order_relaxed);
+	stats->mixerUnderruns = g_stats.mixerUnderruns.load(std::memory_order_relaxed);
+	stats->failures = g_stats.failures.load(std::memory_order_relaxed);
+	stats->rendersCancelled = g_stats.rendersCancelled.load(std::memory_order_relaxed);
+	stats->soundsMapped = g_stats.soundsMapped.load(std::memory_order_relaxed);
+	stats->soundsUnmapped = g_stats.soundsUnmapped.load(std::memory_order_relaxed);
+	stats->playsCoalesced = g_stats.playsCoalesced.load(std::memory_order_relaxed);
+	stats->playsRejected = g_stats.playsRejected.load(std::memory_order_relaxed);
+	stats->voicesStolen = g_stats.voicesStolen.load(std::memory_order_relaxed);
+	stats->deadlineMisses = g_stats.deadlineMisses.load(std::memory_order_relaxed);
+	stats->priorityInversions = g_stats.priorityInversions.load(std::memory_order_relaxed);
+	stats->realtimeThreads = g_stats.realtimeThreads.load(std::memory_order_relaxed);
+	stats->deviceOutputs = g_stats.deviceOutputs.load(std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(g_soundsMutex);
+		stats->soundBytesMapped = static_cast<long long>(g_mappedBytes);
 	}
-
-	g_state.outputaudioframe.resize(2 * framesize);
-	g_state.outputInt16.resize(2 * framesize);
-	g_state.initialized = true;
-	return true;
+	g_outputCache.stats(&stats->cacheHits, &stats->cacheMisses, nullptr, nullptr);
 }
 
-EXPORT void cleanup_steam_audio()
+// Zero every counter, the output cache hits and misses included
+EXPORT void reset_audio_stats()
 {
-	if (!g_state.initialized) {
-		return;
+	for (auto& counters : g_stats.stages) {
+		counters.count.store(0, std::memory_order_relaxed);
+		counters.totalNs.store(0, std::memory_order_relaxed);
+		counters.maxNs.store(0, std::memory_order_relaxed);
+		for (auto& bucket : counters.buckets) {
+			bucket.store(0, std::memory_order_relaxed);
+		}
 	}
-
-	iplAudioBufferFree(g_state.context, &g_state.outBuffer);
-	iplBinauralEffectRelease(&g_state.effect);
-	iplHRTFRelease(&g_state.hrtf);
-	iplContextRelease(&g_state.context);
-
-	g_state = SteamAudioState{}; // Reset to default state
+	g_stats.framesRendered.store(0, std::memory_order_relaxed);
+	g_stats.tailFramesSkipped.store(0, std::memory_order_relaxed);
+	g_stats.mixerUnderruns.store(0, std::memory_order_relaxed);
+	g_stats.failures.store(0, std::memory_order_relaxed);
+	g_stats.rendersCancelled.store(0, std::memory_order_relaxed);
+	g_stats.soundsMapped.store(0, std::memory_order_relaxed);
+	g_stats.soundsUnmapped.store(0, std::memory_order_relaxed);
+	g_stats.playsCoalesced.store(0, std::memory_order_relaxed);
+	g_stats.playsRejected.store(0, std::memory_order_relaxed);
+	g_stats.voicesStolen.store(0, std::memory_order_relaxed);
+	g_stats.deadlineMisses.store(0, std::memory_order_relaxed);
+	g_stats.priorityInversions.store(0, std::memory_order_relaxed);
+	g_outputCache.reset_stats();
 }
 
-EXPORT bool set_reverb_settings(float room_size, float damping, float wet_level, float dry_level, float width)
+// Add TPDF dither whenever float audio is converted to 16-bit
+EXPORT void set_output_dither(bool enabled)
 {
-	if (!g_state.initialized || !g_state.reverbInitialized) {
-		return false;
+	if (g_ditherEnabled.exchange(enabled) != enabled) {
+		g_outputCache.clear(); // Cached renders were quantised the other way
 	}
-
-	if (g_state.reverbInitialized) {
-		verblib_set_room_size(&g_state.reverb, room_size);
-		verblib_set_damping(&g_state.reverb, damping);
-		verblib_set_wet(&g_state.reverb, wet_level);
-		verblib_set_dry(&g_state.reverb, dry_level);
-		verblib_set_width(&g_state.reverb, width);
-	}
-
-	return true;
 }
 
-EXPORT bool process_sound(const float* input_buffer, int input_length, float angle_x, float angle_y, int16_t** output_buffer, int* output_length)
+// Blend the four nearest HRTF measurements instead of using the nearest one. Smoother between
+// measured directions, at a higher cost per frame.
+EXPORT void set_hrtf_interpolation(bool bilinear)
 {
-	if (!g_state.initialized || !input_buffer || !output_buffer || !output_length) {
-		return false;
-	}
-
-	auto framesize = g_state.audioSettings.frameSize;
-	auto numframes = (input_length + framesize - 1) / framesize; // Ceiling division
-
-	if (numframes == 0) {
-		*output_buffer = nullptr;
-		*output_length = 0;
-		return true;
-	}
-
-	// Allocate output buffer for stereo output (16-bit samples)
-	auto total_output_samples = numframes * framesize * 2; // 2 channels
-	int16_t* output = new int16_t[total_output_samples];
-
-	// Create a padded input buffer to handle partial frames
-	std::vector<float> paddedInput;
-	const float* inData = input_buffer;
-	if (input_length % framesize != 0) {
-		paddedInput.resize(numframes * framesize, 0.0f);
-		std::copy(input_buffer, input_buffer + input_length, paddedInput.begin());
-		inData = paddedInput.data();
+	if (g_hrtfBilinear.exchange(bilinear) != bilinear) {
+		g_outputCache.clear(); // Cached renders used the other filters
 	}
-
-	int16_t* outData = output;
-
-	// Treat input as Cartesian coordinates (x, y) and create normalized direction vector
-	// Steam Audio uses right-handed coordinate system: +X right, +Y up, +Z forward
-	IPLVector3 direction;
-	direction.x = angle_x;  // X coordinate (left/right)
-	direction.y = angle_y;  // Y coordinate (up/down)
-	direction.z = 1.0f;     // Default forward distance
-
-	// Normalize the direction vector
-	float length = sqrtf(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
-	if (length > 0.0f) {
-		direction.x /= length;
-		direction.y /= length;
-		direction.z /= length;
-	} else {
-		// Default to forward direction if coordinates are zero
-		direction.x = 0.0f;
-		direction.y = 0.0f;
-		direction.z = 1.0f;
-	}
-
-	for (int i = 0; i < numframes; ++i)
-	{
-		float* frameData[] = { const_cast<float*>(inData) };
-		IPLAudioBuffer inBuffer{ 1, framesize, frameData };
-
-		IPLBinauralEffectParams params;
-		params.direction = direction;
-		params.interpolation = IPL_HRTFINTERPOLATION_NEAREST;
-		params.spatialBlend = 1.0f;
-		params.hrtf = g_state.hrtf;
-		params.peakDelays = nullptr;
-
-		if (iplBinauralEffectApply(g_state.effect, &params, &inBuffer, &g_state.outBuffer) != IPL_STATUS_SUCCESS) {
-			delete[] output;
-			return false;
-		}
-
-		iplAudioBufferInterleave(g_state.context, &g_state.outBuffer, g_state.outputaudioframe.data());
-
-		// Convert float samples to 16-bit integers
-		for (int j = 0; j < framesize * 2; ++j) {
-			float sample = g_state.outputaudioframe[j];
-			// Clamp to prevent overflow
-			sample = std::max(-1.0f, std::min(1.0f, sample));
-			g_state.outputInt16[j] = static_cast<int16_t>(sample * 32767.0f);
-		}
-
-		// Copy 16-bit stereo data to output buffer
-		std::copy(g_state.outputInt16.begin(), g_state.outputInt16.end(), outData);
-
-		inData += framesize;
-		outData += framesize * 2; // 2 channels
-	}
-
-	*output_buffer = output;
-	*output_length = total_output_samples;
-	return true;
 }
 
-EXPORT bool apply_reverb(const int16_t* input_buffer, int input_length, int16_t** output_buffer, int* output_length)
+// One of SimdLevel: the instruction set the DSP kernels are using
+EXPORT int get_simd_level()
 {
-	if (!g_state.initialized || !g_state.reverbInitialized || !input_buffer || !output_buffer || !output_length) {
-		return false;
-	}
-
-	auto framesize = g_state.audioSettings.frameSize;
-	auto numframes = (input_length / 2 + framesize - 1) / framesize; // Ceiling division, /2 because stereo
-
-	if (numframes == 0) {
-		*output_buffer = nullptr;
-		*output_length = 0;
-		return true;
-	}
-
-	// Calculate tail frames for reverb decay
-	unsigned long tail_frames = 0;
-	tail_frames = verblib_get_decay_time_in_frames(&g_state.reverb);
-	// Convert sample frames to processing frames
-	tail_frames = (tail_frames + framesize - 1) / framesize;
-
-	auto total_frames = numframes + tail_frames;
-	auto total_output_samples = total_frames * framesize * 2; // 2 channels
-
-	// Allocate output buffer
-	int16_t* output = new int16_t[total_output_samples];
-
-	// Create padded input buffer for processing
-	std::vector<float> paddedInput(total_frames * framesize * 2, 0.0f);
-
-	// Convert input int16 to float and copy to padded buffer
-	for (int i = 0; i < input_length; ++i) {
-		paddedInput[i] = static_cast<float>(input_buffer[i]) / 32767.0f;
-	}
-
-	int16_t* outData = output;
-	const float* inData = paddedInput.data();
-
-	for (int i = 0; i < total_frames; ++i)
-	{
-		// Copy stereo data to reverb input buffer
-		std::copy(inData, inData + framesize * 2, g_state.reverbInputBuffer.begin());
-
-		// Process with verblib
-		verblib_process(&g_state.reverb, g_state.reverbInputBuffer.data(), g_state.reverbOutputBuffer.data(), framesize);
-
-		// Convert float samples back to 16-bit integers
-		for (int j = 0; j < framesize * 2; ++j) {
-			float sample = g_state.reverbOutputBuffer[j];
-			// Clamp to prevent overflow
-			sample = std::max(-1.0f, std::min(1.0f, sample));
-			outData[j] = static_cast<int16_t>(sample * 32767.0f);
-		}
-
-		inData += framesize * 2;
-		outData += framesize * 2;
-	}
-
-	*output_buffer = output;
-	*output_length = total_output_samples;
-	return true;
+	return g_simdLevel.load();
 }
 
-EXPORT void free_output_sound(int16_t* buffer)
+// Never use kernels above level, for comparing against the baseline. Takes effect at the next
+// initialize_steam_audio, or straight away when lowering the level in use.
+EXPORT void set_simd_limit(int level)
 {
-	if (buffer) {
-		delete[] buffer;
+	g_simdLimit.store(level);
+	if (g_simdLevel.load() > level) {
+		g_simdLevel.store(std::max(level, static_cast<int>(SIMD_SCALAR)));
 	}
 }
@@ -0,0 +1,1325 @@
+// Mixer: a render thread that mixes many voices into one ring of 16-bit stereo frames, and its exports.
+
+#pragma once
+
+#include "queues.h"
+#include "render.h"
+
+enum MixerPlayFlags {
+	MIXER_PLAY_INTERRUPT = 1, // Stop everything that is playing or queued first
+	MIXER_PLAY_QUEUED = 2,    // Start once every previously started or queued sound has finished
+};
+
+struct MixerCommand {
+	std::shared_ptr<const Sound> sound; // Null for a bare interrupt
+	int handle = 0;
+	float angleX = 0.0f;
+	float angleY = 0.0f;
+	float gain = 1.0f;
+	float send = 0.0f; // Reverb send level
+	int flags = 0;
+	int group = -1;    // Sounds in a group share its voice limit; negative for none
+	int priority = 0;  // Higher priorities keep their voices when every voice is busy
+	DirectionPath path; // Where a moving sound goes from angleX, angleY; empty for one that stays put
+	std::chrono::steady_clock::time_point posted; // For first frame latency and coalescing
+	// Looked up or allocated by the posting thread, so the render thread needn't
+	bool keyed = false;                             // Caching was on, and the angles are snapped to its buckets
+	CacheKey key{};
+	CachedPcm cached;
+	std::shared_ptr<std::vector<int16_t>> capture;  // For recording a live render into the cache
+};
+
+// What a finished voice held, handed from the render thread to the reader so whatever it frees or
+// puts in the output cache is done off the render thread
+struct RetiredVoice {
+	std::shared_ptr<const Sound> sound;
+	CachedPcm cached;
+	std::shared_ptr<std::vector<int16_t>> capture;
+	bool completed = false; // The capture holds a whole render, of rendered samples, for the cache
+	size_t rendered = 0;
+	CacheKey key{};
+};
+
+struct MixerVoice {
+	RenderState render;
+	bool active = false;
+	bool sequential = false; // Started by an interrupt or from the queue, so queued sounds wait for it
+	unsigned long long order = 0;
+	std::shared_ptr<const Sound> sound;
+	int handle = 0;
+	int group = -1;
+	int priority = 0;
+	CachedPcm cached;                               // Replayed as-is when the render was cached
+	std::shared_ptr<std::vector<int16_t>> capture;  // Live render recorded for the cache
+	CacheKey key{};
+	IPLBinauralEffectParams params{};
+	DirectionPath path;  // Followed a frame at a time by a moving sound
+	float gain = 1.0f;
+	float send = 0.0f;
+	bool panned = false; // Started before the HRTF was loaded, so played with a plain stereo pan
+	float panLeft = 0.0f;
+	float panRight = 0.0f;
+	int frame = 0;
+	int totalFrames = 0;
+	bool firstFrame = false; // The next frame mixed is the first of a sound whose latency is timed
+	std::chrono::steady_clock::time_point posted;
+	float level = 1.0f;      // Fade envelope reached at the end of the last frame mixed
+	float levelStep = 0.0f;  // Change per sample while fading, negative when fading out
+	bool releasing = false;  // Fading out after an interrupt; finished once the fade reaches silence
+};
+
+// How far ahead of real time a mixer renders unless set_mixer_lead says otherwise
+static const int kDefaultMixerLeadMs = 40;
+// How long an interrupted sound takes to fade out unless set_mixer_fades says otherwise
+static const int kDefaultMixerFadeOutMs = 5;
+// Admission limits unless set_mixer_limits says otherwise
+static const int kDefaultMixerGroupVoices = 2;
+static const int kDefaultMixerMaxQueued = 8;
+static const int kDefaultMixerCoalesceMs = 50;
+// Queued sounds a mixer can hold whatever set_mixer_limits allows
+static const size_t kMixerQueueCapacity = 64;
+// Finished voices waiting for the reader to release them
+static const size_t kMixerRetiredCapacity = 256;
+
+// Mixes active voices one processing frame at a time on a single long-lived render thread into a
+// lock-free ring, which the output side drains with read(). Commands never block on rendering.
+// Voices are rendered dry; reverb comes from one verblib on a send bus, processed once per frame
+// however many voices feed it. With an ambisonic order, voices are encoded into one ambisonic bus
+// instead of each running its own binaural effect, and the bus is decoded once per frame.
+// Rendering is paced against the clock, so a sound started on top of others lands in a frame that
+// is at most the lead ahead of what is being played rather than behind everything the output has
+// buffered. An interrupt fades out what is playing in the frames that follow what has already been
+// mixed, so the output carries on instead of having to drop what it has buffered.
+// Bursts of plays are bounded before any rendering: a repeat of a sound started moments ago is
+// dropped, plays made moot by a later interrupt are skipped, each group of sounds gets a limited
+// number of voices, and the queue of waiting sounds is capped.
+// Once its voices are set up, the render thread neither allocates nor frees memory, and takes a lock
+// only to pick up new commands. Cache lookups and capture buffers are prepared by the thread that posts
+// a play, and whatever finished voices release is handed back to the reader. On Windows the thread
+// runs as an MMCSS Pro Audio task.
+class Mixer;
+static void stop_outputs(const Mixer* mixer);
+
+class Mixer {
+public:
+	Mixer() : m_queued(kMixerQueueCapacity) {}
+
+	// Nothing may still be reading, so this thread can take the reader's side of the retired ring
+	~Mixer()
+	{
+		stop();
+		collect_retired();
+	}
+
+	bool start(int maxVoices, int ambisonicOrder)
+	{
+		m_audioSettings = g_state.audioSettings;
+		m_ambisonicOrder = std::min(std::max(ambisonicOrder, 0), 3);
+		auto framesize = m_audioSettings.frameSize;
+
+		for (int i = 0; i < maxVoices; ++i) {
+			m_voices.push_back(std::unique_ptr<MixerVoice>(new MixerVoice));
+		}
+		// Otherwise the render states are created by the first play posted once loading has finished
+		if (!prepare_spatial()) {
+			stop();
+			return false;
+		}
+
+		// The bus has no binaural effect, so it works while the HRTF is still loading
+		if (!create_reverb(m_bus, m_audioSettings)) {
+			stop();
+			return false;
+		}
+		m_send.resize(2 * framesize);
+
+		m_mix.resize(2 * framesize);
+		m_envelope.resize(framesize);
+		m_frame.resize(2 * framesize);
+		m_ring.allocate(4 * 2 * framesize); // A few frames of headroom between the render thread and the output
+		m_retired.allocate(kMixerRetiredCapacity);
+		m_commands.reserve(kMixerQueueCapacity);
+
+		m_thread = std::thread(&Mixer::run, this);
+		return true;
+	}
+
+	void stop()
+	{
+		// Outputs read the ring from threads of their own, so they must be finished before it is torn down
+		stop_outputs(this);
+
+		m_quit.store(true, std::memory_order_release);
+		m_wake.signal();
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+
+		m_stopped = true;
+		m_dataReady.signal();
+
+		for (auto& voice : m_voices) {
+			finish_voice(*voice, false);
+			destroy_render_state(voice->render);
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_spatialMutex);
+			for (auto& state : m_preparedStates) {
+				destroy_render_state(state);
+			}
+			m_preparedStates.clear();
+			destroy_ambisonic_bus(m_preparedAmbisonic);
+			m_spatialPending.store(false, std::memory_order_relaxed);
+		}
+		while (!m_queued.empty()) {
+			m_queued.pop_front();
+		}
+		// What the voices retired stays in the ring for the reader: cleanup can stop a mixer while
+		// another thread is still inside read(), and the ring takes only one consumer
+		m_voices.clear();
+		destroy_render_state(m_bus);
+		destroy_ambisonic_bus(m_ambisonic);
+	}
+
+	void post(MixerCommand command)
+	{
+		command.posted = std::chrono::steady_clock::now();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_commands.push_back(std::move(command));
+		}
+		m_commandsPosted.store(true, std::memory_order_release);
+		m_wake.signal();
+	}
+
+	// On a control or posting thread: once the HRTF has loaded, give every voice a binaural effect, or an
+	// encoder and the mixer its ambisonic bus, for the render thread to take up before its next frame.
+	// Only tried once; false if creating them failed, and the mixer keeps panning.
+	bool prepare_spatial()
+	{
+		if (m_spatialPrepared.load(std::memory_order_acquire) || !steam_audio_ready()) {
+			return true;
+		}
+		std::lock_guard<std::mutex> lock(m_spatialMutex);
+		if (m_spatialPrepared.load(std::memory_order_relaxed)) {
+			return true;
+		}
+		bool created = create_voice_states();
+		m_spatialPending.store(created, std::memory_order_release);
+		m_spatialPrepared.store(true, std::memory_order_release);
+		return created;
+	}
+
+	// On the posting thread: find the sound's render in the output cache, or set aside a buffer to
+	// record it into, so the render thread needn't take the cache's lock or allocate
+	void prepare(MixerCommand& command) const
+	{
+		// The cache only holds renders of sounds that stay put, so moving ones are always rendered live
+		if (!g_outputCache.enabled() || !command.path.empty()) {
+			return;
+		}
+		command.keyed = true;
+		command.key = make_cache_key(m_audioSettings, command.handle, command.angleX, command.angleY, command.gain, false);
+		command.cached = g_outputCache.find(command.key);
+		// Encoded voices never have a binaural render of their own to record
+		if (command.cached || m_ambisonicOrder > 0) {
+			return;
+		}
+		auto framesize = static_cast<size_t>(m_audioSettings.frameSize);
+		auto numframes = (command.sound->samples.size() + framesize - 1) / framesize;
+		try {
+			StageTimer timer(STAT_ALLOCATION);
+			command.capture = std::make_shared<std::vector<int16_t>>(numframes * 2 * framesize);
+		} catch (const std::bad_alloc&) {
+			command.capture.reset(); // Caching is best effort
+		}
+	}
+
+	// 0 renders as far ahead as the ring allows
+	void set_lead(int leadMs)
+	{
+		m_leadNs.store(static_cast<long long>(std::max(leadMs, 0)) * 1000000, std::memory_order_relaxed);
+		m_wake.signal();
+	}
+
+	int sample_rate() const
+	{
+		return m_audioSettings.samplingRate;
+	}
+
+	// Whether the render thread runs as an MMCSS Pro Audio task, and the CPU it is kept to, or -1 for
+	// any. Applied by the render thread itself before it mixes its next frame. Windows only.
+	void set_scheduling(bool proAudio, int cpu)
+	{
+		m_proAudio.store(proAudio, std::memory_order_relaxed);
+		m_cpu.store(cpu, std::memory_order_relaxed);
+		m_schedulingChanged.store(true, std::memory_order_release);
+		m_wake.signal();
+	}
+
+	// Sounds started from now on fade in over fadeInMs, and an interrupt fades out what is playing over
+	// fadeOutMs. A fade out of 0 cuts interrupted sounds off and discards what is already mixed.
+	void set_fades(int fadeInMs, int fadeOutMs)
+	{
+		m_fadeInMs.store(std::max(fadeInMs, 0), std::memory_order_relaxed);
+		m_fadeOutMs.store(std::max(fadeOutMs, 0), std::memory_order_relaxed);
+	}
+
+	// groupVoices sounds of one group may play at once before the oldest is faded out, and maxQueued
+	// sounds may wait in the queue before the oldest is dropped; 0 for no limit, though the queue never
+	// holds more than kMixerQueueCapacity. A sound played again within coalesceMs of starting isn't
+	// started twice.
+	void set_limits(int groupVoices, int maxQueued, int coalesceMs)
+	{
+		m_groupVoices.store(std::max(groupVoices, 0), std::memory_order_relaxed);
+		m_maxQueued.store(std::max(maxQueued, 0), std::memory_order_relaxed);
+		m_coalesceMs.store(std::max(coalesceMs, 0), std::memory_order_relaxed);
+	}
+
+	// Copy up to maxFrames stereo frames of mixed output, waiting up to timeoutMs for some to arrive.
+	// interrupted is set when an interrupt discarded previously mixed audio the output may still be playing.
+	int read(int16_t* output, int maxFrames, int timeoutMs, bool* interrupted)
+	{
+		if (interrupted) {
+			*interrupted = false;
+		}
+
+		// The render thread fell behind the output while a sound was playing
+		if (m_ring.read_available() == 0 && m_playing && !m_flushPending) {
+			stat_add(g_stats.mixerUnderruns);
+		}
+
+		collect_retired();
+
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		for (;;) {
+			if (m_ring.read_available() == 0 && !m_flushPending.load() && !m_stopped) {
+				m_dataReady.wait_until(deadline);
+			}
+
+			if (m_flushPending.exchange(false)) {
+				if (m_ring.skip_to(m_flushTo.load()) && interrupted) {
+					*interrupted = true;
+				}
+				// An interrupted sound's first frame will never be heard
+				if (m_firstPending.load(std::memory_order_acquire) && reached(m_firstPosition.load(std::memory_order_relaxed))) {
+					m_firstPending.store(false, std::memory_order_release);
+				}
+			}
+
+			// Keep waiting through an interrupt until the new sound's first frame arrives
+			if (m_ring.read_available() > 0 || m_stopped || std::chrono::steady_clock::now() >= deadline) {
+				break;
+			}
+		}
+
+		size_t count = m_ring.read(output, static_cast<size_t>(std::max(0, maxFrames)) * 2);
+		if (count > 0) {
+			if (m_firstPending.load(std::memory_order_acquire) && reached(m_firstPosition.load(std::memory_order_relaxed))) {
+				std::chrono::steady_clock::time_point posted(std::chrono::steady_clock::duration(m_firstPosted.load(std::memory_order_relaxed)));
+				auto elapsed = std::chrono::steady_clock::now() - posted;
+				record_stage(STAT_FIRST_FRAME, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+				m_firstPending.store(false, std::memory_order_release);
+			}
+			m_wake.signal(); // There is room for another frame
+		}
+		return static_cast<int>(count / 2);
+	}
+
+private:
+	// Reader side: release what finished voices held, and put completed captures in the output cache
+	void collect_retired()
+	{
+		RetiredVoice retired;
+		while (m_retired.pop(retired)) {
+			release_retired(retired);
+		}
+	}
+
+	static void release_retired(RetiredVoice& retired)
+	{
+		if (retired.completed && retired.capture) {
+			// Keep only what was actually rendered, trimmed like render_sound's dry output
+			retired.capture->resize(retired.rendered);
+			retired.capture->shrink_to_fit();
+			g_outputCache.insert(retired.key, std::move(retired.capture));
+		}
+		retired = RetiredVoice{};
+	}
+
+	// Render thread side: hand references over to the reader, or let them go here if it has fallen
+	// far behind
+	void retire(RetiredVoice&& retired)
+	{
+		if (!m_retired.push(std::move(retired))) {
+			release_retired(retired);
+		}
+	}
+
+	// Hand a sound over to the reader if this looks like the last reference to it, so that freeing or
+	// unmapping its samples doesn't happen on the render thread
+	void release_sound_ref(std::shared_ptr<const Sound>& sound)
+	{
+		if (sound && sound.use_count() == 1) {
+			RetiredVoice retired;
+			retired.sound = std::move(sound);
+			retire(std::move(retired));
+		}
+		sound.reset();
+	}
+
+	void release_command(MixerCommand& command)
+	{
+		release_sound_ref(command.sound);
+		if (command.cached || command.capture) {
+			RetiredVoice retired;
+			retired.cached = std::move(command.cached);
+			retired.capture = std::move(command.capture);
+			retire(std::move(retired));
+		}
+	}
+
+	// Render thread only: join or leave the MMCSS task and apply the CPU affinity
+	void apply_scheduling(bool leaving)
+	{
+#ifdef _WIN32
+		bool proAudio = !leaving && m_proAudio.load(std::memory_order_relaxed);
+		if (proAudio && !m_mmcss) {
+			DWORD taskIndex = 0;
+			m_mmcss = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+			if (m_mmcss) {
+				stat_add(g_stats.realtimeThreads);
+			} else {
+				stat_add(g_stats.failures);
+			}
+		} else if (!proAudio && m_mmcss) {
+			AvRevertMmThreadCharacteristics(m_mmcss);
+			m_mmcss = nullptr;
+			stat_add(g_stats.realtimeThreads, -1);
+		}
+		if (leaving) {
+			return;
+		}
+
+		DWORD_PTR processMask = 0;
+		DWORD_PTR systemMask = 0;
+		if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+			int cpu = m_cpu.load(std::memory_order_relaxed);
+			DWORD_PTR mask = processMask;
+			if (cpu >= 0 && cpu < static_cast<int>(8 * sizeof(DWORD_PTR)) && (processMask >> cpu) & 1) {
+				mask = static_cast<DWORD_PTR>(1) << cpu;
+			}
+			SetThreadAffinityMask(GetCurrentThread(), mask);
+		}
+#else
+		(void)leaving;
+#endif
+	}
+
+	// Consumer side: the reader has been handed the sample at position
+	bool reached(size_t position) const
+	{
+		return static_cast<std::ptrdiff_t>(m_ring.read_position() - position) > 0;
+	}
+
+	int fade_samples(const std::atomic<int>& ms) const
+	{
+		return static_cast<int>(static_cast<long long>(ms.load(std::memory_order_relaxed)) * m_audioSettings.samplingRate / 1000);
+	}
+
+	std::chrono::steady_clock::duration frames_duration(long long frames) const
+	{
+		double seconds = static_cast<double>(frames) * m_audioSettings.frameSize / m_audioSettings.samplingRate;
+		return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+	}
+
+	// When the next frame should be mixed to stay the lead ahead of the clock. Never less than a
+	// frame ahead, or the output would be waiting on every frame as it is mixed.
+	std::chrono::steady_clock::time_point next_frame_due() const
+	{
+		long long lead = m_leadNs.load(std::memory_order_relaxed);
+		if (!m_clockRunning || lead == 0) {
+			return std::chrono::steady_clock::time_point::min();
+		}
+		auto ahead = std::max<std::chrono::steady_clock::duration>(
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(lead)), frames_duration(1));
+		return m_clockStart + frames_duration(m_clockFrames) - ahead;
+	}
+
+	// Count a frame against the clock, restarting it when playback starts or the output has played
+	// everything mixed so far and is waiting on the mixer
+	void advance_clock()
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (!m_clockRunning || m_clockStart + frames_duration(m_clockFrames) < now) {
+			if (m_clockRunning) {
+				stat_add(g_stats.deadlineMisses); // The output ran out before this frame was ready
+			}
+			m_clockStart = now;
+			m_clockFrames = 0;
+			m_clockRunning = true;
+		}
+		m_clockFrames++;
+	}
+
+	void run()
+	{
+		std::vector<MixerCommand> commands;
+		commands.reserve(kMixerQueueCapacity);
+		apply_scheduling(false);
+		while (!m_quit.load(std::memory_order_acquire)) {
+			if (m_schedulingChanged.exchange(false, std::memory_order_acquire)) {
+				apply_scheduling(false);
+			}
+			if (!m_spatial && m_spatialPending.load(std::memory_order_acquire)) {
+				take_voice_states();
+			}
+
+			if (m_commandsPosted.exchange(false, std::memory_order_acquire)) {
+				{
+					// Only posting threads share this lock, and only for a push_back
+					std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+					if (!lock.owns_lock()) {
+						stat_add(g_stats.priorityInversions);
+						lock.lock();
+					}
+					commands.swap(m_commands);
+				}
+				// Whatever was posted before the last interrupt would only be interrupted again
+				size_t first = 0;
+				for (size_t i = 0; i < commands.size(); ++i) {
+					if (commands[i].flags & MIXER_PLAY_INTERRUPT) {
+						first = i;
+					}
+				}
+				for (size_t i = 0; i < commands.size(); ++i) {
+					if (i >= first) {
+						apply_command(commands[i]);
+					} else if (commands[i].sound) {
+						stat_add(g_stats.playsCoalesced);
+					}
+					release_command(commands[i]);
+				}
+				commands.clear();
+				start_queued();
+				continue;
+			}
+
+			if ((!has_active_voice() && !m_busRinging) || m_ring.write_available() < m_frame.size()) {
+				m_wake.wait_until(std::chrono::steady_clock::time_point::max());
+				continue;
+			}
+
+			auto due = next_frame_due();
+			if (std::chrono::steady_clock::now() < due) {
+				m_wake.wait_until(due); // Commands still wake it straight away
+				continue;
+			}
+
+			mix_frame();
+			start_queued();
+		}
+		apply_scheduling(true);
+	}
+
+	// Create the states prepare_spatial hands over. Needs the global context and HRTF.
+	bool create_voice_states()
+	{
+		m_preparedStates.resize(m_voices.size());
+		if (m_ambisonicOrder > 0 && !create_ambisonic_bus(m_preparedAmbisonic, g_state.context, g_state.hrtf, m_audioSettings, m_ambisonicOrder)) {
+			return false;
+		}
+		for (auto& state : m_preparedStates) {
+			bool created = m_ambisonicOrder > 0
+				? create_encoder_state(state, g_state.context, g_state.hrtf, m_audioSettings, m_ambisonicOrder)
+				: create_render_state(state, g_state.context, g_state.hrtf, m_audioSettings, false);
+			if (!created) {
+				for (auto& other : m_preparedStates) {
+					destroy_render_state(other);
+				}
+				destroy_ambisonic_bus(m_preparedAmbisonic);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// On the render thread: swap in the prepared states. The voices' empty ones go the other way, so
+	// this only moves and never allocates or frees. Nothing else touches them once m_spatialPending is set.
+	void take_voice_states()
+	{
+		for (size_t i = 0; i < m_voices.size(); ++i) {
+			std::swap(m_voices[i]->render, m_preparedStates[i]);
+		}
+		std::swap(m_ambisonic, m_preparedAmbisonic);
+		m_spatialPending.store(false, std::memory_order_relaxed);
+		m_spatial = true;
+	}
+
+	bool has_active_voice() const
+	{
+		for (auto& voice : m_voices) {
+			if (voice->active) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool has_sequential_voice() const
+	{
+		for (auto& voice : m_voices) {
+			if (voice->active && voice->sequential) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Whether a sound started at posted is recent enough for a play posted at now to be a repeat of it
+	bool within_coalesce_window(std::chrono::steady_clock::time_point posted, std::chrono::steady_clock::time_point now) const
+	{
+		return now - posted < std::chrono::milliseconds(m_coalesceMs.load(std::memory_order_relaxed));
+	}
+
+	// The voice playing the same sound from a play only just before this one
+	MixerVoice* find_repeated_voice(const MixerCommand& command)
+	{
+		for (auto& voice : m_voices) {
+			if (voice->active && !voice->releasing && voice->handle == command.handle && within_coalesce_window(voice->posted, command.posted)) {
+				return voice.get();
+			}
+		}
+		return nullptr;
+	}
+
+	bool is_repeated_in_queue(const MixerCommand& command) const
+	{
+		for (size_t i = 0; i < m_queued.size(); ++i) {
+			if (m_queued[i].handle == command.handle && within_coalesce_window(m_queued[i].posted, command.posted)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void clear_queue()
+	{
+		while (!m_queued.empty()) {
+			MixerCommand command = m_queued.pop_front();
+			release_command(command);
+		}
+	}
+
+	void apply_command(MixerCommand& command)
+	{
+		// A repeat carries on with the voice already playing the sound, before anything is rendered for it
+		MixerVoice* repeated = command.sound ? find_repeated_voice(command) : nullptr;
+
+		if (command.flags & MIXER_PLAY_INTERRUPT) {
+			clear_queue();
+			int fadeOut = fade_samples(m_fadeOutMs);
+			if (fadeOut > 0) {
+				fade_out_all(fadeOut, repeated);
+			} else {
+				cut_all(repeated);
+			}
+			if (repeated) {
+				repeated->sequential = true; // It stands in for the interrupting sound
+			}
+		}
+
+		if (!command.sound) {
+			return;
+		}
+
+		if (repeated || ((command.flags & MIXER_PLAY_QUEUED) && is_repeated_in_queue(command))) {
+			stat_add(g_stats.playsCoalesced);
+			return;
+		}
+
+		if (command.flags & MIXER_PLAY_QUEUED) {
+			size_t maxQueued = static_cast<size_t>(m_maxQueued.load(std::memory_order_relaxed));
+			if (maxQueued == 0 || maxQueued > m_queued.capacity()) {
+				maxQueued = m_queued.capacity();
+			}
+			if (m_queued.size() >= maxQueued) {
+				// The sound that has waited longest is the most out of date
+				MixerCommand oldest = m_queued.pop_front();
+				release_command(oldest);
+				stat_add(g_stats.playsRejected);
+			}
+			m_queued.push_back(std::move(command));
+		} else {
+			start_voice(command, (command.flags & MIXER_PLAY_INTERRUPT) != 0);
+		}
+	}
+
+	// Fade a voice out over samples from the next frame on, or stop it at once for 0
+	void release_voice(MixerVoice& voice, int samples)
+	{
+		if (samples <= 0) {
+			finish_voice(voice, false);
+			return;
+		}
+		voice.releasing = true;
+		voice.sequential = false; // Queued sounds don't wait for a sound on its way out
+		voice.levelStep = -1.0f / samples;
+	}
+
+	// Fade out every playing voice but keep and the bus tail from the next frame on. What is already
+	// mixed plays out in full, and the fade carries on from it without a click.
+	void fade_out_all(int samples, const MixerVoice* keep)
+	{
+		for (auto& voice : m_voices) {
+			if (voice->active && !voice->releasing && voice.get() != keep) {
+				release_voice(*voice, samples);
+			}
+		}
+		// The interrupted sounds' tail goes with them. A sound started during the fade loses the
+		// start of its reverb with it, which is only the length of the fade.
+		if (m_busRinging && m_busStep == 0.0f) {
+			m_busStep = -1.0f / samples;
+		}
+	}
+
+	// Stop every voice but keep at once and discard what the ring holds, for the output to drop what
+	// it has buffered
+	void cut_all(const MixerVoice* keep)
+	{
+		for (auto& voice : m_voices) {
+			if (voice.get() != keep) {
+				finish_voice(*voice, false);
+			}
+		}
+		m_playing = false; // Until the new sound's first frame
+		m_clockRunning = false; // The output drops what it has buffered, so the new sound starts now
+		if (m_busRinging) {
+			// The interrupted sounds' tail goes with them
+			verblib_mute(m_bus.reverb.get());
+			m_busRinging = false;
+		}
+		m_busLevel = 1.0f;
+		m_busStep = 0.0f;
+		// Everything already in the ring belongs to the interrupted sounds
+		m_flushTo.store(m_ring.write_position());
+		m_flushPending.store(true);
+		m_dataReady.signal();
+	}
+
+	void start_queued()
+	{
+		while (!m_queued.empty() && !has_sequential_voice()) {
+			MixerCommand command = m_queued.pop_front();
+			start_voice(command, true);
+			release_command(command);
+		}
+	}
+
+	// Which of two busy voices to give up first: one already fading out, then the lower priority,
+	// then the one that has been playing longest
+	static bool steal_before(const MixerVoice& a, const MixerVoice& b)
+	{
+		if (a.releasing != b.releasing) {
+			return a.releasing;
+		}
+		if (a.priority != b.priority) {
+			return a.priority < b.priority;
+		}
+		return a.order < b.order;
+	}
+
+	// A free voice, or one taken from a sound less worth keeping. Null when every voice is playing a
+	// sound of higher priority.
+	MixerVoice* allocate_voice(int priority)
+	{
+		MixerVoice* victim = nullptr;
+		for (auto& voice : m_voices) {
+			if (!voice->active) {
+				return voice.get();
+			}
+			if (!victim || steal_before(*voice, *victim)) {
+				victim = voice.get();
+			}
+		}
+		if (!victim || (!victim->releasing && victim->priority > priority)) {
+			return nullptr;
+		}
+		if (!victim->releasing) {
+			stat_add(g_stats.voicesStolen);
+		}
+		finish_voice(*victim, false);
+		return victim;
+	}
+
+	// Fade out the oldest voices of a group until there is room in it for one more
+	void make_room_in_group(int group)
+	{
+		int limit = m_groupVoices.load(std::memory_order_relaxed);
+		if (group < 0 || limit <= 0) {
+			return;
+		}
+		for (;;) {
+			int count = 0;
+			MixerVoice* oldest = nullptr;
+			for (auto& voice : m_voices) {
+				if (voice->active && !voice->releasing && voice->group == group) {
+					count++;
+					if (!oldest || voice->order < oldest->order) {
+						oldest = voice.get();
+					}
+				}
+			}
+			if (count < limit) {
+				return;
+			}
+			release_voice(*oldest, fade_samples(m_fadeOutMs));
+			stat_add(g_stats.voicesStolen);
+		}
+	}
+
+	void start_voice(MixerCommand& command, bool sequential)
+	{
+		if (command.sound->samples.empty()) {
+			return;
+		}
+
+		make_room_in_group(command.group);
+		MixerVoice* voice = allocate_voice(command.priority);
+		if (!voice) {
+			stat_add(g_stats.playsRejected);
+			return;
+		}
+
+		RenderState& state = voice->render;
+		auto framesize = m_audioSettings.frameSize;
+		auto input_length = static_cast<int>(command.sound->samples.size());
+		auto numframes = (input_length + framesize - 1) / framesize; // Ceiling division
+
+		voice->sound = command.sound;
+		voice->handle = command.handle;
+		voice->group = command.group;
+		voice->priority = command.priority;
+		voice->gain = command.gain;
+		voice->send = m_bus.reverbInitialized ? std::min(std::max(command.send, 0.0f), 1.0f) : 0.0f;
+		voice->sequential = sequential;
+		voice->order = m_nextOrder++;
+		voice->frame = 0;
+		// The tail rings out on the bus, so a voice is done when its input is
+		voice->totalFrames = numframes;
+		// Queued sounds wait for others on purpose, so only sounds started straight away are timed
+		voice->firstFrame = !(command.flags & MIXER_PLAY_QUEUED);
+		voice->posted = command.posted;
+		int fadeIn = fade_samples(m_fadeInMs);
+		voice->level = fadeIn > 0 ? 0.0f : 1.0f;
+		voice->levelStep = fadeIn > 0 ? 1.0f / fadeIn : 0.0f;
+		voice->releasing = false;
+
+		voice->path = command.path;
+		set_pan(*voice, make_direction(command.angleX, command.angleY));
+		voice->panned = !m_spatial;
+		if (voice->panned) {
+			voice->active = true;
+			return;
+		}
+
+		// prepare() has already snapped the angles to the cache's buckets
+		if (command.keyed) {
+			voice->key = command.key;
+			voice->cached = std::move(command.cached);
+			if (voice->cached) {
+				// Dry renders end part way through their last frame
+				voice->totalFrames = static_cast<int>((voice->cached->size() + 2 * framesize - 1) / (2 * framesize));
+				voice->active = voice->totalFrames > 0;
+				return;
+			}
+		}
+
+		// Render live, starting from a clean effect so earlier sounds don't leak in
+		if (state.encoder) {
+			iplAmbisonicsEncodeEffectReset(state.encoder);
+		} else {
+			iplBinauralEffectReset(state.effect);
+		}
+		voice->params = make_binaural_params(state, command.angleX, command.angleY);
+
+		// Encoded voices never have a binaural render of their own to record
+		if (!state.encoder) {
+			voice->capture = std::move(command.capture);
+		}
+		voice->active = true;
+	}
+
+	// Constant power pan by how far right of the listener direction points, so nothing is dropped
+	// while the HRTF loads. Ambisonic voices feed the reverb bus this way too, as the bus has no
+	// stereo image of them.
+	static void set_pan(MixerVoice& voice, const IPLVector3& direction)
+	{
+		float side = direction.x * kListenerRight.x + direction.y * kListenerRight.y + direction.z * kListenerRight.z;
+		float pan = std::min(std::max(side, -1.0f), 1.0f);
+		float theta = (pan + 1.0f) * 0.25f * static_cast<float>(M_PI);
+		voice.panLeft = std::cos(theta) * voice.gain;
+		voice.panRight = std::sin(theta) * voice.gain;
+	}
+
+	void finish_voice(MixerVoice& voice, bool completed)
+	{
+		voice.active = false;
+		if (!voice.sound && !voice.cached && !voice.capture) {
+			return;
+		}
+		RetiredVoice retired;
+		if (completed && voice.capture) {
+			retired.completed = true;
+			retired.rendered = std::min(static_cast<size_t>(voice.frame) * m_mix.size(), voice.sound->samples.size() * 2);
+			retired.key = voice.key;
+		}
+		retired.sound = std::move(voice.sound);
+		retired.cached = std::move(voice.cached);
+		retired.capture = std::move(voice.capture);
+		retire(std::move(retired));
+	}
+
+	// Fill envelope with a fade for the next frame, moving level along by step a sample at a time
+	void fill_envelope(float& level, float step)
+	{
+		for (auto& value : m_envelope) {
+			level = std::min(std::max(level + step, 0.0f), 1.0f);
+			value = level;
+		}
+	}
+
+	// The voice's fade across this frame, or null when it plays at a steady level
+	const float* advance_envelope(MixerVoice& voice)
+	{
+		if (voice.levelStep == 0.0f) {
+			return nullptr;
+		}
+		fill_envelope(voice.level, voice.levelStep);
+		if (voice.level >= 1.0f && !voice.releasing) {
+			voice.levelStep = 0.0f; // Faded in
+		}
+		return m_envelope.data();
+	}
+
+	void mix_voice(MixerVoice& voice)
+	{
+		auto samples = m_mix.size();
+		const float* envelope = advance_envelope(voice);
+		size_t offset = static_cast<size_t>(voice.frame) * samples;
+		if (!voice.path.empty()) {
+			follow_path(m_audioSettings, voice.path, voice.frame, voice.params);
+			set_pan(voice, voice.params.direction);
+		}
+
+		// The bus adds no dry signal of its own, so the direct path carries it instead,
+		// turned down the same way a per-sound reverb would at this send level
+		float direct = 1.0f - voice.send * (1.0f - m_busDry);
+		float send = voice.send;
+		if (send > 0.0f) {
+			m_sending = true;
+		}
+
+		if (voice.panned) {
+			auto framesize = static_cast<int>(samples / 2);
+			auto begin = voice.frame * framesize;
+			auto count = std::min(framesize, static_cast<int>(voice.sound->samples.size()) - begin);
+			const float* src = voice.sound->samples.data() + begin;
+			for (int j = 0; j < count; ++j) {
+				float value = envelope ? src[j] * envelope[j] : src[j];
+				float left = value * voice.panLeft;
+				float right = value * voice.panRight;
+				m_mix[2 * j] += left * direct;
+				m_mix[2 * j + 1] += right * direct;
+				m_send[2 * j] += left * send;
+				m_send[2 * j + 1] += right * send;
+			}
+		} else if (voice.cached) {
+			const int16_t* src = voice.cached->data() + offset;
+			size_t count = std::min(samples, voice.cached->size() - offset);
+			for (size_t j = 0; j < count; ++j) {
+				float value = src[j] * (envelope ? envelope[j / 2] * (1.0f / 32767.0f) : 1.0f / 32767.0f);
+				m_mix[j] += value * direct;
+				m_send[j] += value * send;
+			}
+		} else if (voice.render.encoder) {
+			encode_voice(voice, direct, send, envelope);
+		} else {
+			const float* frameOut = render_frame(voice.render, voice.sound->samples.data(), static_cast<int>(voice.sound->samples.size()), voice.frame, voice.params, false);
+			if (envelope) {
+				mix_add_envelope(m_mix.data(), frameOut, envelope, voice.gain * direct, samples / 2, 2);
+				if (send > 0.0f) {
+					mix_add_envelope(m_send.data(), frameOut, envelope, voice.gain * send, samples / 2, 2);
+				}
+			} else {
+				mix_add(m_mix.data(), frameOut, voice.gain * direct, samples);
+				if (send > 0.0f) {
+					mix_add(m_send.data(), frameOut, voice.gain * send, samples);
+				}
+			}
+			if (voice.capture) {
+				convert_to_int16(frameOut, voice.gain, static_cast<int>(samples), voice.capture->data() + offset, output_dither(voice.render));
+			}
+		}
+
+		if (++voice.frame >= voice.totalFrames) {
+			finish_voice(voice, true);
+		} else if (voice.releasing && voice.level <= 0.0f) {
+			finish_voice(voice, false);
+		}
+	}
+
+	// Add a voice's current frame to the ambisonic bus, and its reverb send panned in stereo
+	void encode_voice(MixerVoice& voice, float direct, float send, const float* envelope)
+	{
+		RenderState& state = voice.render;
+		auto framesize = m_audioSettings.frameSize;
+		auto input_length = static_cast<int>(voice.sound->samples.size());
+		int offset = voice.frame * framesize;
+		int count = std::min(framesize, input_length - offset);
+
+		// The last frame may be partial, so pad it through the scratch frame. A fade is applied there too,
+		// as the encoder takes a single gain.
+		const float* frameIn = voice.sound->samples.data() + offset;
+		if (envelope) {
+			for (int j = 0; j < count; ++j) {
+				state.inputframe[j] = frameIn[j] * envelope[j];
+			}
+			std::fill(state.inputframe.begin() + count, state.inputframe.end(), 0.0f);
+			frameIn = state.inputframe.data();
+		} else if (count < framesize) {
+			std::copy(frameIn, frameIn + count, state.inputframe.begin());
+			std::fill(state.inputframe.begin() + count, state.inputframe.end(), 0.0f);
+			frameIn = state.inputframe.data();
+		}
+		encode_ambisonic(m_ambisonic, state, frameIn, voice.params.direction, voice.gain * direct);
+
+		if (send > 0.0f) {
+			float left = voice.panLeft * send;
+			float right = voice.panRight * send;
+			for (int j = 0; j < count; ++j) {
+				m_send[2 * j] += frameIn[j] * left;
+				m_send[2 * j + 1] += frameIn[j] * right;
+			}
+		}
+	}
+
+	// Picks up new reverb settings, keeping the wet signal only; voices carry the dry part
+	void sync_bus_settings()
+	{
+		if (!m_bus.reverbInitialized || m_bus.reverbGeneration == g_reverbGeneration.load()) {
+			return;
+		}
+		sync_reverb_settings(m_bus);
+		m_busDry = m_bus.reverb->dry;
+		verblib_set_dry(m_bus.reverb.get(), 0.0f);
+	}
+
+	// One reverb pass for every voice's send, running on after they finish until the tail dies away
+	void mix_bus()
+	{
+		if (!m_sending && !m_busRinging) {
+			return;
+		}
+
+		auto framesize = m_audioSettings.frameSize;
+		float* busOut = m_bus.reverbOutputBuffer.data();
+		reverb_process(m_bus.reverb.get(), m_send.data(), busOut, framesize);
+		if (m_busStep != 0.0f) {
+			// Fading out an interrupted tail
+			fill_envelope(m_busLevel, m_busStep);
+			mix_add_envelope(m_mix.data(), busOut, m_envelope.data(), 1.0f, framesize, 2);
+			if (m_busLevel <= 0.0f) {
+				verblib_mute(m_bus.reverb.get());
+				m_busLevel = 1.0f;
+				m_busStep = 0.0f;
+				if (!m_sending) {
+					m_busRinging = false;
+					return;
+				}
+			}
+		} else {
+			mix_add(m_mix.data(), busOut, 1.0f, m_mix.size());
+		}
+
+		if (m_sending) {
+			m_busTail = ReverbTailGate{};
+			m_busRinging = true;
+		} else if (m_busTail.update(m_bus, busOut, 1.0f)) {
+			verblib_mute(m_bus.reverb.get()); // Nothing audible left, don't let denormals build up
+			m_busRinging = false;
+		}
+	}
+
+	void mix_frame()
+	{
+		StageTimer timer(STAT_MIXER_FRAME);
+		std::fill(m_mix.begin(), m_mix.end(), 0.0f);
+		std::fill(m_send.begin(), m_send.end(), 0.0f);
+		sync_bus_settings();
+		m_sending = false;
+		advance_clock();
+		bool first = false;
+		std::chrono::steady_clock::time_point posted;
+		for (auto& voice : m_voices) {
+			if (voice->active) {
+				if (voice->firstFrame && (!first || voice->posted < posted)) {
+					posted = voice->posted;
+					first = true;
+				}
+				voice->firstFrame = false;
+				mix_voice(*voice);
+			}
+		}
+		if (m_ambisonic.decoder) {
+			decode_ambisonic(m_ambisonic, m_mix.data());
+		}
+		mix_bus();
+
+		{
+			// Voice captures are converted inside mix_voice and count toward the mixer frame alone
+			StageTimer conversion(STAT_CONVERSION);
+			convert_to_int16(m_mix.data(), 1.0f, static_cast<int>(m_mix.size()), m_frame.data(), g_ditherEnabled.load(std::memory_order_relaxed) ? &m_dither : nullptr);
+		}
+		// Cleared before the last frame is published, so reading past the end isn't an underrun
+		m_playing = has_active_voice() || m_busRinging || !m_queued.empty();
+		if (!m_playing) {
+			m_clockRunning = false;
+		}
+		// One sound at a time is timed; a later one is only picked up once the reader has this one
+		if (first && !m_firstPending.load(std::memory_order_acquire)) {
+			m_firstPosted.store(posted.time_since_epoch().count(), std::memory_order_relaxed);
+			m_firstPosition.store(m_ring.write_position(), std::memory_order_relaxed);
+			m_firstPending.store(true, std::memory_order_release);
+		}
+		m_ring.write(m_frame.data(), m_frame.size());
+		stat_add(g_stats.framesRendered);
+		m_dataReady.signal();
+	}
+
+	IPLAudioSettings m_audioSettings{};
+	std::vector<std::unique_ptr<MixerVoice>> m_voices;
+	FixedQueue<MixerCommand> m_queued; // Render thread only
+	AlignedVector<float> m_mix;
+	AlignedVector<float> m_send; // Voices' reverb sends for this frame
+	RenderState m_bus;           // Only the reverb is used
+	float m_busDry = 0.0f;       // verblib's dry gain, applied on the direct path
+	ReverbTailGate m_busTail;
+	bool m_sending = false;      // A voice fed the bus this frame
+	bool m_busRinging = false;   // The bus still has a tail to play out
+	float m_busLevel = 1.0f;     // Fade envelope of the bus output while an interrupt fades its tail
+	float m_busStep = 0.0f;
+	AlignedVector<float> m_envelope; // One frame of the fade being applied
+	std::vector<int16_t> m_frame;
+	SpscRing<int16_t> m_ring;
+	Dither m_dither;
+	unsigned long long m_nextOrder = 0;
+	bool m_spatial = false;       // Voices have render states; until then sounds are panned. Render thread only
+	std::mutex m_spatialMutex;    // Guards the prepared states between prepare_spatial and the render thread
+	std::vector<RenderState> m_preparedStates;
+	AmbisonicBus m_preparedAmbisonic;
+	std::atomic<bool> m_spatialPrepared{ false }; // Tried once; a failure keeps panning rather than retrying every sound
+	std::atomic<bool> m_spatialPending{ false };  // m_preparedStates are ready to be taken up
+	int m_ambisonicOrder = 0;     // 0 when every voice has its own binaural effect
+	AmbisonicBus m_ambisonic;
+	bool m_clockRunning = false;  // Render thread only, like the clock itself
+	std::chrono::steady_clock::time_point m_clockStart;
+	long long m_clockFrames = 0;  // Mixed since m_clockStart
+
+#ifdef _WIN32
+	HANDLE m_mmcss = nullptr;     // Render thread only
+#endif
+
+	std::thread m_thread;
+	std::mutex m_mutex; // Guards m_commands
+	std::vector<MixerCommand> m_commands;
+	std::atomic<bool> m_commandsPosted{ false };
+	WakeEvent m_wake;   // Wakes the render thread
+	std::atomic<bool> m_quit{ false };
+	std::atomic<bool> m_proAudio{ true };
+	std::atomic<int> m_cpu{ -1 };
+	std::atomic<bool> m_schedulingChanged{ false };
+	SpscRing<RetiredVoice> m_retired; // From the render thread to the reader
+
+	WakeEvent m_dataReady; // Wakes the reader
+	std::atomic<bool> m_stopped{ false };
+	std::atomic<size_t> m_flushTo{ 0 };
+	std::atomic<bool> m_flushPending{ false };
+	std::atomic<bool> m_playing{ false }; // More frames are on their way, for underrun counting
+	std::atomic<long long> m_leadNs{ kDefaultMixerLeadMs * 1000000LL };
+	std::atomic<int> m_fadeInMs{ 0 };
+	std::atomic<int> m_fadeOutMs{ kDefaultMixerFadeOutMs };
+	std::atomic<int> m_groupVoices{ kDefaultMixerGroupVoices };
+	std::atomic<int> m_maxQueued{ kDefaultMixerMaxQueued };
+	std::atomic<int> m_coalesceMs{ kDefaultMixerCoalesceMs };
+	// Handed from the render thread to the reader while m_firstPending is set
+	std::atomic<size_t> m_firstPosition{ 0 };
+	std::atomic<long long> m_firstPosted{ 0 };
+	std::atomic<bool> m_firstPending{ false };
+};
+
+// Mixers borrow the global context and HRTF, so cleanup has to stop them first
+static std::mutex g_mixersMutex;
+static std::vector<Mixer*> g_mixers;
+
+static void stop_all_mixers()
+{
+	std::lock_guard<std::mutex> lock(g_mixersMutex);
+	for (auto* mixer : g_mixers) {
+		mixer->stop();
+	}
+	g_mixers.clear(); // Stopped for good; destroy_mixer still has to free them
+}
+
+// Can be called while initialize_steam_audio_async is still loading; sounds are panned until it finishes.
+// ambisonic_order 1 to 3 mixes voices through an ambisonic bus of that order, so the binaural cost
+// per frame doesn't grow with the number of voices; 0 gives every voice its own binaural effect.
+EXPORT Mixer* create_mixer(int max_voices, int ambisonic_order)
+{
+	int status = g_status.load(std::memory_order_acquire);
+	if ((status != STEAM_AUDIO_READY && status != STEAM_AUDIO_LOADING) || max_voices <= 0) {
+		return nullptr;
+	}
+
+	std::unique_ptr<Mixer> mixer(new Mixer);
+	if (!mixer->start(max_voices, ambisonic_order)) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(g_mixersMutex);
+	g_mixers.push_back(mixer.get());
+	return mixer.release();
+}
+
+EXPORT void destroy_mixer(Mixer* mixer)
+{
+	if (!mixer) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(g_mixersMutex);
+		g_mixers.erase(std::remove(g_mixers.begin(), g_mixers.end(), mixer), g_mixers.end());
+	}
+	delete mixer;
+}
+
+// Hand a play to the render thread once its sound is found
+static bool post_play(Mixer& mixer, MixerCommand& command)
+{
+	command.sound = find_sound(command.handle);
+	if (!command.sound) {
+		return false;
+	}
+	mixer.prepare_spatial();
+	mixer.prepare(command);
+	mixer.post(std::move(command));
+	return true;
+}
+
+// Start a registered sound. flags is a combination of MixerPlayFlags; without either flag the sound
+// starts immediately on top of whatever is playing.
+// reverb_send is the share of the sound sent to the mixer's reverb bus, from 0 (dry) to 1
+// group puts the sound under set_mixer_limits' per group voice limit, or none when negative. When
+// every voice is busy, the sound takes the voice of one with a lower priority, or of the oldest with
+// the same priority, and isn't played if every sound playing has a higher priority.
+EXPORT bool mixer_play(Mixer* mixer, int handle, float angle_x, float angle_y, float gain, float reverb_send, int flags, int group, int priority)
+{
+	if (!mixer) {
+		return false;
+	}
+
+	MixerCommand command;
+	command.handle = handle;
+	command.angleX = angle_x;
+	command.angleY = angle_y;
+	command.gain = gain;
+	command.send = reverb_send;
+	command.flags = flags;
+	command.group = group;
+	command.priority = priority;
+	return post_play(*mixer, command);
+}
+
+// Start a registered sound moving along keyframe_count keyframes, in time order, with its direction
+// interpolated every processing frame. The other arguments are mixer_play's.
+EXPORT bool mixer_play_path(Mixer* mixer, int handle, const DirectionKeyframe* keyframes, int keyframe_count, float gain, float reverb_send, int flags, int group, int priority)
+{
+	if (!mixer) {
+		return false;
+	}
+
+	MixerCommand command;
+	if (!command.path.assign(keyframes, keyframe_count)) {
+		return false;
+	}
+	command.handle = handle;
+	command.angleX = keyframes[0].angleX;
+	command.angleY = keyframes[0].angleY;
+	command.gain = gain;
+	command.send = reverb_send;
+	command.flags = flags;
+	command.group = group;
+	command.priority = priority;
+	return post_play(*mixer, command);
+}
+
+// Stop every playing and queued sound, fading out what is playing over the mixer's fade out time
+EXPORT void mixer_interrupt(Mixer* mixer)
+{
+	if (!mixer) {
+		return;
+	}
+
+	MixerCommand command;
+	command.flags = MIXER_PLAY_INTERRUPT;
+	mixer->post(std::move(command));
+}
+
+// How far ahead of real time the mixer renders, which is how late a sound started on top of others
+// can be. Less than a frame is rounded up to one; 0 renders as far ahead as the mixer buffers, for
+// output that isn't played in real time.
+EXPORT void set_mixer_lead(Mixer* mixer, int lead_ms)
+{
+	if (mixer) {
+		mixer->set_lead(lead_ms);
+	}
+}
+
+// Sounds started from now on fade in over fade_in_ms, 0 by default, and interrupted sounds fade out over
+// fade_out_ms, 5 by default. A fade out of 0 cuts them off and discards what is already mixed, which
+// mixer_read reports as interrupted for the output to drop what it has buffered too.
+EXPORT void set_mixer_fades(Mixer* mixer, int fade_in_ms, int fade_out_ms)
+{
+	if (mixer) {
+		mixer->set_fades(fade_in_ms, fade_out_ms);
+	}
+}
+
+// Bound the work a burst of plays can queue up. group_voices sounds of one group may play at once, 2
+// by default, before the oldest is faded out; max_queued queued sounds may wait, 8 by default, before
+// the oldest is dropped; 0 for no limit, though no more than 64 are ever kept waiting. A sound played
+// again within coalesce_ms of starting, 50 by default, carries on rather than starting twice.
+EXPORT void set_mixer_limits(Mixer* mixer, int group_voices, int max_queued, int coalesce_ms)
+{
+	if (mixer) {
+		mixer->set_limits(group_voices, max_queued, coalesce_ms);
+	}
+}
+
+// Run the mixer's render thread as an MMCSS Pro Audio task, as it does by default, and keep it to
+// one CPU unless cpu is -1. Only does anything on Windows.
+EXPORT void set_mixer_scheduling(Mixer* mixer, bool pro_audio, int cpu)
+{
+	if (mixer) {
+		mixer->set_scheduling(pro_audio, cpu);
+	}
+}
+
+EXPORT int mixer_read(Mixer* mixer, int16_t* output_buffer, int max_frames, int timeout_ms, bool* interrupted)
+{
+	if (!mixer || !output_buffer) {
+		return 0;
+	}
+	return mixer->read(output_buffer, max_frames, timeout_ms, interrupted);
+}
@@ -0,0 +1,527 @@
+// Native WASAPI outputs that play a mixer's ring straight to a device.
+
+#pragma once
+
+#include "mixer.h"
+
+// Plays a mixer's output without a round trip through Python for every buffer. Windows only.
+class DeviceOutput;
+
+#ifdef _WIN32
+// Holds one reference to a COM object
+template <typename T>
+class ComRef {
+public:
+	ComRef() = default;
+	ComRef(const ComRef&) = delete;
+	ComRef& operator=(const ComRef&) = delete;
+	~ComRef()
+	{
+		reset();
+	}
+
+	ComRef& operator=(ComRef&& other)
+	{
+		if (this != &other) {
+			reset();
+			m_ptr = other.m_ptr;
+			other.m_ptr = nullptr;
+		}
+		return *this;
+	}
+
+	T* get() const { return m_ptr; }
+	T* operator->() const { return m_ptr; }
+	explicit operator bool() const { return m_ptr != nullptr; }
+
+	// For functions that hand out a new reference
+	T** put()
+	{
+		reset();
+		return &m_ptr;
+	}
+	void** put_void() { return reinterpret_cast<void**>(put()); }
+
+	void reset()
+	{
+		if (m_ptr) {
+			m_ptr->Release();
+			m_ptr = nullptr;
+		}
+	}
+
+private:
+	T* m_ptr = nullptr;
+};
+
+// PKEY_Device_FriendlyName, spelled out so no GUIDs have to be defined in this file
+static const PROPERTYKEY kDeviceFriendlyName = { { 0xa45c254e, 0xdf1c, 0x4efd, { 0x80, 0x20, 0x67, 0xd1, 0x46, 0xa8, 0x50, 0xe0 } }, 14 };
+// How long the output thread waits for the device before checking whether it should stop
+static const DWORD kOutputWaitMs = 200;
+// How often a device that has gone away is tried again, which also picks up a new default device
+static const DWORD kOutputRetryMs = 1000;
+
+// Plays a mixer through a shared mode, event driven WASAPI stream on its own Pro Audio thread. The
+// stream runs at the device's mix format, converted by Windows only when its rate isn't the mixer's,
+// with the smallest period the engine allows at or above the one asked for. Every period is taken
+// straight from the mixer's ring and the mixer is kept just that far ahead, so a sound is heard about a
+// device period and a mixer frame after it is played.
+class DeviceOutput {
+public:
+	~DeviceOutput()
+	{
+		stop();
+	}
+
+	// False when the device can't be opened, leaving nothing running. device is the name or endpoint ID
+	// NVDA's outputDevice setting holds. period_ms 0 asks for the shortest period the engine offers.
+	bool start(Mixer* mixer, const wchar_t* device, int periodMs)
+	{
+		m_mixer = mixer;
+		m_device = device ? device : L"";
+		m_periodMs = std::max(periodMs, 0);
+		m_event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+		if (!m_event) {
+			return false;
+		}
+
+		// The stream belongs to the thread's COM apartment, so it is opened there
+		m_thread = std::thread(&DeviceOutput::run, this);
+		bool opened;
+		int leadMs = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_startedCondition.wait(lock, [this] { return m_started; });
+			opened = m_opened;
+			if (opened) {
+				leadMs = static_cast<int>((1000LL * m_streamPeriod + m_sampleRate - 1) / m_sampleRate);
+			}
+		}
+		if (!opened) {
+			stop();
+			return false;
+		}
+
+		// Mixing further ahead than the device would only delay sounds played on top of others
+		m_mixer->set_lead(leadMs);
+		return true;
+	}
+
+	void stop()
+	{
+		m_quit.store(true, std::memory_order_release);
+		if (m_event) {
+			SetEvent(m_event);
+		}
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+		if (m_event) {
+			CloseHandle(m_event);
+			m_event = nullptr;
+		}
+	}
+
+	const Mixer* mixer() const
+	{
+		return m_mixer;
+	}
+
+	void get_format(int* sampleRate, int* channels, int* periodFrames)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (sampleRate) {
+			*sampleRate = static_cast<int>(m_sampleRate);
+		}
+		if (channels) {
+			*channels = m_channels;
+		}
+		if (periodFrames) {
+			*periodFrames = static_cast<int>(m_streamPeriod);
+		}
+	}
+
+private:
+	enum SampleType { SAMPLE_FLOAT32, SAMPLE_INT16, SAMPLE_INT32 };
+
+	void run()
+	{
+		bool com = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+		bool opened = com && open();
+		if (!opened) {
+			close();
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_started = true;
+			m_opened = opened;
+		}
+		m_startedCondition.notify_all();
+
+		if (opened) {
+			DWORD taskIndex = 0;
+			HANDLE mmcss = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+			while (!m_quit.load(std::memory_order_acquire)) {
+				if (pump()) {
+					continue;
+				}
+				// Unplugged, disabled or reformatted: open the device again once it is back
+				close();
+				while (!m_quit.load(std::memory_order_acquire) && !open()) {
+					close();
+					WaitForSingleObject(m_event, kOutputRetryMs);
+				}
+			}
+			if (mmcss) {
+				AvRevertMmThreadCharacteristics(mmcss);
+			}
+		}
+
+		close();
+		if (com) {
+			CoUninitialize();
+		}
+	}
+
+	bool open()
+	{
+		ComRef<IMMDeviceEnumerator> enumerator;
+		ComRef<IMMDevice> device;
+		if (FAILED(CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, __uuidof(IMMDeviceEnumerator), enumerator.put_void()))
+			|| !find_device(enumerator.get(), device)
+			|| FAILED(device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, m_client.put_void()))) {
+			return false;
+		}
+
+		WAVEFORMATEX* mixFormat = nullptr;
+		if (FAILED(m_client->GetMixFormat(&mixFormat))) {
+			return false;
+		}
+		bool usable = set_format(mixFormat);
+		CoTaskMemFree(mixFormat);
+		auto* format = reinterpret_cast<WAVEFORMATEX*>(m_format.data());
+
+		UINT32 bufferFrames = 0;
+		if (!usable || !initialize(format)
+			|| FAILED(m_client->GetBufferSize(&bufferFrames))
+			|| FAILED(m_client->GetService(__uuidof(IAudioRenderClient), m_render.put_void()))
+			|| FAILED(m_client->SetEventHandle(m_event))) {
+			return false;
+		}
+		m_bufferFrames = bufferFrames;
+		m_periodFrames = std::min(std::max<UINT32>(m_periodFrames, 1), bufferFrames);
+		m_pcm.assign(2 * static_cast<size_t>(bufferFrames), 0);
+
+		// Start on a period of silence, so the first period mixed doesn't have to arrive in time for the
+		// engine's very first pass
+		BYTE* data = nullptr;
+		if (FAILED(m_render->GetBuffer(m_periodFrames, &data)) || FAILED(m_render->ReleaseBuffer(m_periodFrames, AUDCLNT_BUFFERFLAGS_SILENT))
+			|| FAILED(m_client->Start())) {
+			return false;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_sampleRate = format->nSamplesPerSec;
+			m_channels = format->nChannels;
+			m_streamPeriod = m_periodFrames;
+		}
+		m_running = true;
+		stat_add(g_stats.deviceOutputs);
+		return true;
+	}
+
+	void close()
+	{
+		if (m_running) {
+			m_client->Stop();
+			m_running = false;
+			stat_add(g_stats.deviceOutputs, -1);
+		}
+		m_render.reset();
+		m_client.reset();
+	}
+
+	// NVDA names the output device by its endpoint ID, or in older versions by its friendly name as
+	// winmm reports it, cut to 31 characters. "default", "Microsoft Sound Mapper" and no name at all
+	// mean the default device.
+	bool find_device(IMMDeviceEnumerator* enumerator, ComRef<IMMDevice>& device)
+	{
+		if (m_device.empty() || m_device == L"default" || m_device == L"Microsoft Sound Mapper") {
+			return SUCCEEDED(enumerator->GetDefaultAudioEndpoint(eRender, eConsole, device.put()));
+		}
+		if (SUCCEEDED(enumerator->GetDevice(m_device.c_str(), device.put()))) {
+			return true;
+		}
+
+		ComRef<IMMDeviceCollection> devices;
+		UINT count = 0;
+		if (FAILED(enumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, devices.put())) || FAILED(devices->GetCount(&count))) {
+			return false;
+		}
+		for (UINT i = 0; i < count; ++i) {
+			ComRef<IMMDevice> candidate;
+			ComRef<IPropertyStore> properties;
+			if (FAILED(devices->Item(i, candidate.put())) || FAILED(candidate->OpenPropertyStore(STGM_READ, properties.put()))) {
+				continue;
+			}
+			PROPVARIANT name;
+			PropVariantInit(&name);
+			bool matches = SUCCEEDED(properties->GetValue(kDeviceFriendlyName, &name)) && name.vt == VT_LPWSTR && name.pwszVal
+				&& (m_device == name.pwszVal || (m_device.size() == 31 && wcsncmp(name.pwszVal, m_device.c_str(), 31) == 0));
+			PropVariantClear(&name);
+			if (matches) {
+				device = std::move(candidate);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Take the device's mix format, marking it for conversion from the mixer's rate if that differs.
+	// False for sample types the output can't write.
+	bool set_format(const WAVEFORMATEX* mixFormat)
+	{
+		auto bytes = reinterpret_cast<const BYTE*>(mixFormat);
+		m_format.assign(bytes, bytes + sizeof(WAVEFORMATEX) + mixFormat->cbSize);
+		auto* format = reinterpret_cast<WAVEFORMATEX*>(m_format.data());
+
+		// Extensible sub formats are the plain format tags inside a common base GUID
+		DWORD tag = format->wFormatTag;
+		if (tag == WAVE_FORMAT_EXTENSIBLE && format->cbSize >= sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX)) {
+			tag = reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(format)->SubFormat.Data1;
+		}
+		if (tag == WAVE_FORMAT_IEEE_FLOAT && format->wBitsPerSample == 32) {
+			m_sampleType = SAMPLE_FLOAT32;
+		} else if (tag == WAVE_FORMAT_PCM && format->wBitsPerSample == 16) {
+			m_sampleType = SAMPLE_INT16;
+		} else if (tag == WAVE_FORMAT_PCM && format->wBitsPerSample == 32) {
+			m_sampleType = SAMPLE_INT32;
+		} else {
+			return false;
+		}
+
+		int rate = m_mixer->sample_rate();
+		m_convert = static_cast<int>(format->nSamplesPerSec) != rate;
+		if (m_convert) {
+			format->nSamplesPerSec = rate;
+			format->nAvgBytesPerSec = rate * format->nBlockAlign;
+		}
+		return format->nChannels > 0;
+	}
+
+	bool initialize(const WAVEFORMATEX* format)
+	{
+		DWORD flags = AUDCLNT_STREAMFLAGS_EVENTCALLBACK;
+		if (!m_convert) {
+			// Since Windows 10 shared streams can run at periods below the engine's default 10 ms
+			ComRef<IAudioClient3> client3;
+			UINT32 defaultFrames = 0, fundamentalFrames = 0, minFrames = 0, maxFrames = 0;
+			if (SUCCEEDED(m_client->QueryInterface(__uuidof(IAudioClient3), client3.put_void()))
+				&& SUCCEEDED(client3->GetSharedModeEnginePeriod(format, &defaultFrames, &fundamentalFrames, &minFrames, &maxFrames))) {
+				fundamentalFrames = std::max<UINT32>(fundamentalFrames, 1);
+				UINT32 wanted = static_cast<UINT32>(static_cast<long long>(m_periodMs) * format->nSamplesPerSec / 1000);
+				UINT32 frames = (wanted + fundamentalFrames - 1) / fundamentalFrames * fundamentalFrames;
+				frames = std::min(std::max(frames, minFrames), maxFrames);
+				if (SUCCEEDED(client3->InitializeSharedAudioStream(flags, frames, format, nullptr))) {
+					m_periodFrames = frames;
+					return true;
+				}
+			}
+		} else {
+			flags |= AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY;
+		}
+
+		REFERENCE_TIME defaultPeriod = 0;
+		if (FAILED(m_client->GetDevicePeriod(&defaultPeriod, nullptr))
+			|| FAILED(m_client->Initialize(AUDCLNT_SHAREMODE_SHARED, flags, 0, 0, format, nullptr))) {
+			return false;
+		}
+		m_periodFrames = static_cast<UINT32>(defaultPeriod * format->nSamplesPerSec / 10000000);
+		return true;
+	}
+
+	// Wait for the engine to take a period, then queue the next one from the mixer. False once the
+	// stream has to be opened again.
+	bool pump()
+	{
+		if (WaitForSingleObject(m_event, kOutputWaitMs) != WAIT_OBJECT_0 || m_quit.load(std::memory_order_acquire)) {
+			return true;
+		}
+
+		UINT32 padding = 0;
+		if (FAILED(m_client->GetCurrentPadding(&padding))) {
+			return false;
+		}
+		if (padding >= m_periodFrames) {
+			return true;
+		}
+		UINT32 frames = m_periodFrames - padding;
+
+		bool interrupted = false;
+		int mixed = m_mixer->read(m_pcm.data(), static_cast<int>(frames), 0, &interrupted);
+		bool restart = false;
+		if (interrupted && padding > 0) {
+			// Drop what the interrupted sounds still have queued in the stream, and fill its place
+			m_client->Stop();
+			m_client->Reset();
+			restart = true;
+			frames = m_periodFrames;
+			mixed += m_mixer->read(m_pcm.data() + 2 * mixed, static_cast<int>(frames) - mixed, 0, nullptr);
+		}
+
+		BYTE* data = nullptr;
+		if (FAILED(m_render->GetBuffer(frames, &data))) {
+			return false;
+		}
+		write_frames(data, mixed, frames);
+		if (FAILED(m_render->ReleaseBuffer(frames, mixed > 0 ? 0 : AUDCLNT_BUFFERFLAGS_SILENT))) {
+			return false;
+		}
+		return !restart || SUCCEEDED(m_client->Start());
+	}
+
+	// Lay the first mixed stereo frames out in the device's format, silence after them. Left and right
+	// go to the first two channels, or are averaged for a mono device; any others stay silent.
+	void write_frames(BYTE* data, int mixed, UINT32 frames)
+	{
+		auto* format = reinterpret_cast<const WAVEFORMATEX*>(m_format.data());
+		int channels = format->nChannels;
+		std::memset(data, 0, static_cast<size_t>(frames) * format->nBlockAlign);
+		for (int i = 0; i < mixed; ++i) {
+			int left = m_pcm[2 * i];
+			int right = m_pcm[2 * i + 1];
+			int first = channels == 1 ? (left + right) / 2 : left;
+			switch (m_sampleType) {
+			case SAMPLE_FLOAT32: {
+				float* out = reinterpret_cast<float*>(data) + static_cast<size_t>(i) * channels;
+				out[0] = first * (1.0f / 32768.0f);
+				if (channels > 1) {
+					out[1] = right * (1.0f / 32768.0f);
+				}
+				break;
+			}
+			case SAMPLE_INT16: {
+				int16_t* out = reinterpret_cast<int16_t*>(data) + static_cast<size_t>(i) * channels;
+				out[0] = static_cast<int16_t>(first);
+				if (channels > 1) {
+					out[1] = static_cast<int16_t>(right);
+				}
+				break;
+			}
+			case SAMPLE_INT32: {
+				int32_t* out = reinterpret_cast<int32_t*>(data) + static_cast<size_t>(i) * channels;
+				out[0] = static_cast<int32_t>(static_cast<uint32_t>(first) << 16);
+				if (channels > 1) {
+					out[1] = static_cast<int32_t>(static_cast<uint32_t>(right) << 16);
+				}
+				break;
+			}
+			}
+		}
+	}
+
+	Mixer* m_mixer = nullptr;
+	std::wstring m_device;
+	int m_periodMs = 0;
+	HANDLE m_event = nullptr;
+	std::thread m_thread;
+	std::atomic<bool> m_quit{ false };
+
+	std::mutex m_mutex;
+	std::condition_variable m_startedCondition;
+	bool m_started = false; // The thread has tried to open the device
+	bool m_opened = false;
+	DWORD m_sampleRate = 0;   // Of the stream as last opened, for get_format
+	int m_channels = 0;
+	UINT32 m_streamPeriod = 0;
+
+	// Output thread only once open() has first succeeded
+	ComRef<IAudioClient> m_client;
+	ComRef<IAudioRenderClient> m_render;
+	std::vector<BYTE> m_format; // The stream's WAVEFORMATEX, with whatever extension follows it
+	SampleType m_sampleType = SAMPLE_FLOAT32;
+	bool m_convert = false;     // Windows converts from the mixer's rate
+	bool m_running = false;
+	UINT32 m_bufferFrames = 0;
+	UINT32 m_periodFrames = 0;
+	std::vector<int16_t> m_pcm; // A period read from the mixer
+};
+
+// Outputs read their mixer's ring, so a mixer stops its outputs before it stops itself
+static std::mutex g_outputsMutex;
+static std::vector<DeviceOutput*> g_outputs;
+#endif
+
+static void stop_outputs(const Mixer* mixer)
+{
+#ifdef _WIN32
+	std::lock_guard<std::mutex> lock(g_outputsMutex);
+	for (auto* output : g_outputs) {
+		if (output->mixer() == mixer) {
+			output->stop();
+		}
+	}
+#else
+	(void)mixer;
+#endif
+}
+
+// Play a mixer straight to an output device from a native thread, instead of reading it with mixer_read.
+// device_name is NVDA's outputDevice setting; period_ms 0 takes the shortest period the audio engine
+// offers. Returns nullptr when there is no native output, so the caller has to feed its own player, and
+// on anything but Windows. An output stops for good when its mixer is destroyed or cleanup_steam_audio runs,
+// but still has to be destroyed.
+EXPORT DeviceOutput* create_output(Mixer* mixer, const wchar_t* device_name, int period_ms)
+{
+#ifdef _WIN32
+	if (!mixer) {
+		return nullptr;
+	}
+
+	std::unique_ptr<DeviceOutput> output(new DeviceOutput);
+	if (!output->start(mixer, device_name, period_ms)) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(g_outputsMutex);
+	g_outputs.push_back(output.get());
+	return output.release();
+#else
+	(void)mixer;
+	(void)device_name;
+	(void)period_ms;
+	return nullptr;
+#endif
+}
+
+EXPORT void destroy_output(DeviceOutput* output)
+{
+#ifdef _WIN32
+	if (!output) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(g_outputsMutex);
+		g_outputs.erase(std::remove(g_outputs.begin(), g_outputs.end(), output), g_outputs.end());
+	}
+	delete output;
+#else
+	(void)output;
+#endif
+}
+
+// The stream's rate, channel count and period in sample frames
+EXPORT void get_output_format(DeviceOutput* output, int* sample_rate, int* channels, int* period_frames)
+{
+#ifdef _WIN32
+	if (output) {
+		output->get_format(sample_rate, channels, period_frames);
+	}
+#else
+	(void)output;
+	(void)sample_rate;
+	(void)channels;
+	(void)period_frames;
+#endif
+}
@@ -0,0 +1,197 @@
+// LRU cache of finished renders, keyed by sound, quantised direction and settings, and its exports.
+
+#pragma once
+
+#include "common.h"
+
+// Key for a finished render: the sound, its quantised direction and everything else that changes the output
+struct CacheKey {
+	int sound;
+	int samplingRate;
+	int frameSize;
+	int bucketX;
+	int bucketY;
+	int gain;                  // Gain in 1/1024 steps
+	bool reverb;
+	unsigned reverbGeneration; // Bumped whenever the reverb settings change
+
+	bool operator==(const CacheKey& other) const
+	{
+		return sound == other.sound && samplingRate == other.samplingRate && frameSize == other.frameSize && bucketX == other.bucketX && bucketY == other.bucketY && gain == other.gain && reverb == other.reverb && reverbGeneration == other.reverbGeneration;
+	}
+};
+
+struct CacheKeyHash {
+	size_t operator()(const CacheKey& key) const
+	{
+		size_t h = static_cast<size_t>(key.sound);
+		h = h * 31 + static_cast<size_t>(key.samplingRate);
+		h = h * 31 + static_cast<size_t>(key.frameSize);
+		h = h * 31 + static_cast<size_t>(key.bucketX);
+		h = h * 31 + static_cast<size_t>(key.bucketY);
+		h = h * 31 + static_cast<size_t>(key.gain);
+		h = h * 31 + static_cast<size_t>(key.reverbGeneration) * 2 + (key.reverb ? 1 : 0);
+		return h;
+	}
+};
+
+using CachedPcm = std::shared_ptr<const std::vector<int16_t>>;
+
+// LRU cache of finished stereo 16-bit renders, bounded by a byte budget
+class OutputCache {
+public:
+	void configure(size_t maxBytes, float angleStep)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_maxBytes = maxBytes;
+		if (m_angleStep.exchange(angleStep) != angleStep) {
+			clear_locked(); // Entries are keyed by bucket index, which means another direction under the new step
+		}
+		evict_locked();
+	}
+
+	bool enabled() const
+	{
+		return m_maxBytes > 0 && m_angleStep > 0.0f;
+	}
+
+	int bucket(float angle) const
+	{
+		return static_cast<int>(std::lround(angle / m_angleStep));
+	}
+
+	float bucket_centre(int bucket) const
+	{
+		return bucket * m_angleStep;
+	}
+
+	CachedPcm find(const CacheKey& key)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_index.find(key);
+		if (it == m_index.end()) {
+			m_misses++;
+			return nullptr;
+		}
+		m_entries.splice(m_entries.begin(), m_entries, it->second); // Mark as most recently used
+		m_hits++;
+		return it->second->pcm;
+	}
+
+	void insert(const CacheKey& key, CachedPcm pcm)
+	{
+		size_t bytes = pcm->size() * sizeof(int16_t);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (bytes > m_maxBytes || m_index.count(key)) {
+			return;
+		}
+		m_entries.push_front(Entry{ key, std::move(pcm) });
+		m_index.emplace(key, m_entries.begin());
+		m_bytes += bytes;
+		evict_locked();
+	}
+
+	// Lookups that shouldn't count as hits or misses or refresh the entry
+	bool contains(const CacheKey& key)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_index.count(key) != 0;
+	}
+
+	// Whether bytes more fit without evicting anything
+	bool has_room(size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_bytes + bytes <= m_maxBytes;
+	}
+
+	// Drop every render of a sound, e.g. when its handle is released
+	void remove_sound(int sound)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto it = m_entries.begin(); it != m_entries.end();) {
+			if (it->key.sound == sound) {
+				it = erase_locked(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		clear_locked();
+	}
+
+	void stats(long long* hits, long long* misses, int* entries, long long* bytes)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (hits) *hits = m_hits;
+		if (misses) *misses = m_misses;
+		if (entries) *entries = static_cast<int>(m_index.size());
+		if (bytes) *bytes = static_cast<long long>(m_bytes);
+	}
+
+	void reset_stats()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_hits = 0;
+		m_misses = 0;
+	}
+
+private:
+	struct Entry {
+		CacheKey key;
+		CachedPcm pcm;
+	};
+
+	std::list<Entry>::iterator erase_locked(std::list<Entry>::iterator it)
+	{
+		m_bytes -= it->pcm->size() * sizeof(int16_t);
+		m_index.erase(it->key);
+		return m_entries.erase(it);
+	}
+
+	void clear_locked()
+	{
+		m_entries.clear();
+		m_index.clear();
+		m_bytes = 0;
+	}
+
+	void evict_locked()
+	{
+		while (m_bytes > m_maxBytes && !m_entries.empty()) {
+			erase_locked(std::prev(m_entries.end()));
+		}
+	}
+
+	std::mutex m_mutex;
+	std::list<Entry> m_entries; // Most recently used first
+	std::unordered_map<CacheKey, std::list<Entry>::iterator, CacheKeyHash> m_index;
+	size_t m_bytes = 0;
+	std::atomic<size_t> m_maxBytes{ 8 * 1024 * 1024 };
+	std::atomic<float> m_angleStep{ 1.0f };
+	long long m_hits = 0;
+	long long m_misses = 0;
+};
+
+static OutputCache g_outputCache;
+
+// Limit the memory used by cached renders and set the direction bucket size (0 disables caching)
+EXPORT void set_output_cache_settings(int max_bytes, float angle_step)
+{
+	g_outputCache.configure(static_cast<size_t>(std::max(0, max_bytes)), angle_step);
+}
+
+EXPORT void get_output_cache_stats(long long* hits, long long* misses, int* entries, long long* bytes)
+{
+	g_outputCache.stats(hits, misses, entries, bytes);
+}
+
+EXPORT void clear_output_cache()
+{
+	g_outputCache.clear();
+	g_outputCache.reset_stats();
+}
@@ -0,0 +1,211 @@
+// Lock-free ring, wake event and fixed-size queue the mixer's render thread uses so it never waits
+// on a posting thread or allocates.
+
+#pragma once
+
+#include "common.h"
+
+// Lock-free ring of samples with exactly one producer thread and one consumer thread.
+// Positions only ever increase; the capacity is a power of two so they can wrap freely.
+template <typename T>
+class SpscRing {
+public:
+	void allocate(size_t minCapacity)
+	{
+		size_t capacity = 1;
+		while (capacity < minCapacity) {
+			capacity <<= 1;
+		}
+		m_buffer.assign(capacity, T());
+		m_mask = capacity - 1;
+		m_read = 0;
+		m_write = 0;
+	}
+
+	size_t capacity() const { return m_buffer.size(); }
+
+	// Consumer side
+	size_t read_available() const { return m_write.load(std::memory_order_acquire) - m_read.load(std::memory_order_relaxed); }
+
+	// Consumer side
+	size_t read_position() const { return m_read.load(std::memory_order_relaxed); }
+
+	// Producer side
+	size_t write_available() const { return capacity() - (m_write.load(std::memory_order_relaxed) - m_read.load(std::memory_order_acquire)); }
+
+	// Producer side
+	size_t write_position() const { return m_write.load(std::memory_order_relaxed); }
+
+	// Producer side
+	size_t write(const T* data, size_t count)
+	{
+		size_t write = m_write.load(std::memory_order_relaxed);
+		count = std::min(count, write_available());
+		for (size_t i = 0; i < count; ++i) {
+			m_buffer[(write + i) & m_mask] = data[i];
+		}
+		m_write.store(write + count, std::memory_order_release);
+		return count;
+	}
+
+	// Consumer side
+	size_t read(T* data, size_t count)
+	{
+		size_t read = m_read.load(std::memory_order_relaxed);
+		count = std::min(count, read_available());
+		for (size_t i = 0; i < count; ++i) {
+			data[i] = m_buffer[(read + i) & m_mask];
+		}
+		m_read.store(read + count, std::memory_order_release);
+		return count;
+	}
+
+	// Producer side: move one item in, if there is room for it
+	bool push(T&& item)
+	{
+		size_t write = m_write.load(std::memory_order_relaxed);
+		if (write_available() == 0) {
+			return false;
+		}
+		m_buffer[write & m_mask] = std::move(item);
+		m_write.store(write + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side: move one item out, leaving nothing behind in its slot
+	bool pop(T& item)
+	{
+		size_t read = m_read.load(std::memory_order_relaxed);
+		if (read_available() == 0) {
+			return false;
+		}
+		item = std::move(m_buffer[read & m_mask]);
+		m_buffer[read & m_mask] = T();
+		m_read.store(read + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side: drop everything before position. Returns false if the consumer is already past it.
+	bool skip_to(size_t position)
+	{
+		size_t read = m_read.load(std::memory_order_relaxed);
+		if (static_cast<std::ptrdiff_t>(position - read) < 0) {
+			return false;
+		}
+		m_read.store(position, std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::vector<T> m_buffer;
+	size_t m_mask = 0;
+	std::atomic<size_t> m_read{ 0 };
+	std::atomic<size_t> m_write{ 0 };
+};
+
+// Wakes a waiting thread. On Windows neither side takes a lock, so the render thread never blocks
+// behind a thread that signals it; elsewhere it falls back to a mutex and condition variable. A
+// signal with nobody waiting wakes the next wait straight away.
+class WakeEvent {
+public:
+#ifdef _WIN32
+	WakeEvent() : m_event(CreateEventW(nullptr, FALSE, FALSE, nullptr)) {}
+	~WakeEvent()
+	{
+		if (m_event) {
+			CloseHandle(m_event);
+		}
+	}
+	WakeEvent(const WakeEvent&) = delete;
+	WakeEvent& operator=(const WakeEvent&) = delete;
+
+	void signal()
+	{
+		SetEvent(m_event);
+	}
+
+	// Wait for a signal, or until deadline if it isn't time_point::max()
+	void wait_until(std::chrono::steady_clock::time_point deadline)
+	{
+		DWORD timeout = INFINITE;
+		if (deadline != std::chrono::steady_clock::time_point::max()) {
+			// Rounded up by hand (std::chrono::ceil needs C++17), so the wait never wakes before it is due
+			auto remaining = deadline - std::chrono::steady_clock::now();
+			auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(remaining);
+			if (ms < remaining) {
+				++ms;
+			}
+			timeout = static_cast<DWORD>(std::max<long long>(ms.count(), 0));
+		}
+		WaitForSingleObject(m_event, timeout);
+	}
+
+private:
+	HANDLE m_event;
+#else
+	void signal()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_signalled = true;
+		}
+		m_condition.notify_one();
+	}
+
+	void wait_until(std::chrono::steady_clock::time_point deadline)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (deadline == std::chrono::steady_clock::time_point::max()) {
+			m_condition.wait(lock, [this] { return m_signalled; });
+		} else {
+			m_condition.wait_until(lock, deadline, [this] { return m_signalled; });
+		}
+		m_signalled = false;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_signalled = false;
+#endif
+};
+
+// First in, first out with a fixed capacity, so it never allocates once constructed
+template <typename T>
+class FixedQueue {
+public:
+	explicit FixedQueue(size_t capacity) : m_items(capacity) {}
+
+	bool empty() const { return m_count == 0; }
+	bool full() const { return m_count == m_items.size(); }
+	size_t size() const { return m_count; }
+	size_t capacity() const { return m_items.size(); }
+
+	// i counts from the front
+	const T& operator[](size_t i) const { return m_items[(m_head + i) % m_items.size()]; }
+
+	// Fails when full
+	bool push_back(T&& item)
+	{
+		if (full()) {
+			return false;
+		}
+		m_items[(m_head + m_count) % m_items.size()] = std::move(item);
+		m_count++;
+		return true;
+	}
+
+	T pop_front()
+	{
+		T item = std::move(m_items[m_head]);
+		m_items[m_head] = T();
+		m_head = (m_head + 1) % m_items.size();
+		m_count--;
+		return item;
+	}
+
+private:
+	std::vector<T> m_items;
+	size_t m_head = 0;
+	size_t m_count = 0;
+};
@@ -0,0 +1,639 @@
+// Direction, path and reverb tail helpers and the render loops behind the processing exports.
+
+#pragma once
+
+#include "engine.h"
+
+// Treat input as Cartesian coordinates (x, y) on kSoundPlane, and return the normalized direction to
+// that point in the listener's frame
+static IPLVector3 make_direction(float angle_x, float angle_y)
+{
+	IPLVector3 direction;
+	direction.x = angle_x * kListenerRight.x + angle_y * kListenerUp.x + kSoundPlane.x;
+	direction.y = angle_x * kListenerRight.y + angle_y * kListenerUp.y + kSoundPlane.y;
+	direction.z = angle_x * kListenerRight.z + angle_y * kListenerUp.z + kSoundPlane.z;
+
+	// Never zero, as the plane is one unit away
+	float length = sqrtf(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+	direction.x /= length;
+	direction.y /= length;
+	direction.z /= length;
+	return direction;
+}
+
+// Maximum number of processing frames appended for the decay tail. Rendering usually stops
+// earlier, once ReverbTailGate finds the tail has become inaudible.
+static int reverb_tail_frames(const RenderState& state)
+{
+	auto framesize = state.audioSettings.frameSize;
+	unsigned long tail_frames = verblib_get_decay_time_in_frames(state.reverb.get());
+	// Convert sample frames to processing frames
+	return static_cast<int>((tail_frames + framesize - 1) / framesize);
+}
+
+// Linear level of verblib_silence_threshold (dB below full scale)
+static const float kReverbSilenceLevel = static_cast<float>(std::pow(10.0, -verblib_silence_threshold / 20.0));
+
+// Whether count interleaved samples, scaled by gain, have an RMS level below the silence threshold
+static bool is_silent(const float* samples, int count, float gain)
+{
+	float energy = 0.0f;
+	for (int j = 0; j < count; ++j) {
+		energy += samples[j] * samples[j];
+	}
+	return energy * gain * gain < kReverbSilenceLevel * kReverbSilenceLevel * count;
+}
+
+// Feed every rendered tail frame through update(); it returns true once the tail has been quiet long
+// enough that the remaining frames can be dropped
+struct ReverbTailGate {
+	int quietFrames = 0;
+
+	bool update(const RenderState& state, const float* frame, float gain)
+	{
+		auto framesize = state.audioSettings.frameSize;
+		if (is_silent(frame, 2 * framesize, gain)) {
+			quietFrames += framesize;
+		} else {
+			quietFrames = 0;
+		}
+		return quietFrames >= state.reverbSilenceWindow;
+	}
+};
+
+// Set by set_hrtf_interpolation
+static std::atomic<bool> g_hrtfBilinear{ false };
+
+static IPLBinauralEffectParams make_binaural_params(const RenderState& state, float angle_x, float angle_y)
+{
+	IPLBinauralEffectParams params;
+	params.direction = make_direction(angle_x, angle_y);
+	params.interpolation = g_hrtfBilinear.load(std::memory_order_relaxed) ? IPL_HRTFINTERPOLATION_BILINEAR : IPL_HRTFINTERPOLATION_NEAREST;
+	params.spatialBlend = 1.0f;
+	params.hrtf = state.hrtf;
+	params.peakDelays = nullptr;
+	return params;
+}
+
+// A direction a moving sound passes through, time seconds after it starts. Plain floats only, so ctypes
+// can mirror the layout.
+struct DirectionKeyframe {
+	float time;
+	float angleX;
+	float angleY;
+};
+
+// Most keyframes a moving sound's path can have
+static const int kMaxDirectionKeyframes = 16;
+
+// Where a moving sound is over time: on a straight line between keyframes, at the first one before it
+// and at the last one after. Fixed size, so a mixer voice carries one without allocating.
+struct DirectionPath {
+	DirectionKeyframe keys[kMaxDirectionKeyframes] = {};
+	int count = 0; // 0 for a sound that stays put
+
+	// False when there are no keyframes, too many, or they aren't in time order
+	bool assign(const DirectionKeyframe* keyframes, int keyframe_count)
+	{
+		if (!keyframes || keyframe_count < 1 || keyframe_count > kMaxDirectionKeyframes) {
+			return false;
+		}
+		for (int i = 0; i < keyframe_count; ++i) {
+			if (!std::isfinite(keyframes[i].time) || (i > 0 && keyframes[i].time < keyframes[i - 1].time)) {
+				return false;
+			}
+		}
+		std::copy(keyframes, keyframes + keyframe_count, keys);
+		count = keyframe_count;
+		return true;
+	}
+
+	bool empty() const { return count == 0; }
+
+	void angles_at(float seconds, float& angle_x, float& angle_y) const
+	{
+		int next = 0;
+		while (next < count && keys[next].time <= seconds) {
+			next++;
+		}
+		if (next == 0 || next == count) {
+			const DirectionKeyframe& key = keys[next == 0 ? 0 : count - 1];
+			angle_x = key.angleX;
+			angle_y = key.angleY;
+			return;
+		}
+		const DirectionKeyframe& from = keys[next - 1];
+		const DirectionKeyframe& to = keys[next];
+		float t = (seconds - from.time) / (to.time - from.time);
+		angle_x = from.angleX + (to.angleX - from.angleX) * t;
+		angle_y = from.angleY + (to.angleY - from.angleY) * t;
+	}
+};
+
+// Point params at where a moving sound is in the middle of processing frame `frame`. While the sound moves during the frame the HRTF is interpolated bilinearly,
+// so it glides between the measured directions instead of stepping from one to the next; while it
+// holds still set_hrtf_interpolation's choice applies.
+static void follow_path(const IPLAudioSettings& settings, const DirectionPath& path, int frame, IPLBinauralEffectParams& params)
+{
+	float frameSeconds = static_cast<float>(settings.frameSize) / settings.samplingRate;
+	float start = frame * frameSeconds;
+	float startX, startY, endX, endY, angleX, angleY;
+	path.angles_at(start, startX, startY);
+	path.angles_at(start + frameSeconds, endX, endY);
+	path.angles_at(start + 0.5f * frameSeconds, angleX, angleY);
+
+	bool moving = startX != endX || startY != endY;
+	params.direction = make_direction(angleX, angleY);
+	params.interpolation = moving || g_hrtfBilinear.load(std::memory_order_relaxed) ? IPL_HRTFINTERPOLATION_BILINEAR : IPL_HRTFINTERPOLATION_NEAREST;
+}
+
+// Binaural pass for processing frame `frame` of a mono sound, leaving deinterleaved stereo in state.outBuffer.
+// frame must start inside the input.
+static void spatialize_frame(RenderState& state, const float* input_buffer, int input_length, int frame, IPLBinauralEffectParams& params)
+{
+	auto framesize = state.audioSettings.frameSize;
+	int offset = frame * framesize;
+
+	// The last frame may be partial, so pad it through the scratch frame
+	const float* frameIn = input_buffer + offset;
+	int remaining = input_length - offset;
+	if (remaining < framesize) {
+		std::copy(frameIn, frameIn + remaining, state.inputframe.begin());
+		std::fill(state.inputframe.begin() + remaining, state.inputframe.end(), 0.0f);
+		frameIn = state.inputframe.data();
+	}
+
+	float* frameData[] = { const_cast<float*>(frameIn) };
+	IPLAudioBuffer inBuffer{ 1, framesize, frameData };
+
+	// Apply only reports whether the effect still has a tail to play out, and the output is filled either way
+	iplBinauralEffectApply(state.effect, &params, &inBuffer, &state.outBuffer);
+}
+
+// Render processing frame `frame` of a mono sound as interleaved float stereo: the binaural pass while
+// there is input left, silence afterwards (the reverb tail), then the reverb if requested.
+// Returns a pointer into the state's scratch buffers.
+static const float* render_frame(RenderState& state, const float* input_buffer, int input_length, int frame, IPLBinauralEffectParams& params, bool use_reverb)
+{
+	auto framesize = state.audioSettings.frameSize;
+	int offset = frame * framesize;
+
+	if (offset < input_length) {
+		spatialize_frame(state, input_buffer, input_length, frame, params);
+		iplAudioBufferInterleave(state.context, &state.outBuffer, state.outputaudioframe.data());
+	} else {
+		// Reverb tail: let the reverb ring out on silence
+		std::fill(state.outputaudioframe.begin(), state.outputaudioframe.end(), 0.0f);
+	}
+
+	if (use_reverb) {
+		reverb_process(state.reverb.get(), state.outputaudioframe.data(), state.reverbOutputBuffer.data(), framesize);
+		return state.reverbOutputBuffer.data();
+	}
+	return state.outputaudioframe.data();
+}
+
+// Sample frames of processing frame `frame` that still carry input. Dry output stops there
+// rather than at the end of the zero-padded last frame.
+static int input_frame_length(const RenderState& state, int input_length, int frame)
+{
+	auto framesize = state.audioSettings.frameSize;
+	return std::min(framesize, input_length - frame * framesize);
+}
+
+// Spatialize numframes processing frames of mono input into interleaved 16-bit stereo at output,
+// input_length stereo frames in all
+static bool render_binaural(RenderState& state, const float* input_buffer, int input_length, int numframes, float angle_x, float angle_y, int16_t* output)
+{
+	IPLBinauralEffectParams params = make_binaural_params(state, angle_x, angle_y);
+	int16_t* outData = output;
+
+	for (int i = 0; i < numframes; ++i)
+	{
+		if (render_cancelled(state)) {
+			return false;
+		}
+		spatialize_frame(state, input_buffer, input_length, i, params);
+
+		// Interleave and convert straight into the output
+		int frames = input_frame_length(state, input_length, i);
+		{
+			StageTimer timer(STAT_CONVERSION);
+			convert_stereo_to_int16(state.outBuffer.data[0], state.outBuffer.data[1], 1.0f, frames, outData, output_dither(state));
+		}
+		outData += frames * 2; // 2 channels
+	}
+
+	stat_add(g_stats.framesRendered, numframes);
+	return true;
+}
+
+// Run stereo 16-bit input plus up to total_frames - numframes frames of decay tail through verblib into output.
+// Returns the number of processing frames written, or -1 if the render was cancelled.
+static int render_reverb(RenderState& state, const int16_t* input_buffer, int input_length, int numframes, int total_frames, int16_t* output)
+{
+	auto framesize = state.audioSettings.frameSize;
+	int16_t* outData = output;
+	ReverbTailGate tail;
+
+	for (int i = 0; i < total_frames; ++i)
+	{
+		if (render_cancelled(state)) {
+			return -1;
+		}
+
+		// Convert this frame's input to float, then silence once the input has run out (the decay tail)
+		int offset = i * framesize * 2;
+		int count = std::max(0, std::min(framesize * 2, input_length - offset));
+		for (int j = 0; j < count; ++j) {
+			state.reverbInputBuffer[j] = static_cast<float>(input_buffer[offset + j]) / 32767.0f;
+		}
+		std::fill(state.reverbInputBuffer.begin() + count, state.reverbInputBuffer.end(), 0.0f);
+
+		// Process with verblib
+		reverb_process(state.reverb.get(), state.reverbInputBuffer.data(), state.reverbOutputBuffer.data(), framesize);
+
+		// Convert float samples back to 16-bit integers
+		{
+			StageTimer timer(STAT_CONVERSION);
+			convert_to_int16(state.reverbOutputBuffer.data(), 1.0f, framesize * 2, outData, output_dither(state));
+		}
+		outData += framesize * 2;
+
+		if (i >= numframes && tail.update(state, state.reverbOutputBuffer.data(), 1.0f)) {
+			stat_add(g_stats.framesRendered, i + 1);
+			stat_add(g_stats.tailFramesSkipped, total_frames - (i + 1));
+			return i + 1;
+		}
+	}
+	stat_add(g_stats.framesRendered, total_frames);
+	return total_frames;
+}
+
+static int output_length(RenderState& state, int input_frames, bool include_reverb_tail)
+{
+	if (input_frames <= 0) {
+		return 0;
+	}
+
+	auto framesize = state.audioSettings.frameSize;
+	auto numframes = (input_frames + framesize - 1) / framesize; // Ceiling division
+	if (include_reverb_tail && state.reverbInitialized) {
+		sync_reverb_settings(state); // The tail length depends on the room size
+		numframes += reverb_tail_frames(state);
+	}
+	return numframes * framesize * 2; // 2 channels
+}
+
+// Maximum number of 16-bit samples process_sound / apply_reverb will write for input_frames sample frames
+// (mono samples for process_sound, stereo frames for apply_reverb), including the reverb tail if requested.
+// The reverb tail stops once it becomes inaudible, so the real output length is usually shorter.
+EXPORT int get_output_length(Renderer* renderer, int input_frames, bool include_reverb_tail)
+{
+	renderer = resolve_renderer(renderer);
+	if (!renderer) {
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(renderer->mutex);
+	return output_length(renderer->render, input_frames, include_reverb_tail);
+}
+
+EXPORT bool process_sound_into(Renderer* renderer, const float* input_buffer, int input_length, float angle_x, float angle_y, int16_t* output_buffer, int output_capacity, int* output_length)
+{
+	renderer = resolve_renderer(renderer);
+	if (!renderer || !input_buffer || !output_length) {
+		return false;
+	}
+
+	RenderLock lock(*renderer);
+	RenderState& state = renderer->render;
+	StageTimer timer(STAT_PROCESS_SOUND);
+
+	auto framesize = state.audioSettings.frameSize;
+	auto numframes = (input_length + framesize - 1) / framesize; // Ceiling division
+	auto total_output_samples = numframes * framesize * 2; // 2 channels
+
+	if (numframes == 0) {
+		*output_length = 0;
+		return true;
+	}
+
+	if (!output_buffer || output_capacity < total_output_samples) {
+		*output_length = total_output_samples; // Tell the caller how much room is needed
+		return false;
+	}
+
+	if (!render_binaural(state, input_buffer, input_length, numframes, angle_x, angle_y, output_buffer)) {
+		return false;
+	}
+
+	*output_length = input_length * 2; // The padding of the last frame is trimmed off
+	return true;
+}
+
+// Output buffers handed to Python, released with free_output_sound. nullptr when out of memory.
+static int16_t* allocate_output(int samples)
+{
+	StageTimer timer(STAT_ALLOCATION);
+	int16_t* output = new (std::nothrow) int16_t[samples];
+	if (!output) {
+		stat_add(g_stats.failures);
+	}
+	return output;
+}
+
+EXPORT bool process_sound(Renderer* renderer, const float* input_buffer, int input_length, float angle_x, float angle_y, int16_t** output_buffer, int* output_length)
+{
+	renderer = resolve_renderer(renderer);
+	if (!renderer || !input_buffer || !output_buffer || !output_length) {
+		return false;
+	}
+
+	auto total_output_samples = get_output_length(renderer, input_length, false);
+
+	if (total_output_samples == 0) {
+		*output_buffer = nullptr;
+		*output_length = 0;
+		return true;
+	}
+
+	// Allocate output buffer for stereo output (16-bit samples)
+	int16_t* output = allocate_output(total_output_samples);
+	if (!output) {
+		return false;
+	}
+
+	if (!process_sound_into(renderer, input_buffer, input_length, angle_x, angle_y, output, total_output_samples, output_length)) {
+		delete[] output;
+		return false;
+	}
+
+	*output_buffer = output;
+	return true;
+}
+
+EXPORT bool apply_reverb_into(Renderer* renderer, const int16_t* input_buffer, int input_length, int16_t* output_buffer, int output_capacity, int* output_length)
+{
+	renderer = resolve_renderer(renderer);
+	if (!renderer || !renderer->render.reverbInitialized || !input_buffer || !output_length) {
+		return false;
+	}
+
+	RenderLock lock(*renderer);
+	RenderState& state = renderer->render;
+	StageTimer timer(STAT_APPLY_REVERB);
+	sync_reverb_settings(state);
+
+	auto framesize = state.audioSettings.frameSize;
+	auto numframes = (input_length / 2 + framesize - 1) / framesize; // Ceiling division, /2 because stereo
+
+	if (numframes == 0) {
+		*output_length = 0;
+		return true;
+	}
+
+	// Calculate tail frames for reverb decay
+	auto total_frames = numframes + reverb_tail_frames(state);
+	auto total_output_samples = total_frames * framesize * 2; // 2 channels
+
+	if (!output_buffer || output_capacity < total_output_samples) {
+		*output_length = total_output_samples; // Tell the caller how much room is needed
+		return false;
+	}
+
+	auto written_frames = render_reverb(state, input_buffer, input_length, numframes, total_frames, output_buffer);
+	if (written_frames < 0) {
+		return false;
+	}
+
+	*output_length = written_frames * framesize * 2; // 2 channels
+	return true;
+}
+
+EXPORT bool apply_reverb(Renderer* renderer, const int16_t* input_buffer, int input_length, int16_t** output_buffer, int* output_length)
+{
+	renderer = resolve_renderer(renderer);
+	if (!renderer || !renderer->render.reverbInitialized || !input_buffer || !output_buffer || !output_length) {
+		return false;
+	}
+
+	auto total_output_samples = get_output_length(renderer, input_length / 2, true);
+
+	if (total_output_samples == 0) {
+		*output_buffer = nullptr;
+		*output_length = 0;
+		return true;
+	}
+
+	int16_t* output = allocate_output(total_output_samples);
+	if (!output) {
+		return false;
+	}
+
+	if (!apply_reverb_into(renderer, input_buffer, input_length, output, total_output_samples, output_length)) {
+		delete[] output;
+		return false;
+	}
+
+	*output_buffer = output;
+	return true;
+}
+
+// With a path, the sound starts at angle_x, angle_y and follows the path from there
+static bool render_sound(RenderState& state, const float* input_buffer, int input_length, float angle_x, float angle_y, float gain, bool use_reverb, int16_t* output_buffer, int output_capacity, int* output_length, const DirectionPath* path = nullptr)
+{
+	StageTimer timer(STAT_RENDER_SOUND);
+	use_reverb = use_reverb && state.reverbInitialized;
+	if (use_reverb) {
+		sync_reverb_settings(state);
+	}
+
+	auto framesize = state.audioSettings.frameSize;
+	auto numframes = (input_length + framesize - 1) / framesize; // Ceiling division
+
+	if (numframes == 0) {
+		*output_length = 0;
+		return true;
+	}
+
+	auto total_frames = use_reverb ? numframes + reverb_tail_frames(state) : numframes;
+	auto total_output_samples = total_frames * framesize * 2; // 2 channels
+
+	if (!output_buffer || output_capacity < total_output_samples) {
+		*output_length = total_output_samples; // Tell the caller how much room is needed
+		return false;
+	}
+
+	IPLBinauralEffectParams params = make_binaural_params(state, angle_x, angle_y);
+	int16_t* outData = output_buffer;
+	ReverbTailGate tail;
+
+	Dither* dither = output_dither(state);
+
+	for (int i = 0; i < total_frames; ++i)
+	{
+		if (render_cancelled(state)) {
+			return false;
+		}
+
+		if (path && i < numframes) {
+			follow_path(state.audioSettings, *path, i, params);
+		}
+
+		if (!use_reverb) {
+			// Dry renders go from the deinterleaved binaural output straight to 16-bit
+			spatialize_frame(state, input_buffer, input_length, i, params);
+			int frames = input_frame_length(state, input_length, i);
+			{
+				StageTimer timer(STAT_CONVERSION);
+				convert_stereo_to_int16(state.outBuffer.data[0], state.outBuffer.data[1], gain, frames, outData, dither);
+			}
+			outData += frames * 2; // 2 channels
+			continue;
+		}
+
+		const float* frameOut = render_frame(state, input_buffer, input_length, i, params, use_reverb);
+		{
+			StageTimer timer(STAT_CONVERSION);
+			convert_to_int16(frameOut, gain, framesize * 2, outData, dither);
+		}
+		outData += framesize * 2; // 2 channels
+
+		if (i >= numframes && tail.update(state, frameOut, gain)) {
+			stat_add(g_stats.tailFramesSkipped, total_frames - (i + 1));
+			total_frames = i + 1;
+			break; // The rest of the tail is inaudible
+		}
+	}
+
+	stat_add(g_stats.framesRendered, total_frames);
+	*output_length = static_cast<int>(outData - output_buffer);
+	return true;
+}
+
+// Spatialize, reverberate and scale mono input in one pass, staying in float until the final 16-bit conversion
+EXPORT bool render_sound_into(Renderer* renderer, const float* input_buffer, int input_length, float angle_x, float angle_y, float gain, bool use_reverb, int16_t* output_buffer, int output_capacity, int* output_length)
+{
+	renderer = resolve_renderer(renderer);
+	if (!renderer || !input_buffer || !output_length) {
+		return false;
+	}
+
+	RenderLock lock(*renderer);
+	return render_sound(renderer->render, input_buffer, input_length, angle_x, angle_y, gain, use_reverb, output_buffer, output_capacity, output_length);
+}
+
+// Maximum number of 16-bit samples process_sound_handle will write for a registered sound
+EXPORT int get_sound_output_length(Renderer* renderer, int handle, bool include_reverb_tail)
+{
+	auto sound = find_sound(handle);
+	if (!sound) {
+		return 0;
+	}
+	return get_output_length(renderer, static_cast<int>(sound->samples.size()), include_reverb_tail);
+}
+
+// Build the cache key for a render and snap the angles to the centre of their buckets,
+// so a miss renders exactly what later hits will replay
+static CacheKey make_cache_key(const IPLAudioSettings& settings, int handle, float& angle_x, float& angle_y, float gain, bool use_reverb)
+{
+	CacheKey key{ handle, settings.samplingRate, settings.frameSize, g_outputCache.bucket(angle_x), g_outputCache.bucket(angle_y), static_cast<int>(std::lround(gain * 1024.0f)), use_reverb, g_reverbGeneration.load() };
+	angle_x = g_outputCache.bucket_centre(key.bucketX);
+	angle_y = g_outputCache.bucket_centre(key.bucketY);
+	return key;
+}
+
+// Render a registered sound without copying its samples across the DLL boundary.
+// Renders are cached by quantised direction, so replaying a recent sound is a single copy.
+EXPORT bool process_sound_handle(Renderer* renderer, int handle, float angle_x, float angle_y, float gain, bool use_reverb, int16_t* output_buffer, int output_capacity, int* output_length)
+{
+	renderer = resolve_renderer(renderer);
+	auto sound = find_sound(handle);
+	if (!renderer || !sound || !output_length) {
+		return false;
+	}
+
+	if (sound->samples.empty()) {
+		*output_length = 0;
+		return true;
+	}
+
+	RenderLock lock(*renderer);
+	RenderState& state = renderer->render;
+	auto input_length = static_cast<int>(sound->samples.size());
+	use_reverb = use_reverb && state.reverbInitialized;
+
+	if (!g_outputCache.enabled()) {
+		return render_sound(state, sound->samples.data(), input_length, angle_x, angle_y, gain, use_reverb, output_buffer, output_capacity, output_length);
+	}
+
+	CacheKey key = make_cache_key(state.audioSettings, handle, angle_x, angle_y, gain, use_reverb);
+	if (auto cached = g_outputCache.find(key)) {
+		auto samples = static_cast<int>(cached->size());
+		if (!output_buffer || output_capacity < samples) {
+			*output_length = samples; // Tell the caller how much room is needed
+			return false;
+		}
+		std::copy(cached->begin(), cached->end(), output_buffer);
+		*output_length = samples;
+		return true;
+	}
+
+	// A cached render is replayed for any later play, so it mustn't carry over what played before it
+	iplBinauralEffectReset(state.effect);
+	if (use_reverb) {
+		sync_reverb_settings(state);
+		verblib_mute(state.reverb.get());
+	}
+
+	if (!render_sound(state, sound->samples.data(), input_length, angle_x, angle_y, gain, use_reverb, output_buffer, output_capacity, output_length)) {
+		return false;
+	}
+
+	try {
+		g_outputCache.insert(key, std::make_shared<const std::vector<int16_t>>(output_buffer, output_buffer + *output_length));
+	} catch (const std::bad_alloc&) {
+		// Caching is best effort
+	}
+	return true;
+}
+
+// Render a registered sound moving along keyframe_count keyframes, in time order, its direction
+// interpolated every processing frame. Renders of moving sounds aren't cached.
+EXPORT bool process_sound_path(Renderer* renderer, int handle, const DirectionKeyframe* keyframes, int keyframe_count, float gain, bool use_reverb, int16_t* output_buffer, int output_capacity, int* output_length)
+{
+	renderer = resolve_renderer(renderer);
+	auto sound = find_sound(handle);
+	DirectionPath path;
+	if (!renderer || !sound || !output_length || !path.assign(keyframes, keyframe_count)) {
+		return false;
+	}
+
+	if (sound->samples.empty()) {
+		*output_length = 0;
+		return true;
+	}
+
+	RenderLock lock(*renderer);
+	auto input_length = static_cast<int>(sound->samples.size());
+	const DirectionKeyframe& first = path.keys[0];
+	return render_sound(renderer->render, sound->samples.data(), input_length, first.angleX, first.angleY, gain, use_reverb, output_buffer, output_capacity, output_length, &path);
+}
+
+// Abandon every render call made on renderer so far, including any still waiting for the renderer.
+// Renders stop at their next frame and return false; calls made afterwards are unaffected.
+EXPORT void cancel_render(Renderer* renderer)
+{
+	renderer = resolve_renderer(renderer);
+	if (renderer) {
+		renderer->cancels.fetch_add(1, std::memory_order_acq_rel);
+	}
+}
+
+EXPORT void free_output_sound(int16_t* buffer)
+{
+	if (buffer) {
+		delete[] buffer;
+	}
+}
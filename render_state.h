@@ -0,0 +1,402 @@
+// Per-stream render state, the ambisonic bus, renderers and the shared Steam Audio state, plus the
+// reverb settings every render state follows.
+
+#pragma once
+
+#include "stats.h"
+#include "dsp.h"
+
+// Per-stream processing state: one binaural effect, one reverb and their scratch buffers.
+// Anything that renders concurrently with another stream needs its own RenderState.
+struct RenderState {
+	IPLContext context = nullptr; // Retained reference
+	IPLHRTF hrtf = nullptr;       // Retained reference
+	IPLAudioSettings audioSettings{};
+	IPLBinauralEffect effect = nullptr;
+	IPLAmbisonicsEncodeEffect encoder = nullptr; // Instead of effect, for voices mixed into an ambisonic bus
+	IPLAudioBuffer outBuffer{};
+	AlignedVector<float> inputframe;
+	AlignedVector<float> outputaudioframe;
+	AlignedVector<float> reverbInputBuffer;
+	AlignedVector<float> reverbOutputBuffer;
+	std::unique_ptr<verblib> reverb;
+	std::vector<float, AlignedAllocator<float, 64>> reverbDelayLines; // Every comb and allpass buffer, cache line aligned
+	bool reverbInitialized = false;
+	unsigned reverbGeneration = ~0u; // Generation of the reverb settings last applied to reverb
+	int reverbSilenceWindow = 0;     // Sample frames of quiet output after which the rest of the tail is inaudible
+	Dither dither;
+	const std::atomic<unsigned>* cancelToken = nullptr; // Bumped to abandon renders in progress, see render_cancelled
+	unsigned cancelSeen = 0;                            // The token's value when the current render started
+};
+
+static void destroy_render_state(RenderState& state)
+{
+	if (state.outBuffer.data) {
+		iplAudioBufferFree(state.context, &state.outBuffer);
+	}
+	if (state.effect) {
+		iplBinauralEffectRelease(&state.effect);
+	}
+	if (state.encoder) {
+		iplAmbisonicsEncodeEffectRelease(&state.encoder);
+	}
+	if (state.hrtf) {
+		iplHRTFRelease(&state.hrtf);
+	}
+	if (state.context) {
+		iplContextRelease(&state.context);
+	}
+	state = RenderState{};
+}
+
+// Whether the render in progress on state has been cancelled since it started. Render loops check once
+// per frame. An abandoned render leaves the effect and reverb clean, so none of it leaks into the next.
+static bool render_cancelled(RenderState& state)
+{
+	if (!state.cancelToken || state.cancelToken->load(std::memory_order_acquire) == state.cancelSeen) {
+		return false;
+	}
+	if (state.effect) {
+		iplBinauralEffectReset(state.effect);
+	}
+	if (state.reverbInitialized) {
+		verblib_mute(state.reverb.get());
+	}
+	stat_add(g_stats.rendersCancelled);
+	return true;
+}
+
+// The state's dither generator when dither is enabled, else nullptr
+static Dither* output_dither(RenderState& state)
+{
+	return g_ditherEnabled.load(std::memory_order_relaxed) ? &state.dither : nullptr;
+}
+
+// Once the output has stayed quiet for this long every comb has been read out and the allpasses have
+// flushed, so nothing louder is left circulating in the reverb network
+static int reverb_silence_window(const verblib* verb)
+{
+	int longestComb = 0;
+	for (int i = 0; i < verblib_numcombs; ++i) {
+		longestComb = std::max({ longestComb, verb->combL[i].bufsize, verb->combR[i].bufsize });
+	}
+	int allpasses = 0;
+	for (int i = 0; i < verblib_numallpasses; ++i) {
+		allpasses += std::max(verb->allpassL[i].bufsize, verb->allpassR[i].bufsize);
+	}
+	return longestComb + allpasses;
+}
+
+// Give a state its own verblib and reverb scratch buffers. Returns false only when out of memory;
+// a rate verblib doesn't support leaves reverbInitialized unset instead.
+static bool create_reverb(RenderState& state, const IPLAudioSettings& audioSettings)
+{
+	auto framesize = audioSettings.frameSize;
+	state.audioSettings = audioSettings;
+	try {
+		state.reverb.reset(new verblib);
+		state.reverbDelayLines.resize(verblib_get_buffer_size(audioSettings.samplingRate));
+		if (verblib_initialize_with_buffer(state.reverb.get(), audioSettings.samplingRate, 2, state.reverbDelayLines.data())) {
+			state.reverbInitialized = true;
+			state.reverbSilenceWindow = reverb_silence_window(state.reverb.get());
+			state.reverbInputBuffer.resize(2 * framesize);
+			state.reverbOutputBuffer.resize(2 * framesize);
+		}
+	} catch (const std::bad_alloc&) {
+		return false;
+	}
+	return true;
+}
+
+// with_reverb is false for states that only ever spatialize, such as mixer voices feeding a shared reverb bus
+static bool create_render_state(RenderState& state, IPLContext context, IPLHRTF hrtf, const IPLAudioSettings& audioSettings, bool with_reverb = true)
+{
+	state.context = iplContextRetain(context);
+	state.hrtf = iplHRTFRetain(hrtf);
+	state.audioSettings = audioSettings;
+	auto framesize = audioSettings.frameSize;
+
+	IPLBinauralEffectSettings effectSettings;
+	effectSettings.hrtf = state.hrtf;
+
+	if (iplBinauralEffectCreate(state.context, &state.audioSettings, &effectSettings, &state.effect) != IPL_STATUS_SUCCESS) {
+		destroy_render_state(state);
+		return false;
+	}
+
+	if (iplAudioBufferAllocate(state.context, 2, framesize, &state.outBuffer) != IPL_STATUS_SUCCESS) {
+		destroy_render_state(state);
+		return false;
+	}
+
+	if (with_reverb && !create_reverb(state, audioSettings)) {
+		destroy_render_state(state);
+		return false;
+	}
+
+	try {
+		state.inputframe.resize(framesize);
+		state.outputaudioframe.resize(2 * framesize);
+	} catch (const std::bad_alloc&) {
+		destroy_render_state(state);
+		return false;
+	}
+	return true;
+}
+
+// Number of channels in an ambisonic sound field of the given order
+static int ambisonic_channels(int order)
+{
+	return (order + 1) * (order + 1);
+}
+
+// A state that encodes into an ambisonic field of up to order `order` instead of spatializing itself
+static bool create_encoder_state(RenderState& state, IPLContext context, IPLHRTF hrtf, const IPLAudioSettings& audioSettings, int order)
+{
+	state.context = iplContextRetain(context);
+	state.hrtf = iplHRTFRetain(hrtf);
+	state.audioSettings = audioSettings;
+
+	IPLAmbisonicsEncodeEffectSettings encodeSettings;
+	encodeSettings.maxOrder = order;
+	if (iplAmbisonicsEncodeEffectCreate(state.context, &state.audioSettings, &encodeSettings, &state.encoder) != IPL_STATUS_SUCCESS) {
+		destroy_render_state(state);
+		return false;
+	}
+
+	try {
+		state.inputframe.resize(audioSettings.frameSize);
+	} catch (const std::bad_alloc&) {
+		destroy_render_state(state);
+		return false;
+	}
+	return true;
+}
+
+// An ambisonic sound field that any number of sources are encoded into, then decoded to binaural
+// stereo with a single HRTF convolution per frame
+struct AmbisonicBus {
+	IPLContext context = nullptr; // Retained reference
+	IPLHRTF hrtf = nullptr;       // Retained reference
+	int order = 0;
+	IPLAmbisonicsDecodeEffect decoder = nullptr;
+	IPLAudioBuffer field{};      // Sum of this frame's encoded sources
+	IPLAudioBuffer encoded{};    // One source's encoded frame, before it is added to field
+	IPLAudioBuffer decoded{};    // Deinterleaved binaural stereo
+	AlignedVector<float> output; // decoded, interleaved
+	bool active = false;         // Something was encoded into field this frame
+	bool idle = true;            // The decoder holds nothing from earlier frames
+};
+
+static void destroy_ambisonic_bus(AmbisonicBus& bus)
+{
+	for (IPLAudioBuffer* buffer : { &bus.field, &bus.encoded, &bus.decoded }) {
+		if (buffer->data) {
+			iplAudioBufferFree(bus.context, buffer);
+		}
+	}
+	if (bus.decoder) {
+		iplAmbisonicsDecodeEffectRelease(&bus.decoder);
+	}
+	if (bus.hrtf) {
+		iplHRTFRelease(&bus.hrtf);
+	}
+	if (bus.context) {
+		iplContextRelease(&bus.context);
+	}
+	bus = AmbisonicBus{};
+}
+
+// The listener every path renders for: the binaural effect's own frame, +x right, +y up, facing -z.
+// The ambisonic decode is oriented the same way, so an encoded direction lands where the binaural
+// effect puts it.
+static const IPLVector3 kListenerRight{ 1.0f, 0.0f, 0.0f };
+static const IPLVector3 kListenerUp{ 0.0f, 1.0f, 0.0f };
+static const IPLVector3 kListenerAhead{ 0.0f, 0.0f, -1.0f };
+
+// The plane make_direction places sounds on, one unit along +z, as they always have been. The themes
+// are tuned for it, so it stays put whichever path renders a sound.
+static const IPLVector3 kSoundPlane{ 0.0f, 0.0f, 1.0f };
+
+static bool create_ambisonic_bus(AmbisonicBus& bus, IPLContext context, IPLHRTF hrtf, const IPLAudioSettings& audioSettings, int order)
+{
+	bus.context = iplContextRetain(context);
+	bus.hrtf = iplHRTFRetain(hrtf);
+	bus.order = order;
+	IPLAudioSettings settings = audioSettings;
+	auto framesize = audioSettings.frameSize;
+	auto channels = ambisonic_channels(order);
+
+	IPLAmbisonicsDecodeEffectSettings decodeSettings{};
+	decodeSettings.speakerLayout.type = IPL_SPEAKERLAYOUTTYPE_STEREO;
+	decodeSettings.hrtf = bus.hrtf;
+	decodeSettings.maxOrder = order;
+	if (iplAmbisonicsDecodeEffectCreate(bus.context, &settings, &decodeSettings, &bus.decoder) != IPL_STATUS_SUCCESS
+		|| iplAudioBufferAllocate(bus.context, channels, framesize, &bus.field) != IPL_STATUS_SUCCESS
+		|| iplAudioBufferAllocate(bus.context, channels, framesize, &bus.encoded) != IPL_STATUS_SUCCESS
+		|| iplAudioBufferAllocate(bus.context, 2, framesize, &bus.decoded) != IPL_STATUS_SUCCESS) {
+		destroy_ambisonic_bus(bus);
+		return false;
+	}
+
+	try {
+		bus.output.resize(2 * framesize);
+	} catch (const std::bad_alloc&) {
+		destroy_ambisonic_bus(bus);
+		return false;
+	}
+	for (int c = 0; c < channels; ++c) {
+		std::fill(bus.field.data[c], bus.field.data[c] + framesize, 0.0f);
+	}
+	return true;
+}
+
+// Encode a mono frame arriving from `direction` into the bus, scaled by gain. Encoding keeps no
+// tail, so the effect state it returns carries nothing worth checking.
+static void encode_ambisonic(AmbisonicBus& bus, RenderState& source, const float* frame, IPLVector3 direction, float gain)
+{
+	auto framesize = source.audioSettings.frameSize;
+	float* frameData[] = { const_cast<float*>(frame) };
+	IPLAudioBuffer inBuffer{ 1, framesize, frameData };
+	IPLAmbisonicsEncodeEffectParams params;
+	params.direction = direction;
+	params.order = bus.order;
+	iplAmbisonicsEncodeEffectApply(source.encoder, &params, &inBuffer, &bus.encoded);
+
+	for (int c = 0; c < bus.field.numChannels; ++c) {
+		mix_add(bus.field.data[c], bus.encoded.data[c], gain, framesize);
+	}
+	bus.active = true;
+}
+
+// Decode this frame's field as heard by the listener, add it to the interleaved
+// stereo mix and clear the field for the next frame
+static void decode_ambisonic(AmbisonicBus& bus, float* mix)
+{
+	if (!bus.active) {
+		if (!bus.idle) {
+			iplAmbisonicsDecodeEffectReset(bus.decoder); // Start the next sound from a clean filter
+			bus.idle = true;
+		}
+		return;
+	}
+
+	IPLAmbisonicsDecodeEffectParams params{};
+	params.order = bus.order;
+	params.hrtf = bus.hrtf;
+	params.orientation.right = kListenerRight;
+	params.orientation.up = kListenerUp;
+	params.orientation.ahead = kListenerAhead;
+	params.orientation.origin = IPLVector3{ 0.0f, 0.0f, 0.0f };
+	params.binaural = IPL_TRUE;
+	iplAmbisonicsDecodeEffectApply(bus.decoder, &params, &bus.field, &bus.decoded);
+	iplAudioBufferInterleave(bus.context, &bus.decoded, bus.output.data());
+	mix_add(mix, bus.output.data(), 1.0f, bus.output.size());
+
+	auto framesize = bus.field.numSamples;
+	for (int c = 0; c < bus.field.numChannels; ++c) {
+		std::fill(bus.field.data[c], bus.field.data[c] + framesize, 0.0f);
+	}
+	bus.active = false;
+	bus.idle = false;
+}
+
+// Handle returned by create_renderer. Renderers share the context and HRTF but nothing else,
+// so different renderers can be used from different threads at the same time.
+struct Renderer {
+	RenderState render;
+	std::mutex mutex; // Serialises calls made on the same renderer
+	std::atomic<unsigned> cancels{ 0 }; // Bumped by cancel_render
+
+	Renderer()
+	{
+		render.cancelToken = &cancels;
+	}
+};
+
+// Holds a renderer for one render call. The call can be cancelled from the moment it is made, even
+// while it is still waiting for another call on the same renderer to finish.
+class RenderLock {
+public:
+	explicit RenderLock(Renderer& renderer)
+		: m_seen(renderer.cancels.load(std::memory_order_acquire))
+		, m_lock(renderer.mutex)
+	{
+		renderer.render.cancelSeen = m_seen;
+	}
+
+private:
+	unsigned m_seen;
+	std::lock_guard<std::mutex> m_lock;
+};
+
+// An HRTF for audio settings other than the ones passed to initialize_steam_audio
+struct SharedHrtf {
+	IPLAudioSettings audioSettings;
+	IPLHRTF hrtf;
+};
+
+// Global state for Steam Audio + Verblib
+struct SteamAudioState {
+	IPLContext context = nullptr;
+	IPLHRTF hrtf = nullptr;
+	IPLAudioSettings audioSettings{};
+	std::unique_ptr<Renderer> renderer; // Used by exports that are passed a null renderer
+	std::vector<SharedHrtf> hrtfs;
+};
+
+static SteamAudioState g_state;
+
+// Progress of initialization, as returned by get_steam_audio_status
+enum SteamAudioStatus {
+	STEAM_AUDIO_UNINITIALIZED = 0,
+	STEAM_AUDIO_LOADING = 1, // The context and HRTF are being created on a background thread
+	STEAM_AUDIO_READY = 2,
+	STEAM_AUDIO_FAILED = 3,
+};
+
+static std::atomic<int> g_status{ STEAM_AUDIO_UNINITIALIZED };
+static std::mutex g_initMutex;  // Serialises initialization and cleanup
+static std::thread g_initThread; // Background initialization started by initialize_steam_audio_async
+
+// Whether g_state's context, HRTF and default renderer exist. While loading only g_state.audioSettings is valid.
+static bool steam_audio_ready()
+{
+	return g_status.load(std::memory_order_acquire) == STEAM_AUDIO_READY;
+}
+
+static std::atomic<unsigned> g_reverbGeneration{ 0 };
+
+// Last reverb settings passed to set_reverb_settings, so other render states can follow them
+struct ReverbSettings {
+	float roomSize = verblib_initialroom;
+	float damping = verblib_initialdamp;
+	float wetLevel = verblib_initialwet;
+	float dryLevel = verblib_initialdry;
+	float width = verblib_initialwidth;
+};
+
+static std::mutex g_reverbSettingsMutex;
+static ReverbSettings g_reverbSettings;
+
+static void apply_reverb_settings(verblib* verb, const ReverbSettings& settings)
+{
+	verblib_set_room_size(verb, settings.roomSize);
+	verblib_set_damping(verb, settings.damping);
+	verblib_set_wet(verb, settings.wetLevel);
+	verblib_set_dry(verb, settings.dryLevel);
+	verblib_set_width(verb, settings.width);
+}
+
+// Bring a render state's reverb up to date with the last set_reverb_settings call
+static void sync_reverb_settings(RenderState& state)
+{
+	unsigned generation = g_reverbGeneration.load();
+	if (!state.reverbInitialized || state.reverbGeneration == generation) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_reverbSettingsMutex);
+	apply_reverb_settings(state.reverb.get(), g_reverbSettings);
+	state.reverbGeneration = generation;
+}
@@ -0,0 +1,927 @@
+// Registered sounds: WAV decoding, resampling to the engine rate, theme packs and the registry that
+// maps pack sounds in and out under a memory budget.
+
+#pragma once
+
+#include "stats.h"
+#include "render_state.h"
+#include "output_cache.h"
+
+#ifndef _WIN32
+static bool narrow_path(const wchar_t* path, std::vector<char>& narrow)
+{
+	narrow.resize(wcslen(path) * 4 + 1);
+	return wcstombs(narrow.data(), path, narrow.size()) != static_cast<size_t>(-1);
+}
+#endif
+
+// A read-only mapping of part of a file, unmapped when the last sound viewing it is released
+class MappedRegion {
+public:
+	MappedRegion(void* base, size_t length, const uint8_t* data) : m_base(base), m_length(length), m_data(data)
+	{
+	}
+
+	~MappedRegion()
+	{
+		unmap(m_base, m_length);
+	}
+
+	MappedRegion(const MappedRegion&) = delete;
+	MappedRegion& operator=(const MappedRegion&) = delete;
+
+	const uint8_t* data() const { return m_data; }
+
+	static void unmap(void* base, size_t length)
+	{
+#ifdef _WIN32
+		(void)length;
+		UnmapViewOfFile(base);
+#else
+		munmap(base, length);
+#endif
+	}
+
+private:
+	void* m_base;
+	size_t m_length;
+	const uint8_t* m_data;
+};
+
+// A file that parts are mapped from on demand. It stays open, so regions mapped later still see the
+// contents it had when it was opened even after a newer file has been renamed over it.
+class MappableFile {
+public:
+	MappableFile() = default;
+	MappableFile(const MappableFile&) = delete;
+	MappableFile& operator=(const MappableFile&) = delete;
+
+	~MappableFile()
+	{
+#ifdef _WIN32
+		if (m_mapping) {
+			CloseHandle(m_mapping);
+		}
+#else
+		if (m_file >= 0) {
+			close(m_file);
+		}
+#endif
+	}
+
+	bool open(const wchar_t* path)
+	{
+#ifdef _WIN32
+		// Shared for deletion so the theme can still be removed, or its pack replaced, while it is open
+		HANDLE file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		bool ok = GetFileSizeEx(file, &size) && size.QuadPart > 0;
+		m_mapping = ok ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		CloseHandle(file); // The mapping object keeps the file open
+		if (!m_mapping) {
+			return false;
+		}
+		m_size = static_cast<uint64_t>(size.QuadPart);
+#else
+		std::vector<char> narrow;
+		if (!narrow_path(path, narrow)) {
+			return false;
+		}
+		m_file = ::open(narrow.data(), O_RDONLY);
+		struct stat info;
+		if (m_file < 0 || fstat(m_file, &info) != 0 || info.st_size <= 0) {
+			return false;
+		}
+		m_size = static_cast<uint64_t>(info.st_size);
+#endif
+		return true;
+	}
+
+	uint64_t size() const { return m_size; }
+
+	// Map length bytes from offset. Null if they aren't all in the file or mapping fails.
+	std::shared_ptr<const MappedRegion> map(uint64_t offset, size_t length) const
+	{
+		if (length == 0 || offset > m_size || length > m_size - offset) {
+			return nullptr;
+		}
+#ifdef _WIN32
+		static const uint64_t granularity = [] {
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return static_cast<uint64_t>(info.dwAllocationGranularity);
+		}();
+#else
+		static const uint64_t granularity = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+		// Views have to start on a granularity boundary, so map from the one before offset
+		uint64_t start = offset - offset % granularity;
+		size_t span = static_cast<size_t>(offset - start) + length;
+#ifdef _WIN32
+		void* base = MapViewOfFile(m_mapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32), static_cast<DWORD>(start), span);
+		if (!base) {
+			return nullptr;
+		}
+#else
+		void* base = mmap(nullptr, span, PROT_READ, MAP_PRIVATE, m_file, static_cast<off_t>(start));
+		if (base == MAP_FAILED) {
+			return nullptr;
+		}
+#endif
+		try {
+			return std::make_shared<MappedRegion>(base, span, static_cast<const uint8_t*>(base) + (offset - start));
+		} catch (const std::bad_alloc&) {
+			MappedRegion::unmap(base, span);
+			return nullptr;
+		}
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE m_mapping = nullptr;
+#else
+	int m_file = -1;
+#endif
+	uint64_t m_size = 0;
+};
+
+// A sound's mono samples: decoded into storage of their own, or viewed in place in a mapped theme pack
+class SoundSamples {
+public:
+	SoundSamples() = default;
+	SoundSamples(const SoundSamples&) = delete;
+	SoundSamples& operator=(const SoundSamples&) = delete;
+
+	const float* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	const float* begin() const { return m_data; }
+	const float* end() const { return m_data + m_size; }
+
+	void assign(AlignedVector<float> samples)
+	{
+		m_storage = std::move(samples);
+		m_mapping.reset();
+		m_data = m_storage.data();
+		m_size = m_storage.size();
+	}
+
+	// The region stays mapped for as long as the samples are viewed
+	void view(std::shared_ptr<const MappedRegion> mapping, const float* data, size_t size)
+	{
+		m_storage = AlignedVector<float>();
+		m_mapping = std::move(mapping);
+		m_data = data;
+		m_size = size;
+	}
+
+private:
+	AlignedVector<float> m_storage;
+	std::shared_ptr<const MappedRegion> m_mapping;
+	const float* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+// A decoded mono sound owned by the DLL, referenced by an integer handle
+struct Sound {
+	SoundSamples samples;
+	int sampleRate = 0;
+};
+
+// Where a sound registered from a theme pack maps its samples from when it is next used
+struct PackSource {
+	std::shared_ptr<const MappableFile> file;
+	uint64_t offset = 0;
+	size_t length = 0; // In samples
+};
+
+struct SoundEntry {
+	std::shared_ptr<const Sound> sound; // Null while a pack sound isn't mapped
+	PackSource pack;                    // No file for sounds that stay in memory until released
+	int length = 0;
+	int sampleRate = 0;
+	std::list<int>::iterator mapped;    // In g_mappedSounds while a pack sound is mapped
+};
+
+// Registry of decoded sounds, independent from the Steam Audio state so handles survive re-initialization.
+// Pack sounds are mapped on first use and unmapped least recently used first to stay within the budget.
+static std::mutex g_soundsMutex;
+static std::unordered_map<int, SoundEntry> g_sounds;
+static std::list<int> g_mappedSounds; // Most recently used first
+static size_t g_mappedBytes = 0;
+static size_t g_soundBudget = 0;      // Set by set_sound_memory_budget; 0 keeps every pack sound mapped
+static int g_nextSoundHandle = 1;
+
+static int add_sound_entry(SoundEntry entry)
+{
+	std::lock_guard<std::mutex> lock(g_soundsMutex);
+	int handle = g_nextSoundHandle++;
+	g_sounds.emplace(handle, std::move(entry));
+	return handle;
+}
+
+static int add_sound(std::shared_ptr<const Sound> sound)
+{
+	SoundEntry entry;
+	entry.length = static_cast<int>(sound->samples.size());
+	entry.sampleRate = sound->sampleRate;
+	entry.sound = std::move(sound);
+	return add_sound_entry(std::move(entry));
+}
+
+static void unmap_sound_locked(SoundEntry& entry)
+{
+	g_mappedBytes -= entry.pack.length * sizeof(float);
+	g_mappedSounds.erase(entry.mapped);
+	entry.sound.reset(); // Voices still playing it keep their own reference
+}
+
+// Unmap the least recently used pack sounds over the budget, always keeping the most recently used one
+static void trim_mapped_sounds_locked()
+{
+	while (g_soundBudget > 0 && g_mappedBytes > g_soundBudget && g_mappedSounds.size() > 1) {
+		unmap_sound_locked(g_sounds.find(g_mappedSounds.back())->second);
+		stat_add(g_stats.soundsUnmapped);
+	}
+}
+
+// The sound as registered, at whatever rate it was stored at; find_sound converts it to the engine's
+static std::shared_ptr<const Sound> find_registered_sound(int handle)
+{
+	std::lock_guard<std::mutex> lock(g_soundsMutex);
+	auto it = g_sounds.find(handle);
+	if (it == g_sounds.end()) {
+		return nullptr;
+	}
+
+	SoundEntry& entry = it->second;
+	if (!entry.pack.file) {
+		return entry.sound;
+	}
+	if (entry.sound) {
+		g_mappedSounds.splice(g_mappedSounds.begin(), g_mappedSounds, entry.mapped); // Mark as most recently used
+		return entry.sound;
+	}
+
+	try {
+		auto sound = std::make_shared<Sound>();
+		sound->sampleRate = entry.sampleRate;
+		if (entry.pack.length > 0) {
+			auto region = entry.pack.file->map(entry.pack.offset, entry.pack.length * sizeof(float));
+			if (!region) {
+				return nullptr;
+			}
+			sound->samples.view(region, reinterpret_cast<const float*>(region->data()), entry.pack.length);
+		}
+		g_mappedSounds.push_front(handle);
+		entry.mapped = g_mappedSounds.begin();
+		entry.sound = std::move(sound);
+	} catch (const std::bad_alloc&) {
+		return nullptr;
+	}
+	g_mappedBytes += entry.pack.length * sizeof(float);
+	stat_add(g_stats.soundsMapped);
+
+	auto sound = entry.sound;
+	trim_mapped_sounds_locked();
+	return sound;
+}
+
+static uint32_t read_le32(const uint8_t* p)
+{
+	return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint16_t read_le16(const uint8_t* p)
+{
+	return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+// Decode a RIFF/WAVE file held in memory into mono float samples.
+// Multi-channel files keep only their first channel, matching the previous Python loader.
+static bool decode_wav(const uint8_t* data, size_t size, Sound& sound)
+{
+	if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) {
+		return false;
+	}
+
+	const uint8_t* fmt = nullptr;
+	const uint8_t* pcm = nullptr;
+	size_t pcmSize = 0;
+
+	size_t pos = 12;
+	while (pos + 8 <= size) {
+		uint32_t chunkSize = read_le32(data + pos + 4);
+		const uint8_t* chunk = data + pos + 8;
+		size_t available = size - (pos + 8);
+		if (std::memcmp(data + pos, "fmt ", 4) == 0 && chunkSize >= 16 && available >= 16) {
+			fmt = chunk;
+		} else if (std::memcmp(data + pos, "data", 4) == 0) {
+			pcm = chunk;
+			pcmSize = std::min<size_t>(chunkSize, available); // Tolerate truncated files
+		}
+		// Checked before advancing, as a corrupt size could otherwise wrap pos on 32-bit builds
+		if (chunkSize > available) {
+			if (chunk == pcm) {
+				break; // A truncated data chunk runs to the end of the file
+			}
+			return false;
+		}
+		pos += 8 + std::min<size_t>(static_cast<size_t>(chunkSize) + (chunkSize & 1), available); // Chunks are word aligned; the last may lack its pad byte
+	}
+
+	if (!fmt || !pcm) {
+		return false;
+	}
+
+	uint16_t format = read_le16(fmt);
+	uint16_t channels = read_le16(fmt + 2);
+	uint32_t sampleRate = read_le32(fmt + 4);
+	uint16_t bitsPerSample = read_le16(fmt + 14);
+	if (format == 0xFFFE && read_le16(fmt + 16) >= 22) {
+		format = read_le16(fmt + 24); // WAVE_FORMAT_EXTENSIBLE: first two bytes of the sub-format GUID
+	}
+
+	if (channels == 0 || sampleRate == 0) {
+		return false;
+	}
+
+	size_t bytesPerSample = bitsPerSample / 8;
+	size_t frameBytes = bytesPerSample * channels;
+	if (frameBytes == 0) {
+		return false;
+	}
+	size_t frames = pcmSize / frameBytes;
+
+	AlignedVector<float> samples(frames);
+	float* out = samples.data();
+
+	if (format == 1 && bitsPerSample == 16) {
+		for (size_t i = 0; i < frames; ++i) {
+			out[i] = static_cast<int16_t>(read_le16(pcm + i * frameBytes)) / 32768.0f;
+		}
+	} else if (format == 1 && bitsPerSample == 8) {
+		for (size_t i = 0; i < frames; ++i) {
+			out[i] = (static_cast<int>(pcm[i * frameBytes]) - 128) / 128.0f;
+		}
+	} else if (format == 1 && bitsPerSample == 24) {
+		for (size_t i = 0; i < frames; ++i) {
+			const uint8_t* p = pcm + i * frameBytes;
+			int32_t value = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+			out[i] = value / 8388608.0f;
+		}
+	} else if (format == 1 && bitsPerSample == 32) {
+		for (size_t i = 0; i < frames; ++i) {
+			out[i] = static_cast<int32_t>(read_le32(pcm + i * frameBytes)) / 2147483648.0f;
+		}
+	} else if (format == 3 && bitsPerSample == 32) {
+		for (size_t i = 0; i < frames; ++i) {
+			std::memcpy(&out[i], pcm + i * frameBytes, sizeof(float));
+		}
+	} else {
+		return false; // Unsupported sample format
+	}
+
+	sound.samples.assign(std::move(samples));
+	sound.sampleRate = static_cast<int>(sampleRate);
+	return true;
+}
+
+static FILE* open_file(const wchar_t* path, bool write)
+{
+#ifdef _WIN32
+	return _wfopen(path, write ? L"wb" : L"rb");
+#else
+	std::vector<char> narrow;
+	return narrow_path(path, narrow) ? fopen(narrow.data(), write ? "wb" : "rb") : nullptr;
+#endif
+}
+
+static bool read_file(const wchar_t* path, std::vector<uint8_t>& contents)
+{
+	FILE* file = open_file(path, false);
+	if (!file) {
+		return false;
+	}
+
+	bool ok = fseek(file, 0, SEEK_END) == 0;
+	long size = ok ? ftell(file) : -1;
+	ok = size > 0 && fseek(file, 0, SEEK_SET) == 0;
+	if (ok) {
+		contents.resize(static_cast<size_t>(size));
+		ok = fread(contents.data(), 1, contents.size(), file) == contents.size();
+	}
+	fclose(file);
+	return ok;
+}
+
+// Windowed sinc polyphase filter between two sample rates. Output sample n sits at input position
+// n * step / phases, so rates with a small ratio (44.1k to 48k is 160/147) convert exactly.
+struct PolyphaseFilter {
+	int inRate = 0;
+	int outRate = 0;
+	int phases = 0; // Interpolation points per input sample
+	int step = 0;   // Phases advanced per output sample
+	int half = 0;   // Input samples either side of the output position
+	int taps = 0;   // Coefficients per phase, 2 * half rounded up to a multiple of 4
+	AlignedVector<float> coefficients; // phases rows of taps
+};
+
+static const int kResamplerMaxPhases = 1024;
+static const double kResamplerZeroCrossings = 32.0; // Either side of the centre
+static const double kResamplerCutoff = 0.91;        // -6 dB point as a fraction of the lower Nyquist frequency
+static const double kResamplerKaiserBeta = 7.0;     // About 70 dB of stopband attenuation
+
+static int gcd(int a, int b)
+{
+	while (b != 0) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; ++k) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static std::shared_ptr<const PolyphaseFilter> make_polyphase_filter(int inRate, int outRate)
+{
+	auto filter = std::make_shared<PolyphaseFilter>();
+	filter->inRate = inRate;
+	filter->outRate = outRate;
+	int divisor = gcd(inRate, outRate);
+	filter->phases = outRate / divisor;
+	filter->step = inRate / divisor;
+	if (filter->phases > kResamplerMaxPhases) {
+		// No small exact ratio, so round it. The pitch moves by a fraction of a step in ~1000.
+		filter->phases = kResamplerMaxPhases;
+		filter->step = static_cast<int>(std::lround(static_cast<double>(inRate) * kResamplerMaxPhases / outRate));
+	}
+
+	// Cutoff in cycles per input sample, below the Nyquist frequency of the lower rate
+	double cutoff = 0.5 * kResamplerCutoff * std::min(1.0, static_cast<double>(outRate) / inRate);
+	filter->half = static_cast<int>(std::ceil(kResamplerZeroCrossings / (2.0 * cutoff)));
+	filter->taps = (2 * filter->half + 3) & ~3;
+	filter->coefficients.assign(static_cast<size_t>(filter->phases) * filter->taps, 0.0f);
+
+	double window_norm = bessel_i0(kResamplerKaiserBeta);
+	for (int p = 0; p < filter->phases; ++p) {
+		float* row = filter->coefficients.data() + static_cast<size_t>(p) * filter->taps;
+		double sum = 0.0;
+		for (int k = 0; k < 2 * filter->half; ++k) {
+			// Distance in input samples from tap k to the output position
+			double x = filter->half - 1 - k + static_cast<double>(p) / filter->phases;
+			double r = x / filter->half;
+			if (r <= -1.0 || r >= 1.0) {
+				continue;
+			}
+			double arg = 2.0 * cutoff * x;
+			double sinc = arg == 0.0 ? 1.0 : std::sin(M_PI * arg) / (M_PI * arg);
+			double value = 2.0 * cutoff * sinc * bessel_i0(kResamplerKaiserBeta * std::sqrt(1.0 - r * r)) / window_norm;
+			row[k] = static_cast<float>(value);
+			sum += value;
+		}
+		// Unity gain at DC for every phase
+		for (int k = 0; k < filter->taps; ++k) {
+			row[k] = static_cast<float>(row[k] / sum);
+		}
+	}
+	return filter;
+}
+
+// Filters are shared by every sound registered at the same rate
+static std::shared_ptr<const PolyphaseFilter> find_polyphase_filter(int inRate, int outRate)
+{
+	static std::mutex mutex;
+	static std::vector<std::shared_ptr<const PolyphaseFilter>> filters;
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& filter : filters) {
+		if (filter->inRate == inRate && filter->outRate == outRate) {
+			return filter;
+		}
+	}
+	filters.push_back(make_polyphase_filter(inRate, outRate));
+	return filters.back();
+}
+
+#ifdef HAVE_SSE2
+// dot_product with 8-wide fused multiply-adds. Resampling runs once per sound at load time, so the
+// slightly different rounding from the SSE2 sum doesn't reach anything compared against a reference.
+AVX2_FMA_TARGET static float dot_product_avx2(const float* a, const float* b, int count)
+{
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+		sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+	}
+	if (i + 8 <= count) {
+		sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+		i += 8;
+	}
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+	sum = _mm_add_ps(sum, _mm_add_ps(_mm256_castps256_ps128(sum1), _mm256_extractf128_ps(sum1, 1)));
+	if (i < count) {
+		sum = _mm_fmadd_ps(_mm_loadu_ps(a + i), _mm_load_ps(b + i), sum);
+	}
+	_mm256_zeroupper();
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(sum);
+}
+#endif
+
+// Sum of a[i] * b[i]. count is a multiple of 4 and b is 16-byte aligned.
+static inline float dot_product(const float* a, const float* b, int count)
+{
+#ifdef HAVE_SSE2
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_load_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_load_ps(b + i + 4)));
+	}
+	if (i < count) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_load_ps(b + i)));
+	}
+	__m128 sum = _mm_add_ps(sum0, sum1);
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(sum);
+#else
+	float sum = 0.0f;
+	for (int i = 0; i < count; ++i) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+#endif
+}
+
+static void resample(const PolyphaseFilter& filter, const SoundSamples& input, AlignedVector<float>& output)
+{
+	size_t length = input.size();
+	auto output_length = static_cast<size_t>((static_cast<unsigned long long>(length) * filter.phases + filter.step - 1) / filter.step);
+
+	// Silence either side so every output sample can read a full row of taps
+	std::vector<float> padded(length + filter.taps, 0.0f);
+	std::copy(input.begin(), input.end(), padded.begin() + (filter.half - 1));
+
+	output.resize(output_length);
+	size_t index = 0;
+	int phase = 0;
+	int whole = filter.step / filter.phases;
+	int fraction = filter.step % filter.phases;
+	float (*dot)(const float*, const float*, int) = dot_product;
+#ifdef HAVE_SSE2
+	if (use_avx2()) {
+		dot = dot_product_avx2;
+	}
+#endif
+	for (size_t n = 0; n < output_length; ++n) {
+		output[n] = dot(padded.data() + index, filter.coefficients.data() + static_cast<size_t>(phase) * filter.taps, filter.taps);
+		index += whole;
+		phase += fraction;
+		if (phase >= filter.phases) {
+			phase -= filter.phases;
+			index++;
+		}
+	}
+}
+
+// The rate sounds are stored at: the one Steam Audio was initialized with, once initialization has started
+static int sound_sample_rate()
+{
+	int status = g_status.load(std::memory_order_acquire);
+	return status == STEAM_AUDIO_READY || status == STEAM_AUDIO_LOADING ? g_state.audioSettings.samplingRate : 0;
+}
+
+// Convert a sound to the renderer rate once, so it plays at the right pitch and isn't resampled per play
+static void convert_sample_rate(Sound& sound)
+{
+	int rate = sound_sample_rate();
+	if (rate <= 0 || sound.sampleRate == rate || sound.samples.empty()) {
+		return;
+	}
+
+	StageTimer timer(STAT_RESAMPLE);
+	AlignedVector<float> converted;
+	resample(*find_polyphase_filter(sound.sampleRate, rate), sound.samples, converted);
+	sound.samples.assign(std::move(converted));
+	sound.sampleRate = rate;
+}
+
+// Look up a sound for rendering. One registered before initialization, or before a re-initialization at
+// another rate, is resampled on its first use at the new rate, outside the registry lock, and kept in
+// place of the original. Voices still playing the original keep their own reference to it.
+static std::shared_ptr<const Sound> find_sound(int handle)
+{
+	auto sound = find_registered_sound(handle);
+	int rate = sound_sample_rate();
+	if (!sound || rate <= 0 || sound->sampleRate == rate || sound->samples.empty()) {
+		return sound;
+	}
+
+	std::shared_ptr<Sound> converted;
+	try {
+		StageTimer timer(STAT_RESAMPLE);
+		AlignedVector<float> samples;
+		resample(*find_polyphase_filter(sound->sampleRate, rate), sound->samples, samples);
+		converted = std::make_shared<Sound>();
+		converted->samples.assign(std::move(samples));
+		converted->sampleRate = rate;
+	} catch (const std::bad_alloc&) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(g_soundsMutex);
+	auto it = g_sounds.find(handle);
+	if (it != g_sounds.end() && it->second.sound == sound) {
+		SoundEntry& entry = it->second;
+		entry.sound = converted;
+		// A pack sound is mapped at the pack's rate again after it is unmapped, so its entry keeps describing the pack
+		if (!entry.pack.file) {
+			entry.length = static_cast<int>(converted->samples.size());
+			entry.sampleRate = rate;
+		}
+	}
+	return converted;
+}
+
+// Resample every sound held in memory to the rate initialization has just set, so their first plays
+// don't pay for it. Pack sounds are converted as they are mapped.
+static void resample_registered_sounds()
+{
+	std::vector<int> handles;
+	{
+		std::lock_guard<std::mutex> lock(g_soundsMutex);
+		for (const auto& it : g_sounds) {
+			if (!it.second.pack.file) {
+				handles.push_back(it.first);
+			}
+		}
+	}
+	for (int handle : handles) {
+		find_sound(handle);
+	}
+}
+
+// Decode a WAV file once into DLL-owned storage, converted to the rate Steam Audio was initialized with.
+// Returns a sound handle, or 0 on failure.
+EXPORT int register_sound(const wchar_t* path)
+{
+	if (!path) {
+		return 0;
+	}
+
+	try {
+		std::vector<uint8_t> contents;
+		if (!read_file(path, contents)) {
+			return 0;
+		}
+
+		auto sound = std::make_shared<Sound>();
+		if (!decode_wav(contents.data(), contents.size(), *sound)) {
+			return 0;
+		}
+		convert_sample_rate(*sound);
+		return add_sound(std::move(sound));
+	} catch (const std::bad_alloc&) {
+		return 0;
+	}
+}
+
+// Copy mono float samples into DLL-owned storage, converted like register_sound. Returns a sound handle, or 0 on failure.
+EXPORT int register_sound_pcm(const float* samples, int length, int sample_rate)
+{
+	if (!samples || length < 0 || sample_rate <= 0) {
+		return 0;
+	}
+
+	try {
+		auto sound = std::make_shared<Sound>();
+		sound->samples.assign(AlignedVector<float>(samples, samples + length));
+		sound->sampleRate = sample_rate;
+		convert_sample_rate(*sound);
+		return add_sound(std::move(sound));
+	} catch (const std::bad_alloc&) {
+		return 0;
+	}
+}
+
+// Theme packs hold every sound of a theme decoded to float32 mono at one sample rate, so activating
+// a theme maps one file rather than decoding a WAV per role. Little-endian, as written on x86 and x64:
+//   ThemePackHeader
+//   soundCount ThemePackEntry
+//   the theme's info.json, UTF-8, infoSize bytes from infoOffset
+//   every sound's samples, each starting on a kThemePackAlignment boundary so they can be used in place
+static const char kThemePackMagic[4] = { 'A', 'T', 'P', 'K' };
+static const uint32_t kThemePackVersion = 1;
+static const uint64_t kThemePackAlignment = 64;
+
+struct ThemePackHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t sampleRate;
+	uint32_t soundCount;
+	uint64_t infoOffset;
+	uint64_t infoSize;
+};
+
+struct ThemePackEntry {
+	int32_t role;
+	uint32_t reserved;
+	uint64_t offset; // Of the first sample, from the start of the file
+	uint64_t length; // In samples
+};
+
+static_assert(sizeof(ThemePackHeader) == 32 && sizeof(ThemePackEntry) == 24, "Theme pack layout changed");
+
+// Write registered sounds to a theme pack, each under the role at the same index. The sounds have to
+// share a sample rate, which has to be the renderer's for register_theme_pack to take the pack.
+// info is the theme's info.json, or null. Returns false if a handle is unknown or writing fails.
+EXPORT bool write_theme_pack(const wchar_t* path, const int* roles, const int* handles, int count, const char* info)
+{
+	if (!path || count < 0 || (count > 0 && (!roles || !handles))) {
+		return false;
+	}
+
+	try {
+		std::vector<std::shared_ptr<const Sound>> sounds;
+		for (int i = 0; i < count; ++i) {
+			auto sound = find_sound(handles[i]);
+			if (!sound || (!sounds.empty() && sound->sampleRate != sounds.front()->sampleRate)) {
+				return false;
+			}
+			sounds.push_back(std::move(sound));
+		}
+
+		ThemePackHeader header{};
+		std::memcpy(header.magic, kThemePackMagic, sizeof(header.magic));
+		header.version = kThemePackVersion;
+		header.sampleRate = static_cast<uint32_t>(sounds.empty() ? sound_sample_rate() : sounds.front()->sampleRate);
+		header.soundCount = static_cast<uint32_t>(count);
+		header.infoOffset = sizeof(ThemePackHeader) + sounds.size() * sizeof(ThemePackEntry);
+		header.infoSize = info ? std::strlen(info) : 0;
+
+		std::vector<ThemePackEntry> entries(sounds.size());
+		uint64_t offset = header.infoOffset + header.infoSize;
+		for (size_t i = 0; i < sounds.size(); ++i) {
+			offset = (offset + kThemePackAlignment - 1) / kThemePackAlignment * kThemePackAlignment;
+			entries[i].role = roles[i];
+			entries[i].offset = offset;
+			entries[i].length = sounds[i]->samples.size();
+			offset += entries[i].length * sizeof(float);
+		}
+
+		FILE* file = open_file(path, true);
+		if (!file) {
+			return false;
+		}
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		ok = ok && (entries.empty() || fwrite(entries.data(), sizeof(ThemePackEntry), entries.size(), file) == entries.size());
+		ok = ok && (header.infoSize == 0 || fwrite(info, 1, header.infoSize, file) == header.infoSize);
+		uint64_t position = header.infoOffset + header.infoSize;
+		static const char padding[kThemePackAlignment] = {};
+		for (size_t i = 0; ok && i < sounds.size(); ++i) {
+			auto gap = static_cast<size_t>(entries[i].offset - position);
+			ok = (gap == 0 || fwrite(padding, 1, gap, file) == gap)
+				&& (entries[i].length == 0 || fwrite(sounds[i]->samples.data(), sizeof(float), entries[i].length, file) == entries[i].length);
+			position = entries[i].offset + entries[i].length * sizeof(float);
+		}
+		return fclose(file) == 0 && ok;
+	} catch (const std::bad_alloc&) {
+		return false;
+	}
+}
+
+// Register every sound in a theme pack written by write_theme_pack. Only the index is read here: each
+// sound maps its own samples from the pack the first time it is used, viewing them rather than
+// copying, and is unmapped again when set_sound_memory_budget needs the room.
+// Fills roles and handles and returns the number of sounds, or -1 if the pack can't be read, holds
+// more than capacity sounds or was written at a rate other than the renderer's.
+EXPORT int register_theme_pack(const wchar_t* path, int* roles, int* handles, int capacity)
+{
+	if (!path || capacity < 0 || (capacity > 0 && (!roles || !handles))) {
+		return -1;
+	}
+
+	try {
+		auto file = std::make_shared<MappableFile>();
+		auto head = file->open(path) ? file->map(0, sizeof(ThemePackHeader)) : nullptr;
+		if (!head) {
+			return -1;
+		}
+
+		ThemePackHeader header;
+		std::memcpy(&header, head->data(), sizeof(header));
+		int rate = sound_sample_rate();
+		if (std::memcmp(header.magic, kThemePackMagic, sizeof(header.magic)) != 0 || header.version != kThemePackVersion
+			|| header.sampleRate == 0 || (rate > 0 && header.sampleRate != static_cast<uint32_t>(rate))
+			|| header.soundCount > static_cast<uint32_t>(capacity)) {
+			return -1;
+		}
+
+		std::vector<ThemePackEntry> entries(header.soundCount);
+		if (!entries.empty()) {
+			auto index = file->map(sizeof(ThemePackHeader), entries.size() * sizeof(ThemePackEntry));
+			if (!index) {
+				return -1;
+			}
+			std::memcpy(entries.data(), index->data(), entries.size() * sizeof(ThemePackEntry));
+		}
+
+		// Nothing is registered until the whole index has checked out
+		for (const auto& entry : entries) {
+			if (entry.offset % sizeof(float) != 0 || entry.offset > file->size()
+				|| entry.length > (file->size() - entry.offset) / sizeof(float) || entry.length > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+				return -1;
+			}
+		}
+
+		for (size_t i = 0; i < entries.size(); ++i) {
+			SoundEntry sound;
+			sound.pack.file = file;
+			sound.pack.offset = entries[i].offset;
+			sound.pack.length = static_cast<size_t>(entries[i].length);
+			sound.length = static_cast<int>(entries[i].length);
+			sound.sampleRate = static_cast<int>(header.sampleRate);
+			roles[i] = entries[i].role;
+			handles[i] = add_sound_entry(std::move(sound));
+		}
+		return static_cast<int>(entries.size());
+	} catch (const std::bad_alloc&) {
+		return -1;
+	}
+}
+
+EXPORT void release_sound(int handle)
+{
+	{
+		std::lock_guard<std::mutex> lock(g_soundsMutex);
+		auto it = g_sounds.find(handle);
+		if (it != g_sounds.end()) {
+			if (it->second.pack.file && it->second.sound) {
+				unmap_sound_locked(it->second);
+			}
+			g_sounds.erase(it);
+		}
+	}
+	g_outputCache.remove_sound(handle);
+}
+
+// Doesn't map a pack sound that isn't mapped yet
+EXPORT bool get_sound_info(int handle, int* length, int* sample_rate)
+{
+	std::lock_guard<std::mutex> lock(g_soundsMutex);
+	auto it = g_sounds.find(handle);
+	if (it == g_sounds.end()) {
+		return false;
+	}
+	if (length) {
+		*length = it->second.length;
+	}
+	if (sample_rate) {
+		*sample_rate = it->second.sampleRate;
+	}
+	return true;
+}
+
+// Most bytes of theme pack samples kept mapped at once. Past it, the least recently used sounds are
+// unmapped and mapped again when next played; sounds playing at the time stay mapped until they end.
+// 0 keeps every pack sound mapped from its first use until it is released.
+EXPORT void set_sound_memory_budget(long long bytes)
+{
+	std::lock_guard<std::mutex> lock(g_soundsMutex);
+	g_soundBudget = static_cast<size_t>(std::max(0LL, std::min<long long>(bytes, static_cast<long long>(SIZE_MAX >> 1))));
+	trim_mapped_sounds_locked();
+}
+
+// Map a sound now and read it in, so its first play waits on neither. false if the handle is unknown.
+EXPORT bool load_sound(int handle)
+{
+	auto sound = find_sound(handle);
+	if (!sound) {
+		return false;
+	}
+	// One read a page is enough for the OS to bring the whole page in
+	volatile float sink = 0.0f;
+	for (size_t i = 0; i < sound->samples.size(); i += 1024) {
+		sink = sink + sound->samples.data()[i];
+	}
+	return true;
+}
@@ -0,0 +1,121 @@
+// Counters and stage timings behind get_audio_stats. Hot paths only ever touch them with relaxed atomics.
+
+#pragma once
+
+#include "common.h"
+
+// Timed stages, indexes into AudioStats::stages
+enum AudioStatsStage {
+	STAT_PROCESS_SOUND = 0, // process_sound / process_sound_into
+	STAT_APPLY_REVERB = 1,  // apply_reverb / apply_reverb_into
+	STAT_RENDER_SOUND = 2,  // render_sound_into and uncached process_sound_handle / batch / bake renders
+	STAT_ALLOCATION = 3,    // Output buffer allocations
+	STAT_CONVERSION = 4,    // Float to 16-bit conversion, once per rendered or mixed frame
+	STAT_RESAMPLE = 5,      // Sample rate conversion at registration
+	STAT_MIXER_FRAME = 6,   // One mixer output frame
+	STAT_FIRST_FRAME = 7,   // mixer_play until mixer_read hands out the sound's first frame
+	STAT_STAGE_COUNT = 8
+};
+
+// Bucket 0 counts calls under 1 us, bucket i calls of [2^(i-1), 2^i) us; the last one everything longer
+static const int kStatBuckets = 20;
+
+// Exported layouts, mirrored by steam_audio.py
+struct StageStats {
+	long long count;
+	long long totalNs;
+	long long maxNs;
+	long long buckets[kStatBuckets];
+};
+
+struct AudioStats {
+	StageStats stages[STAT_STAGE_COUNT];
+	long long framesRendered;    // Processing frames produced by every render path, mixer frames included
+	long long tailFramesSkipped; // Reverb tail frames not rendered because the tail had gone quiet
+	long long cacheHits;
+	long long cacheMisses;
+	long long mixerUnderruns;    // Reads that found a playing mixer's output empty
+	long long failures;          // Renders that failed part way or couldn't allocate their output
+	long long rendersCancelled;  // Renders abandoned part way by cancel_render or a superseded bake
+	long long soundsMapped;      // Theme pack sounds mapped on first use, or again after being unmapped
+	long long soundsUnmapped;    // Theme pack sounds unmapped to stay within set_sound_memory_budget
+	long long soundBytesMapped;  // Samples of theme pack sounds mapped right now, not reset
+	long long playsCoalesced;    // Mixer plays dropped as repeats of a sound just started, or made moot by a later interrupt
+	long long playsRejected;     // Mixer plays turned away by a full queue or voices of higher priority
+	long long voicesStolen;      // Mixer voices stopped early for a newer sound
+	long long deadlineMisses;    // Mixer frames rendered after they were due to be heard
+	long long priorityInversions; // Times a mixer's render thread had to wait on a lock another thread held
+	long long realtimeThreads;   // Mixer render threads running as MMCSS Pro Audio tasks right now, not reset
+	long long deviceOutputs;     // Native WASAPI outputs playing right now, not reset
+};
+
+// Counters are only ever touched with relaxed atomics, so the hot paths never take a lock for them
+struct StageCounters {
+	std::atomic<long long> count{ 0 };
+	std::atomic<long long> totalNs{ 0 };
+	std::atomic<long long> maxNs{ 0 };
+	std::atomic<long long> buckets[kStatBuckets] = {};
+};
+
+struct StatsCounters {
+	StageCounters stages[STAT_STAGE_COUNT];
+	std::atomic<long long> framesRendered{ 0 };
+	std::atomic<long long> tailFramesSkipped{ 0 };
+	std::atomic<long long> mixerUnderruns{ 0 };
+	std::atomic<long long> failures{ 0 };
+	std::atomic<long long> rendersCancelled{ 0 };
+	std::atomic<long long> soundsMapped{ 0 };
+	std::atomic<long long> soundsUnmapped{ 0 };
+	std::atomic<long long> playsCoalesced{ 0 };
+	std::atomic<long long> playsRejected{ 0 };
+	std::atomic<long long> voicesStolen{ 0 };
+	std::atomic<long long> deadlineMisses{ 0 };
+	std::atomic<long long> priorityInversions{ 0 };
+	std::atomic<long long> realtimeThreads{ 0 };
+	std::atomic<long long> deviceOutputs{ 0 };
+};
+
+static StatsCounters g_stats;
+
+static void stat_add(std::atomic<long long>& counter, long long value = 1)
+{
+	counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+static void record_stage(AudioStatsStage stage, long long ns)
+{
+	StageCounters& counters = g_stats.stages[stage];
+	stat_add(counters.count);
+	stat_add(counters.totalNs, ns);
+
+	long long previous = counters.maxNs.load(std::memory_order_relaxed);
+	while (ns > previous && !counters.maxNs.compare_exchange_weak(previous, ns, std::memory_order_relaxed)) {
+	}
+
+	int bucket = 0;
+	for (long long us = ns / 1000; us > 0 && bucket < kStatBuckets - 1; us >>= 1) {
+		bucket++;
+	}
+	stat_add(counters.buckets[bucket]);
+}
+
+// Records the time from construction to destruction against a stage
+class StageTimer {
+public:
+	explicit StageTimer(AudioStatsStage stage) : m_stage(stage), m_start(std::chrono::steady_clock::now())
+	{
+	}
+
+	~StageTimer()
+	{
+		auto elapsed = std::chrono::steady_clock::now() - m_start;
+		record_stage(m_stage, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+	StageTimer(const StageTimer&) = delete;
+	StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+	AudioStatsStage m_stage;
+	std::chrono::steady_clock::time_point m_start;
+};
@@ -37,6 +37,11 @@ extern "C" {
 #define verblib_silence_threshold 80.0 /* In dB (absolute). */
 #endif
 
+    /* Define verblib_external_buffers to leave the comb and allpass buffers out of struct verblib.
+    * They are then carved out of a single caller-provided block sized for the actual sample rate,
+    * see verblib_get_buffer_size and verblib_initialize_with_buffer, and verblib_max_sample_rate_multiplier no longer applies.
+    */
+
     /* PUBLIC API */
 
     typedef struct verblib verblib;
@@ -47,7 +52,21 @@ extern "C" {
     * Returns nonzero (true) on success or 0 (false) on failure.
     * The function will only fail if one or more of the parameters are invalid.
     */
+#ifndef verblib_external_buffers
     int verblib_initialize ( verblib* verb, unsigned long sample_rate, unsigned int channels );
+#else
+    /* Get the number of floats verblib_initialize_with_buffer needs for the given sample rate. */
+    unsigned long verblib_get_buffer_size ( unsigned long sample_rate );
+
+    /* Initialize a verblib structure whose delay lines live in buffer.
+    *
+    * buffer must hold verblib_get_buffer_size ( sample_rate ) floats and stay valid for as long as verb is used.
+    * The delay lines are laid out back to back in the order verblib_process runs them, each starting
+    * on a 64 byte boundary if buffer does.
+    * Returns nonzero (true) on success or 0 (false) on failure.
+    */
+    int verblib_initialize_with_buffer ( verblib* verb, unsigned long sample_rate, unsigned int channels, float* buffer );
+#endif
 
     /* Run the reverb.
     *
@@ -205,6 +224,7 @@ extern "C" {
         verblib_allpass allpassL[verblib_numallpasses];
         verblib_allpass allpassR[verblib_numallpasses];
 
+#ifndef verblib_external_buffers
         /* Buffers for the combs */
         float bufcombL1[verblib_combtuningL1* verblib_max_sample_rate_multiplier];
         float bufcombR1[verblib_combtuningR1* verblib_max_sample_rate_multiplier];
@@ -232,6 +252,7 @@ extern "C" {
         float bufallpassR3[verblib_allpasstuningR3* verblib_max_sample_rate_multiplier];
         float bufallpassL4[verblib_allpasstuningL4* verblib_max_sample_rate_multiplier];
         float bufallpassR4[verblib_allpasstuningR4* verblib_max_sample_rate_multiplier];
+#endif
     };
 
 #ifdef __cplusplus
@@ -405,10 +426,8 @@ static int verblib_get_verblib_scaled_buffer_size ( unsigned long sample_rate, u
     return ( int ) result;
 }
 
-int verblib_initialize ( verblib* verb, unsigned long sample_rate, unsigned int channels )
+static int verblib_check_format ( unsigned long sample_rate, unsigned int channels )
 {
-    int i;
-
     if ( channels != 1 && channels != 2 )
     {
         return 0;    /* Currently supports only 1 or 2 channels. */
@@ -417,10 +436,44 @@ int verblib_initialize ( verblib* verb, unsigned long sample_rate, unsigned int
     {
         return 0;    /* The minimum supported sample rate is 22050 HZ. */
     }
+#ifndef verblib_external_buffers
     else if ( sample_rate > 44100 * verblib_max_sample_rate_multiplier )
     {
         return 0; /* The sample rate is too high. */
     }
+#endif
+    return 1;
+}
+
+static void verblib_set_defaults ( verblib* verb )
+{
+    int i;
+
+    for ( i = 0; i < verblib_numallpasses; i++ )
+    {
+        verb->allpassL[i].feedback = 0.5f;
+        verb->allpassR[i].feedback = 0.5f;
+    }
+
+    verblib_set_wet ( verb, verblib_initialwet );
+    verblib_set_room_size ( verb, verblib_initialroom );
+    verblib_set_dry ( verb, verblib_initialdry );
+    verblib_set_damping ( verb, verblib_initialdamp );
+    verblib_set_width ( verb, verblib_initialwidth );
+    verblib_set_input_width ( verb, verblib_initialinputwidth );
+    verblib_set_mode ( verb, verblib_initialmode );
+
+    /* The buffers will be full of rubbish - so we MUST mute them. */
+    verblib_mute ( verb );
+}
+
+#ifndef verblib_external_buffers
+int verblib_initialize ( verblib* verb, unsigned long sample_rate, unsigned int channels )
+{
+    if ( !verblib_check_format ( sample_rate, channels ) )
+    {
+        return 0;
+    }
 
     verb->channels = channels;
 
@@ -451,26 +504,78 @@ int verblib_initialize ( verblib* verb, unsigned long sample_rate, unsigned int
     verblib_allpass_initialize ( &verb->allpassL[3], verb->bufallpassL4, verblib_get_verblib_scaled_buffer_size ( sample_rate, verblib_allpasstuningL4 ) );
     verblib_allpass_initialize ( &verb->allpassR[3], verb->bufallpassR4, verblib_get_verblib_scaled_buffer_size ( sample_rate, verblib_allpasstuningR4 ) );
 
-    /* Set default values. */
-    for ( i = 0; i < verblib_numallpasses; i++ )
+    verblib_set_defaults ( verb );
+
+    return 1;
+}
+#else
+static const int verblib_combtunings[2 * verblib_numcombs] =
+{
+    verblib_combtuningL1, verblib_combtuningR1, verblib_combtuningL2, verblib_combtuningR2,
+    verblib_combtuningL3, verblib_combtuningR3, verblib_combtuningL4, verblib_combtuningR4,
+    verblib_combtuningL5, verblib_combtuningR5, verblib_combtuningL6, verblib_combtuningR6,
+    verblib_combtuningL7, verblib_combtuningR7, verblib_combtuningL8, verblib_combtuningR8
+};
+
+static const int verblib_allpasstunings[2 * verblib_numallpasses] =
+{
+    verblib_allpasstuningL1, verblib_allpasstuningR1, verblib_allpasstuningL2, verblib_allpasstuningR2,
+    verblib_allpasstuningL3, verblib_allpasstuningR3, verblib_allpasstuningL4, verblib_allpasstuningR4
+};
+
+/* Room taken by a delay line in the buffer, rounded up to whole 64 byte cache lines. */
+static unsigned long verblib_get_padded_buffer_size ( unsigned long sample_rate, int tuning )
+{
+    return ( ( unsigned long ) verblib_get_verblib_scaled_buffer_size ( sample_rate, tuning ) + 15 ) & ~15UL;
+}
+
+unsigned long verblib_get_buffer_size ( unsigned long sample_rate )
+{
+    unsigned long size = 0;
+    int i;
+    for ( i = 0; i < 2 * verblib_numcombs; i++ )
     {
-        verb->allpassL[i].feedback = 0.5f;
-        verb->allpassR[i].feedback = 0.5f;
+        size += verblib_get_padded_buffer_size ( sample_rate, verblib_combtunings[i] );
+    }
+    for ( i = 0; i < 2 * verblib_numallpasses; i++ )
+    {
+        size += verblib_get_padded_buffer_size ( sample_rate, verblib_allpasstunings[i] );
     }
+    return size;
+}
 
-    verblib_set_wet ( verb, verblib_initialwet );
-    verblib_set_room_size ( verb, verblib_initialroom );
-    verblib_set_dry ( verb, verblib_initialdry );
-    verblib_set_damping ( verb, verblib_initialdamp );
-    verblib_set_width ( verb, verblib_initialwidth );
-    verblib_set_input_width ( verb, verblib_initialinputwidth );
-    verblib_set_mode ( verb, verblib_initialmode );
+int verblib_initialize_with_buffer ( verblib* verb, unsigned long sample_rate, unsigned int channels, float* buffer )
+{
+    int i;
 
-    /* The buffers will be full of rubbish - so we MUST mute them. */
-    verblib_mute ( verb );
+    if ( !verblib_check_format ( sample_rate, channels ) || !buffer )
+    {
+        return 0;
+    }
+
+    verb->channels = channels;
+
+    /* Left and right of each stage sit next to each other, the combs first and then the allpasses. */
+    for ( i = 0; i < verblib_numcombs; i++ )
+    {
+        verblib_comb_initialize ( &verb->combL[i], buffer, verblib_get_verblib_scaled_buffer_size ( sample_rate, verblib_combtunings[2 * i] ) );
+        buffer += verblib_get_padded_buffer_size ( sample_rate, verblib_combtunings[2 * i] );
+        verblib_comb_initialize ( &verb->combR[i], buffer, verblib_get_verblib_scaled_buffer_size ( sample_rate, verblib_combtunings[2 * i + 1] ) );
+        buffer += verblib_get_padded_buffer_size ( sample_rate, verblib_combtunings[2 * i + 1] );
+    }
+    for ( i = 0; i < verblib_numallpasses; i++ )
+    {
+        verblib_allpass_initialize ( &verb->allpassL[i], buffer, verblib_get_verblib_scaled_buffer_size ( sample_rate, verblib_allpasstunings[2 * i] ) );
+        buffer += verblib_get_padded_buffer_size ( sample_rate, verblib_allpasstunings[2 * i] );
+        verblib_allpass_initialize ( &verb->allpassR[i], buffer, verblib_get_verblib_scaled_buffer_size ( sample_rate, verblib_allpasstunings[2 * i + 1] ) );
+        buffer += verblib_get_padded_buffer_size ( sample_rate, verblib_allpasstunings[2 * i + 1] );
+    }
+
+    verblib_set_defaults ( verb );
 
     return 1;
 }
+#endif
 
 void verblib_process ( verblib* verb, const float* input_buffer, float* output_buffer, unsigned long frames )
 {